@@ -25,8 +25,14 @@
 
 #include <iosfwd>
 #include <vector>
+#include <thread>
+#include <atomic>
+#include <algorithm>
+#include <numeric>
 
 #include "App.h"
+#include "GzipStream.h"
+#include "ExportCheckpoint.h"
 #include "ParseCommandLine.h"
 #include "ErrorCode.h"
 #include "Messenger.h"
@@ -60,32 +66,187 @@ bool App::IsTrueString(const string &str) const
 			Equal(s, "да");
 }
 
+// расширение файла выгрузки с учетом сжатия
+string App::export_extension(const string &extension) const
+{
+	return ActionCompressChecked ? extension + ".gz" : extension;
+}
+
+// begin_checkpoint
+// Состояние выгрузки в каталог root_path, если включено продолжение прерванной выгрузки
+void App::begin_checkpoint(const boost::filesystem::path &root_path)
+{
+	checkpoint.reset(ActionResumeChecked ? new ExportCheckpoint(root_path / EXPORT_CHECKPOINT_FILE_NAME) : nullptr);
+} // begin_checkpoint
+
+// end_checkpoint
+// После успешного завершения выгрузки состояние больше не нужно, следующая выгрузка начнется сначала
+void App::end_checkpoint(bool completed)
+{
+	if (checkpoint && completed) {
+		checkpoint->clear();
+	}
+	checkpoint.reset();
+} // end_checkpoint
+
+// is_export_done
+bool App::is_export_done(Table *tbl, const boost::filesystem::path &filetable) const
+{
+	if (!checkpoint || !checkpoint->is_done(filetable.string())) {
+		return false;
+	}
+	msreg_g.AddMessage("Таблица выгружена до прерывания выгрузки, пропущена.", MessageState::Info)
+		.with("Таблица", tbl->get_name())
+		.with("Файл", filetable.string());
+	return true;
+} // is_export_done
+
+// export_table_to_xml
+// Возвращает false, если таблица пропущена, так как уже выгружена
+bool App::export_table_to_xml(Table *tbl, const boost::filesystem::path &root_path, int threads,
+							  vector<unique_ptr<T_1CD>> *base_copies)
+{
+	boost::filesystem::path filetable = root_path / (tbl->get_name() + export_extension(".xml"));
+	if (is_export_done(tbl, filetable)) {
+		return false;
+	}
+
+	if (!tbl->get_num_indexes()) {
+		tbl->fill_records_index();
+	}
+
+	tbl->export_to_xml(filetable.string(), ActionXMLSaveBLOBToFileChecked, ActionXMLUnpackBLOBChecked, threads, checkpoint.get(), base_copies);
+	return true;
+} // export_table_to_xml
+
 // export_all_to_xml
 void App::export_all_to_xml(const ParsedCommand &pc)
 {
-	Table *tbl = nullptr;
-
 	boost::filesystem::path root_path(pc.param1);
 	if (!directory_exists(root_path)) {
 		return;
 	}
 
+	begin_checkpoint(root_path);
+
+	if (ExportThreadsCount > 1 && base1CD->get_numtables() > 1) {
+		end_checkpoint(parallel_export_all_to_xml(root_path));
+		return;
+	}
+
+	// экземпляры базы для многопоточной выгрузки открываются один раз на все таблицы
+	vector<unique_ptr<T_1CD>> base_copies;
 	for (int j = 0; j < base1CD->get_numtables(); j++) {
-		tbl = base1CD->get_table(j);
+		Table *tbl = base1CD->get_table(j);
 
-		if (!tbl->get_num_indexes()) {
-			tbl->fill_records_index();
+		if (!export_table_to_xml(tbl, root_path, ExportThreadsCount, &base_copies)) {
+			continue;
 		}
 
-		boost::filesystem::path filetable = root_path / (tbl->get_name() + ".xml");
+		msreg_g.AddMessage("Выполнен экспорт таблицы в файл.", MessageState::Succesfull)
+				.with("Таблица", tbl->get_name())
+				.with("Файл", (root_path / (tbl->get_name() + export_extension(".xml"))).string());
+	}
 
-		tbl->export_to_xml(filetable.string(), ActionXMLSaveBLOBToFileChecked, ActionXMLUnpackBLOBChecked);
+	end_checkpoint(true);
+} // export_all_to_xml
+
+// parallel_export_all_to_xml
+// Возвращает false, если часть таблиц выгрузить не удалось
+bool App::parallel_export_all_to_xml(const boost::filesystem::path &root_path)
+{
+	int numtables = base1CD->get_numtables();
+
+	// самые большие таблицы выгружаются первыми, чтобы в конце не осталась одна длинная таблица
+	vector<int> order(numtables);
+	iota(order.begin(), order.end(), 0);
+	stable_sort(order.begin(), order.end(), [this](int a, int b) {
+		return base1CD->get_table(a)->get_phys_numrecords() > base1CD->get_table(b)->get_phys_numrecords();
+	});
+
+	uint64_t total_records = 0;
+	for (int j = 0; j < numtables; j++) {
+		total_records += base1CD->get_table(j)->get_phys_numrecords();
+	}
 
+	atomic<int> done_tables(0);
+	atomic<uint64_t> done_records(0);
+
+	// таблицы, в которых больше записей, чем приходится на один поток, выгружаются по очереди,
+	// каждая сразу всеми потоками (порциями записей)
+	int first_table = 0;
+	vector<unique_ptr<T_1CD>> base_copies;
+	for (; first_table < numtables; first_table++) {
+		Table *tbl = base1CD->get_table(order[first_table]);
+		if (tbl->get_phys_numrecords() * ExportThreadsCount <= total_records) {
+			break;
+		}
+		bool exported = export_table_to_xml(tbl, root_path, ExportThreadsCount, &base_copies);
+		done_records += tbl->get_phys_numrecords();
+		++done_tables;
+		if (!exported) {
+			continue;
+		}
 		msreg_g.AddMessage("Выполнен экспорт таблицы в файл.", MessageState::Succesfull)
 				.with("Таблица", tbl->get_name())
-				.with("Файл", filetable.string());
+				.with("Файл", (root_path / (tbl->get_name() + export_extension(".xml"))).string())
+				.with("Выгружено таблиц", to_string(done_tables) + " из " + to_string(numtables))
+				.with("Выгружено записей", to_string(done_records) + " из " + to_string(total_records));
 	}
-} // export_all_to_xml
+
+	// T_1CD не рассчитан на одновременную работу из нескольких потоков,
+	// поэтому каждый поток читает базу через свой экземпляр, открытый только для чтения
+	int numthreads = min(ExportThreadsCount, numtables - first_table);
+	vector<unique_ptr<T_1CD>> bases(std::move(base_copies));
+	bases.resize(min<size_t>(bases.size(), numthreads));
+	while ((int)bases.size() < numthreads) {
+		bases.emplace_back(new T_1CD(base1CD->get_filepath(), &mess, false));
+	}
+
+	atomic<int> next_table(first_table);
+	atomic<bool> failed(false);
+
+	auto worker = [&](T_1CD *base) {
+		for (int k = next_table++; k < numtables; k = next_table++) {
+			Table *tbl = base->get_table(order[k]);
+			try {
+				bool exported = export_table_to_xml(tbl, root_path);
+				done_records += tbl->get_phys_numrecords();
+				++done_tables;
+				if (!exported) {
+					continue;
+				}
+				msreg_g.AddMessage("Выполнен экспорт таблицы в файл.", MessageState::Succesfull)
+						.with("Таблица", tbl->get_name())
+						.with("Файл", (root_path / (tbl->get_name() + export_extension(".xml"))).string())
+						.with("Выгружено таблиц", to_string(done_tables) + " из " + to_string(numtables))
+						.with("Выгружено записей", to_string(done_records) + " из " + to_string(total_records));
+			}
+			catch (DetailedException &ex) {
+				failed = true;
+				ex.add_detail("Таблица", tbl->get_name());
+				ex.show();
+			}
+			catch (Exception &ex) {
+				failed = true;
+				msreg_g.AddError(ex.Message()).with("Таблица", tbl->get_name());
+			}
+			catch (...) {
+				failed = true;
+				msreg_g.AddError("Неизвестная ошибка.").with("Таблица", tbl->get_name());
+			}
+		}
+	};
+
+	vector<thread> workers;
+	for (auto &base : bases) {
+		workers.emplace_back(worker, base.get());
+	}
+	for (auto &w : workers) {
+		w.join();
+	}
+	return !failed;
+} // parallel_export_all_to_xml
 
 //---------------------------------------------------------------------------
 // export_to_xml
@@ -128,6 +289,9 @@ void App::export_to_xml(const ParsedCommand &pc)
 		expr[m] = boost::regex(filters[m]);
 	}
 
+	begin_checkpoint(root_path);
+
+	vector<unique_ptr<T_1CD>> base_copies;
 	for (int j = 0; j < base1CD->get_numtables(); j++) {
 		Table *tbl = base1CD->get_table(j);
 
@@ -141,19 +305,232 @@ void App::export_to_xml(const ParsedCommand &pc)
 		}
 
 		if (b) {
+			boost::filesystem::path filetable = root_path / (tbl->get_name() + export_extension(".xml"));
+			if (is_export_done(tbl, filetable)) {
+				continue;
+			}
+
 			tbl->fill_records_index();
 
-			boost::filesystem::path filetable = root_path / (tbl->get_name() + ".xml");
-			tbl->export_to_xml(filetable.string(), ActionXMLSaveBLOBToFileChecked, ActionXMLUnpackBLOBChecked);
+			tbl->export_to_xml(filetable.string(), ActionXMLSaveBLOBToFileChecked, ActionXMLUnpackBLOBChecked, ExportThreadsCount, checkpoint.get(),
+							   &base_copies);
 			msreg_g.AddMessage("Выполнен экспорт таблицы в файл.", MessageState::Succesfull)
 				.with("Таблица", tbl->get_name())
 				.with("Файл", filetable.string());
 		}
 	}
 
+	end_checkpoint(true);
 	delete[] expr;
 } // export_to_xml
 
+//---------------------------------------------------------------------------
+// find_tables
+// Таблицы по списку имен через запятую, точку с запятой или пробел, с подстановками * и ?
+vector<Table*> App::find_tables(const string &list)
+{
+	vector<Table*> result;
+
+	string filter(list);
+	filter = StringReplace(filter, "*", ".*", rfReplaceAll);
+	filter = StringReplace(filter, "?", ".", rfReplaceAll);
+	filter = StringReplace(filter, " ", "\n", rfReplaceAll);
+	filter = StringReplace(filter, "\t", "\n", rfReplaceAll);
+	filter = StringReplace(filter, ",", "\n", rfReplaceAll);
+	filter = StringReplace(filter, ";", "\n", rfReplaceAll);
+
+	TStringList filters;
+	filters.SetText(filter);
+
+	vector<boost::regex> expr;
+	for (int m = 0; m < filters.Count(); m++) {
+		if (!filters[m].empty()) {
+			expr.emplace_back(string("^").append(LowerCase(filters[m])).append("$"));
+		}
+	}
+
+	if (expr.empty()) {
+		msreg_g.AddError("Список таблиц для выгрузки пуст.");
+		return result;
+	}
+
+	for (int j = 0; j < base1CD->get_numtables(); j++) {
+		Table *tbl = base1CD->get_table(j);
+		string tbl_name = LowerCase(tbl->get_name());
+		for (auto &e : expr) {
+			if (regex_match(tbl_name, e)) {
+				result.push_back(tbl);
+				break;
+			}
+		}
+	}
+
+	return result;
+} // find_tables
+
+//---------------------------------------------------------------------------
+// find_export_fields
+// Поля таблицы по списку -Fields. Элемент списка - имя поля или <таблица>.<поле>.
+// Возвращает false, если список задан, но в таблице нет ни одного поля из него
+bool App::find_export_fields(Table *tbl, vector<Field*> &export_fields)
+{
+	export_fields.clear();
+
+	string list(ExportFieldsList);
+	list = StringReplace(list, " ", "\n", rfReplaceAll);
+	list = StringReplace(list, "\t", "\n", rfReplaceAll);
+	list = StringReplace(list, ",", "\n", rfReplaceAll);
+	list = StringReplace(list, ";", "\n", rfReplaceAll);
+
+	TStringList names;
+	names.SetText(list);
+
+	bool specified = false;
+	for (int m = 0; m < names.Count(); m++) {
+		string field_name = names[m];
+		if (field_name.empty()) {
+			continue;
+		}
+		specified = true;
+
+		size_t dot = field_name.find('.');
+		if (dot != string::npos) {
+			if (!EqualIC(field_name.substr(0, dot), tbl->get_name())) {
+				continue;
+			}
+			field_name = field_name.substr(dot + 1);
+		}
+
+		for (int i = 0; i < tbl->get_num_fields(); i++) {
+			Field *field = tbl->get_field(i);
+			if (EqualIC(field->get_name(), field_name)
+					&& find(export_fields.begin(), export_fields.end(), field) == export_fields.end()) {
+				export_fields.push_back(field);
+				break;
+			}
+		}
+	}
+
+	return !specified || !export_fields.empty();
+} // find_export_fields
+
+//---------------------------------------------------------------------------
+// export_to_text
+void App::export_to_text(const ParsedCommand &pc, text_format format)
+{
+	boost::filesystem::path root_path(pc.param1);
+	if (!directory_exists(root_path)) {
+		return;
+	}
+
+	string extension = format == text_format::csv ? ".csv" : format == text_format::tsv ? ".tsv" : ".jsonl";
+
+	begin_checkpoint(root_path);
+
+	for (auto tbl : find_tables(pc.param2)) {
+		vector<Field*> export_fields;
+		if (!find_export_fields(tbl, export_fields)) {
+			msreg_g.AddMessage("В таблице нет полей из списка выгружаемых полей, таблица пропущена.", MessageState::Warning)
+				.with("Таблица", tbl->get_name());
+			continue;
+		}
+
+		boost::filesystem::path filetable = root_path / (tbl->get_name() + export_extension(extension));
+		if (is_export_done(tbl, filetable)) {
+			continue;
+		}
+
+		tbl->fill_records_index();
+
+		tbl->export_to_text(filetable.string(), format, export_fields, TextBlobMode, ActionXMLUnpackBLOBChecked, checkpoint.get());
+		msreg_g.AddMessage("Выполнен экспорт таблицы в файл.", MessageState::Succesfull)
+			.with("Таблица", tbl->get_name())
+			.with("Файл", filetable.string());
+	}
+
+	end_checkpoint(true);
+} // export_to_text
+
+//---------------------------------------------------------------------------
+// export_to_columnar
+void App::export_to_columnar(const ParsedCommand &pc)
+{
+	boost::filesystem::path root_path(pc.param1);
+	if (!directory_exists(root_path)) {
+		return;
+	}
+
+	begin_checkpoint(root_path);
+
+	for (auto tbl : find_tables(pc.param2)) {
+		vector<Field*> export_fields;
+		if (!find_export_fields(tbl, export_fields)) {
+			msreg_g.AddMessage("В таблице нет полей из списка выгружаемых полей, таблица пропущена.", MessageState::Warning)
+				.with("Таблица", tbl->get_name());
+			continue;
+		}
+
+		boost::filesystem::path filetable = root_path / (tbl->get_name() + ".t1cc");
+		if (is_export_done(tbl, filetable)) {
+			continue;
+		}
+
+		tbl->fill_records_index();
+
+		tbl->export_to_columnar(filetable.string(), export_fields, TextBlobMode == blob_export::skip);
+		if (checkpoint) {
+			checkpoint->set_done(filetable.string());
+		}
+		msreg_g.AddMessage("Выполнен экспорт таблицы в файл.", MessageState::Succesfull)
+			.with("Таблица", tbl->get_name())
+			.with("Файл", filetable.string());
+	}
+
+	end_checkpoint(true);
+} // export_to_columnar
+
+//---------------------------------------------------------------------------
+// export_changes
+void App::export_changes(const ParsedCommand &pc)
+{
+	boost::filesystem::path root_path(pc.param1);
+	if (!directory_exists(root_path)) {
+		return;
+	}
+
+	string extension = ChangesFormat == text_format::csv ? ".changes.csv" : ChangesFormat == text_format::tsv ? ".changes.tsv" : ".changes.jsonl";
+
+	begin_checkpoint(root_path);
+
+	for (auto tbl : find_tables(pc.param2)) {
+		vector<Field*> export_fields;
+		if (!find_export_fields(tbl, export_fields)) {
+			msreg_g.AddMessage("В таблице нет полей из списка выгружаемых полей, таблица пропущена.", MessageState::Warning)
+				.with("Таблица", tbl->get_name());
+			continue;
+		}
+
+		boost::filesystem::path filetable = root_path / (tbl->get_name() + export_extension(extension));
+		if (is_export_done(tbl, filetable)) {
+			continue;
+		}
+
+		tbl->fill_records_index();
+
+		// изменения выгружаются только целиком: манифест заменяется после записи файла изменений
+		boost::filesystem::path manifest = root_path / (tbl->get_name() + ".manifest");
+		tbl->export_changes(filetable.string(), manifest.string(), ChangesFormat, export_fields, TextBlobMode, ActionXMLUnpackBLOBChecked);
+		if (checkpoint) {
+			checkpoint->set_done(filetable.string());
+		}
+		msreg_g.AddMessage("Выполнен экспорт изменений таблицы в файл.", MessageState::Succesfull)
+			.with("Таблица", tbl->get_name())
+			.with("Файл", filetable.string());
+	}
+
+	end_checkpoint(true);
+} // export_changes
+
 void App::export_to_binary(const ParsedCommand &pc)
 {
 	boost::filesystem::path root_path(pc.param1);
@@ -191,6 +568,8 @@ void App::export_to_binary(const ParsedCommand &pc)
 		expr[m] = boost::regex(filters[m]);
 	}
 
+	begin_checkpoint(root_path);
+
 	for (int j = 0; j < base1CD->get_numtables(); j++) {
 
 		Table *tbl = base1CD->get_table(j);
@@ -205,16 +584,23 @@ void App::export_to_binary(const ParsedCommand &pc)
 		}
 
 		if (found) {
+			if (is_export_done(tbl, root_path / tbl->get_name())) {
+				continue;
+			}
 			if (!tbl->get_num_indexes()) {
 				tbl->fill_records_index();
 			}
-			tbl->export_table(root_path.string());
+			tbl->export_table(root_path.string(), ActionCompressChecked);
+			if (checkpoint) {
+				checkpoint->set_done((root_path / tbl->get_name()).string());
+			}
 			msreg_g.AddMessage("Выполнен экспорт таблицы в файл.", MessageState::Succesfull)
 					.with("Таблица", tbl->get_name())
 					.with("Каталог", root_path.string());
 		}
 	}
 
+	end_checkpoint(true);
 } // export_to_binary
 
 void App::import_from_binary(const ParsedCommand &pc)
@@ -504,6 +890,15 @@ void App::find_and_save_lost_objects(const ParsedCommand &pc)
 	base1CD->find_and_save_lost_objects(lost_objects);
 }
 
+// save_compacted
+void App::save_compacted(const ParsedCommand &pc)
+{
+	boost::filesystem::path compacted_path(pc.param1);
+	compacted_path = boost::filesystem::absolute(compacted_path);
+
+	base1CD->save_compacted(compacted_path);
+} // save_compacted
+
 void out_gpl_header()
 {
 	cout << "cTool_1CD  Copyright 2009-2017 awa, Copyright 2017-2018 E8 Tools Contributors"
@@ -548,6 +943,47 @@ int App::Run()
 			case Command::xml_parse_blob:
 				ActionXMLUnpackBLOBChecked = IsTrueString(pc.param1);
 				break;
+			case Command::threads:
+				ExportThreadsCount = max(1, ToIntDef(pc.param1, 1));
+				GzipStream::set_default_threads(ExportThreadsCount);
+				break;
+			case Command::compress:
+				ActionCompressChecked = IsTrueString(pc.param1);
+				break;
+			case Command::resume:
+				ActionResumeChecked = IsTrueString(pc.param1);
+				break;
+			case Command::export_fields:
+				ExportFieldsList = pc.param1;
+				break;
+			case Command::blob_mode: {
+				string mode = LowerCase(pc.param1);
+				if (Equal(mode, "base64")) {
+					TextBlobMode = blob_export::base64;
+				} else if (Equal(mode, "file")) {
+					TextBlobMode = blob_export::file;
+				} else if (Equal(mode, "skip")) {
+					TextBlobMode = blob_export::skip;
+				} else {
+					msreg_g.AddMessage("Неизвестный способ выгрузки BLOB, используется base64.", MessageState::Warning)
+						.with("Значение", pc.param1);
+				}
+				break;
+			}
+			case Command::changes_format: {
+				string format = LowerCase(pc.param1);
+				if (Equal(format, "csv")) {
+					ChangesFormat = text_format::csv;
+				} else if (Equal(format, "tsv")) {
+					ChangesFormat = text_format::tsv;
+				} else if (Equal(format, "jsonl")) {
+					ChangesFormat = text_format::jsonl;
+				} else {
+					msreg_g.AddMessage("Неизвестный формат выгрузки изменений, используется jsonl.", MessageState::Warning)
+						.with("Значение", pc.param1);
+				}
+				break;
+			}
 		}
 	}
 
@@ -589,6 +1025,26 @@ int App::Run()
 					export_to_xml(pc);
 					break;
 				}
+				case Command::export_to_csv: {
+					export_to_text(pc, text_format::csv);
+					break;
+				}
+				case Command::export_to_tsv: {
+					export_to_text(pc, text_format::tsv);
+					break;
+				}
+				case Command::export_to_jsonl: {
+					export_to_text(pc, text_format::jsonl);
+					break;
+				}
+				case Command::export_to_columnar: {
+					export_to_columnar(pc);
+					break;
+				}
+				case Command::export_changes: {
+					export_changes(pc);
+					break;
+				}
 				case Command::save_config: {
 					save_config(pc);
 					break;
@@ -625,6 +1081,10 @@ int App::Run()
 					find_and_save_lost_objects(pc);
 					break;
 				}
+				case Command::save_compacted: {
+					save_compacted(pc);
+					break;
+				}
 			}
 		}
 		catch (string &s) {
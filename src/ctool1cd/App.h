@@ -48,11 +48,31 @@ private:
 	bool ActionOpenBaseNotMonopolyChecked{ false };
 	bool ActionXMLSaveBLOBToFileChecked{ false };
 	bool ActionXMLUnpackBLOBChecked{ true };
+	int ExportThreadsCount{ 1 };
+	bool ActionCompressChecked{ false };
+	bool ActionResumeChecked{ false };
+	std::unique_ptr<ExportCheckpoint> checkpoint; // состояние текущей выгрузки, если включено продолжение прерванной выгрузки
+	std::string ExportFieldsList; // поля для текстовой выгрузки, пустая строка - все поля
+	blob_export TextBlobMode{ blob_export::base64 };
+	text_format ChangesFormat{ text_format::jsonl }; // формат инкрементальной выгрузки
 
 	bool IsTrueString(const std::string &str) const;
+	std::string export_extension(const std::string &extension) const;
+	void begin_checkpoint(const boost::filesystem::path& root_path);
+	void end_checkpoint(bool completed);
+	bool is_export_done(Table *tbl, const boost::filesystem::path& filetable) const;
 	void export_all_to_xml(const ParsedCommand& pc);
+	bool parallel_export_all_to_xml(const boost::filesystem::path& root_path);
+	bool export_table_to_xml(Table *tbl, const boost::filesystem::path& root_path, int threads = 1,
+							 std::vector<std::unique_ptr<T_1CD>> *base_copies = nullptr);
 	void export_to_xml(const ParsedCommand& pc);
 
+	std::vector<Table*> find_tables(const std::string &list);
+	bool find_export_fields(Table *tbl, std::vector<Field*> &export_fields);
+	void export_to_text(const ParsedCommand& pc, text_format format);
+	void export_to_columnar(const ParsedCommand& pc);
+	void export_changes(const ParsedCommand& pc);
+
 	void export_to_binary(const ParsedCommand& pc);
 	void import_from_binary(const ParsedCommand& pc);
 
@@ -71,6 +91,8 @@ private:
 
 	void find_and_save_lost_objects(const ParsedCommand& pc);
 
+	void save_compacted(const ParsedCommand& pc);
+
 	inline bool is_infobase() const;
 
 };
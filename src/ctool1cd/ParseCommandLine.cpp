@@ -72,6 +72,30 @@ CommandDefinition CommandParse::definitions[] =
 	{"importfrombinary",   Command::import_from_binary,         2, ""}, // 35
 	{"slo",                Command::find_and_save_lost_objects, 1, ""}, // 36
 	{"savelostobjects",    Command::find_and_save_lost_objects, 1, ""}, // 37
+	{"cp",                 Command::save_compacted,             1, ""}, // 38
+	{"compact",            Command::save_compacted,             1, ""}, // 39
+	{"th",                 Command::threads,                    1, ""}, // 40
+	{"threads",            Command::threads,                    1, ""}, // 41
+	{"ecsv",               Command::export_to_csv,              2, ""}, // 42
+	{"exporttocsv",        Command::export_to_csv,              2, ""}, // 43
+	{"etsv",               Command::export_to_tsv,              2, ""}, // 44
+	{"exporttotsv",        Command::export_to_tsv,              2, ""}, // 45
+	{"ejl",                Command::export_to_jsonl,            2, ""}, // 46
+	{"exporttojsonl",      Command::export_to_jsonl,            2, ""}, // 47
+	{"fl",                 Command::export_fields,              1, ""}, // 48
+	{"fields",             Command::export_fields,              1, ""}, // 49
+	{"bm",                 Command::blob_mode,                  1, ""}, // 50
+	{"blobmode",           Command::blob_mode,                  1, ""}, // 51
+	{"ecol",               Command::export_to_columnar,         2, ""}, // 52
+	{"exporttocolumnar",   Command::export_to_columnar,         2, ""}, // 53
+	{"ei",                 Command::export_changes,             2, ""}, // 54
+	{"exportincremental",  Command::export_changes,             2, ""}, // 55
+	{"fmt",                Command::changes_format,             1, ""}, // 56
+	{"format",             Command::changes_format,             1, ""}, // 57
+	{"gz",                 Command::compress,                   1, "1"}, // 58
+	{"compress",           Command::compress,                   1, "1"}, // 59
+	{"rs",                 Command::resume,                     1, "1"}, // 60
+	{"resume",             Command::resume,                     1, "1"}, // 61
 };
 
 
@@ -99,11 +123,45 @@ ctool1cd.exe [<ключи>] <1CD файл> [<ключи>]\r\n\
 \r\n\
  -eax, -ExportAllToXML <путь>\r\n\
    экспортировать по указанному пути все таблицы в XML.\r\n\
+\r\n\
+ -th, -threads <количество>\r\n\
+   количество потоков выгрузки для -eax и -ex. Таблицы распределяются между потоками, начиная с самых больших, каждая таблица выгружается в свой файл.\r\n\
+   Записи больших таблиц выгружаются всеми потоками порциями, результат совпадает с выгрузкой в один поток.\r\n\
+   По умолчанию выгрузка выполняется в один поток.\r\n\
 \r\n\
  -ex, -ExportToXML <путь> <список>\r\n\
    экспортировать по указанному пути указанные таблицы в XML.\r\n\
    В списке через запятую, точку с запятой или пробел указывается список имен экспортируемых таблиц. Можно использовать знаки подстановки * и ?\r\n\
    Если в списке содержатся пробелы, список необходимо заключать в кавычки.\r\n\
+\r\n\
+ -ecsv, -ExportToCSV <путь> <список>\r\n\
+ -etsv, -ExportToTSV <путь> <список>\r\n\
+ -ejl, -ExportToJSONL <путь> <список>\r\n\
+   экспортировать по указанному пути указанные таблицы в CSV, TSV или JSON Lines. Список таблиц задается так же, как для -ex, * - все таблицы.\r\n\
+   CSV - по RFC 4180, с заголовком, NULL - пустое значение без кавычек. TSV - с заголовком, спецсимволы экранируются \\t \\n \\r \\\\, NULL - \\N.\r\n\
+   JSON Lines - каждая запись в отдельной строке, логические поля - true/false, остальные - строки.\r\n\
+\r\n\
+ -fl, -Fields <список>\r\n\
+   выгружать в CSV, TSV и JSON Lines только указанные поля в указанном порядке. Элемент списка - имя поля или <таблица>.<поле>.\r\n\
+   Таблицы, в которых нет ни одного поля из списка, пропускаются. По умолчанию выгружаются все поля.\r\n\
+\r\n\
+ -bm, -BlobMode <base64/file/skip>\r\n\
+   способ выгрузки BLOB в CSV, TSV и JSON Lines: base64 - в значении поля одной строкой, file - в отдельные файлы в каталоге <файл>.blob\r\n\
+   (в значении поля - имя файла, распаковка по ключу -pb), skip - поля BLOB не выгружаются. По умолчанию base64.\r\n\
+\r\n\
+ -ecol, -ExportToColumnar <путь> <список>\r\n\
+   экспортировать по указанному пути указанные таблицы в колоночный формат (файлы .t1cc, описание формата в ColumnarFormat.h).\r\n\
+   Список таблиц задается так же, как для -ex. Учитываются ключи -Fields и -BlobMode skip, остальные BLOB выгружаются как есть.\r\n\
+\r\n\
+ -ei, -ExportIncremental <путь> <список>\r\n\
+   экспортировать по указанному пути записи указанных таблиц, добавленные, измененные или удаленные с момента предыдущего\r\n\
+   вызова с тем же путем (файлы <таблица>.changes.<формат>). Состояние таблицы сохраняется в файле <таблица>.manifest,\r\n\
+   при первом вызове выгружаются все записи. Первый столбец _OP - insert, update или delete, у таблиц без первичного\r\n\
+   индекса следом идет _RECNO - номер записи. Изменения определяются по полю версии записи, а при его отсутствии - по\r\n\
+   содержимому записи. Учитываются ключи -Fields и -BlobMode.\r\n\
+\r\n\
+ -fmt, -Format <csv/tsv/jsonl>\r\n\
+   формат выгрузки изменений. По умолчанию jsonl.\r\n\
 \r\n\
  -bf, -BlobToFile [yes/no]\r\n\
    при экспорте в XML выгружать BLOB в отдельные файлы.\r\n\
@@ -112,6 +170,18 @@ ctool1cd.exe [<ключи>] <1CD файл> [<ключи>]\r\n\
  -pb, -ParseBlob [yes/no]\r\n\
    при экспорте в XML и выгрузке BLOB в отдельные файлы по-возможности распаковывать данные BLOB.\r\n\
    По умолчанию BLOB при выгрузке в отдельные файлы распаковываются.\r\n\
+\r\n\
+ -gz, -Compress [yes/no]\r\n\
+   сжимать в gzip выгрузки в XML, CSV, TSV, JSON Lines и выгрузки изменений (к имени файла добавляется .gz),\r\n\
+   а при экспорте в двоичные файлы (-eb) - файлы таблицы data, blob, index и descr. -ib читает сжатые файлы.\r\n\
+   Данные сжимаются блоками параллельно, количество потоков задается ключом -threads, по умолчанию - по числу процессоров.\r\n\
+   Колоночная выгрузка не сжимается. По умолчанию выгрузки не сжимаются.\r\n\
+\r\n\
+ -rs, -Resume [yes/no]\r\n\
+   продолжать прерванную выгрузку. В каталоге выгрузки ведется файл состояния tool1cd.checkpoint: выгруженные\r\n\
+   таблицы при повторном запуске пропускаются, а выгрузка больших таблиц в XML, CSV, TSV и JSON Lines продолжается\r\n\
+   с последней сохраненной записи (кроме сжатых файлов и XML с выгрузкой BLOB в файлы). Состояние сохраняется\r\n\
+   каждые 65536 записей. После успешного завершения команды файл состояния удаляется. По умолчанию выключено.\r\n\
 \r\n\
  -dc, -DumpConfig <путь>\r\n\
    Выгрузить основную конфигурацию по указанному пути.\r\n\
@@ -146,6 +216,9 @@ ctool1cd.exe [<ключи>] <1CD файл> [<ключи>]\r\n\
 \r\n\
  -slo, -SaveLostObjects <путь>\r\n\
    Найти потерянные объекты и сохранить\r\n.\
+\r\n\
+ -cp, -Compact <файл>\r\n\
+   Записать в указанный файл дефрагментированную копию базы: все внутренние файлы таблиц размещаются непрерывно, свободные страницы удаляются. Базы формата 8.3.8 не поддерживаются.\r\n\
 Если в пути содержатся пробелы, его необходимо заключать в кавычки. Пути следует указывать без завершающего бэкслеша \"\\\".\r\n\
 Для команд -dc, -ddc, -drc вместо пути можно указывать имя файла конфигурации (имя файла должно заканчиваться на \".cf\").\r\n\
 ";
@@ -179,6 +252,9 @@ CommandParse::CommandParse(char **szArglist, int nArgs)
 		std::string param = szArglist[i];
 		if (param.front() == '-') {
 			param = LowerCase(param.substr(1, param.size() - 1));
+			if (!param.empty() && param.front() == '-') {
+				param.erase(0, 1); // допускаем ключи вида --threads
+			}
 			int j;
 			for (j = 0; j < numdef; j++) {
 				if (Equal(param, definitions[j].key)) {
@@ -46,6 +46,18 @@ enum class Command
 	export_to_binary,           // выгрузить таблицы в двоичные файлы по заданному фильтру
 	import_from_binary,         // загрузить таблицы из двоичных файлов, выгруженных экспортом
 	find_and_save_lost_objects, // найти и сохранить потерянные объекты
+	save_compacted,             // записать дефрагментированную копию базы
+	threads,                    // количество потоков выгрузки
+	export_to_csv,              // выгрузить таблицы в CSV по заданному фильтру
+	export_to_tsv,              // выгрузить таблицы в TSV по заданному фильтру
+	export_to_jsonl,            // выгрузить таблицы в JSON Lines по заданному фильтру
+	export_fields,              // список выгружаемых полей для текстовых форматов
+	blob_mode,                  // способ выгрузки blob в текстовые форматы
+	export_to_columnar,         // выгрузить таблицы в колоночный формат по заданному фильтру
+	export_changes,             // выгрузить изменения таблиц с момента предыдущей выгрузки
+	changes_format,             // формат выгрузки изменений
+	compress,                   // сжимать выгрузки в gzip
+	resume,                     // продолжать прерванную выгрузку
 };
 
 struct CommandDefinition
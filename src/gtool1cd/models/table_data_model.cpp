@@ -68,7 +68,7 @@ QVariant TableDataModel::data(const QModelIndex &index, int role) const
 		if (record->is_null_value(f)) {
 			return QString("{NULL}");
 		}
-		return QString::fromStdString(record->get_string(f));
+		return presentation_of(record, f);
 	}
 	if (role == Qt::EditRole) {
 		Field *f = table->get_field(index.column());
@@ -120,7 +120,7 @@ QVariant TableDataModel::data(const QModelIndex &index, int role) const
 			return QString::fromStdString(value.as_1C());
 		}
 
-		return QString::fromStdString(record->get_string(f));
+		return presentation_of(record, f);
 	}
 	if (role == Qt::FontRole) {
 		if (record->is_removed()) {
@@ -139,6 +139,13 @@ QVariant TableDataModel::data(const QModelIndex &index, int role) const
 	return QVariant();
 }
 
+QVariant TableDataModel::presentation_of(const TableRecord *record, const Field *field) const
+{
+	presentation.clear();
+	record->append_string(presentation, field);
+	return QString::fromUtf8(presentation.data(), static_cast<int>(presentation.size()));
+}
+
 QVariant TableDataModel::headerData(int section, Qt::Orientation orientation, int role) const
 {
 	if (orientation == Qt::Horizontal && role == Qt::DisplayRole) {
@@ -58,6 +58,9 @@ public:
 private:
 	Table *table;
 	Index *_index;
+	mutable std::string presentation; // буфер для представления значений, чтобы не выделять память на каждую ячейку
+
+	QVariant presentation_of(const TableRecord *record, const Field *field) const;
 };
 
 
@@ -98,3 +98,45 @@ TEST_CASE("Конвертация строк UTF-16", "[SystemClasses][String][E
 		}
 	}
 }
+
+TEST_CASE("Дописывание UTF-16 в строку UTF-8", "[SystemClasses][String][Encoding]")
+{
+	GIVEN( "Строки с латиницей, кириллицей, суррогатными парами" ) {
+		u16string ascii(300, u'a');
+		u16string cyrillic;
+		for (int i = 0; i < 40; i++) {
+			cyrillic += u"Привет";
+		}
+		u16string mixed = u"Справочник._Reference12 €" + cyrillic + u"\U0001F600" + ascii;
+
+		string cyrillic8;
+		for (int i = 0; i < 40; i++) {
+			cyrillic8 += "Привет";
+		}
+
+		WHEN ("Вызываем AppendUtf16AsUtf8()" ) {
+			string result = "->";
+			AppendUtf16AsUtf8(result, ascii.data(), ascii.size() * sizeof(char16_t));
+			string result_cyrillic;
+			AppendUtf16AsUtf8(result_cyrillic, cyrillic.data(), cyrillic.size() * sizeof(char16_t));
+			string result_mixed;
+			AppendUtf16AsUtf8(result_mixed, mixed.data(), mixed.size() * sizeof(char16_t));
+
+			THEN ( "Получаем те же строки в UTF-8" ) {
+				REQUIRE (result == "->" + string(300, 'a'));
+				REQUIRE (result_cyrillic == cyrillic8);
+				REQUIRE (result_mixed == "Справочник._Reference12 €" + cyrillic8 + "\xF0\x9F\x98\x80" + string(300, 'a'));
+			}
+		}
+	}
+	GIVEN( "Строка с непарным суррогатом" ) {
+		u16string broken = u"abc";
+		broken += static_cast<char16_t>(0xD800);
+		WHEN ("Вызываем AppendUtf16AsUtf8()" ) {
+			string result;
+			THEN ( "Получаем исключение" ) {
+				REQUIRE_THROWS (AppendUtf16AsUtf8(result, broken.data(), broken.size() * sizeof(char16_t)));
+			}
+		}
+	}
+}
@@ -0,0 +1,140 @@
+/*
+    test_project provides tests for Tool1CD library
+    Copyright © 2009-2017 awa
+    Copyright © 2017-2018 E8 Tools contributors
+
+    This file is part of test_project.
+
+    test_project is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    test_project is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with test_project.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "../catch.hpp"
+#include "Base64.h"
+#include "TempStream.h"
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+// побайтовое кодирование по RFC 4648 для сверки с табличным и векторным кодированием
+std::string reference_encode(const std::string &data, int linesize)
+{
+	const char alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+	std::string result;
+	for (size_t i = 0; i < data.size(); i += 3) {
+		if (linesize && i && (i / 3) % (linesize / 4) == 0) {
+			result += "\r\n";
+		}
+		uint32_t v = static_cast<uint8_t>(data[i]) << 16;
+		if (i + 1 < data.size()) v |= static_cast<uint8_t>(data[i + 1]) << 8;
+		if (i + 2 < data.size()) v |= static_cast<uint8_t>(data[i + 2]);
+		result += alphabet[v >> 18];
+		result += alphabet[(v >> 12) & 0x3f];
+		result += i + 1 < data.size() ? alphabet[(v >> 6) & 0x3f] : '=';
+		result += i + 2 < data.size() ? alphabet[v & 0x3f] : '=';
+	}
+	return result;
+}
+
+} // namespace
+
+TEST_CASE( "Кодирование и декодирование base64", "[tool1cd][lib][Base64]" ) {
+
+	GIVEN ("Строки из RFC 4648") {
+		THEN ("Получаем кодирование с дополнением '='") {
+			const char *sources[] = {"", "f", "fo", "foo", "foob", "fooba", "foobar"};
+			const char *expected[] = {"", "Zg==", "Zm8=", "Zm9v", "Zm9vYg==", "Zm9vYmE=", "Zm9vYmFy"};
+			for (int i = 0; i < 7; i++) {
+				std::string encoded;
+				base64_encode(sources[i], strlen(sources[i]), encoded, 0);
+				REQUIRE(encoded == expected[i]);
+
+				std::string decoded;
+				base64_decode(encoded.data(), encoded.size(), decoded);
+				REQUIRE(decoded == sources[i]);
+			}
+		}
+	}
+
+	GIVEN ("200 байт со всеми значениями") {
+		std::string data;
+		for (int i = 0; i < 200; i++) {
+			data += static_cast<char>(i * 7);
+		}
+
+		WHEN ("Кодируем со строками по 72 символа") {
+			std::string encoded = "<";
+			base64_encode(data.data(), data.size(), encoded, 72);
+
+			THEN ("Строки разделены \\r\\n, декодирование пропускает переводы строк") {
+				REQUIRE(encoded.size() == 1 + 268 + 3 * 2);
+				REQUIRE(encoded.substr(73, 2) == "\r\n");
+				REQUIRE(encoded.substr(147, 2) == "\r\n");
+				REQUIRE(encoded.substr(221, 2) == "\r\n");
+
+				std::string single_line;
+				base64_encode(data.data(), data.size(), single_line, 0);
+				std::string joined = encoded.substr(1);
+				joined.erase(std::remove(joined.begin(), joined.end(), '\n'), joined.end());
+				joined.erase(std::remove(joined.begin(), joined.end(), '\r'), joined.end());
+				REQUIRE(joined == single_line);
+
+				std::string decoded;
+				base64_decode(encoded.data() + 1, encoded.size() - 1, decoded);
+				REQUIRE(decoded == data);
+			}
+		}
+
+		WHEN ("Кодируем в поток UTF-16 и декодируем обратно") {
+			TTempStream in;
+			in.Write(data.data(), data.size());
+			TTempStream encoded;
+			base64_encode(&in, &encoded, 72);
+			encoded.Seek(0, soBeginning);
+			TTempStream decoded;
+			base64_decode(&encoded, &decoded);
+
+			THEN ("Получаем исходные данные") {
+				REQUIRE(encoded.GetSize() == (268 + 3 * 2) * 2);
+				std::string result(decoded.GetSize(), '\0');
+				decoded.Seek(0, soBeginning);
+				decoded.Read(&result[0], result.size());
+				REQUIRE(result == data);
+			}
+		}
+	}
+
+	GIVEN ("Данные всех длин до 200 байт") {
+		std::string data;
+		uint32_t x = 1;
+		for (int i = 0; i < 200; i++) {
+			x = x * 1103515245 + 12345;
+			data += static_cast<char>(x >> 24);
+		}
+
+		THEN ("Кодирование совпадает с побайтовым при любой длине строки") {
+			for (size_t size = 0; size <= data.size(); size++) {
+				std::string part = data.substr(0, size);
+				for (int linesize : {0, 4, 8, 24, 64, 76}) {
+					std::string encoded;
+					base64_encode(part.data(), part.size(), encoded, linesize);
+					REQUIRE(encoded == reference_encode(part, linesize));
+
+					std::string decoded;
+					base64_decode(encoded.data(), encoded.size(), decoded);
+					REQUIRE(decoded == part);
+				}
+			}
+		}
+	}
+}
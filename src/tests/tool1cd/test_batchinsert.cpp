@@ -0,0 +1,157 @@
+/*
+    test_project provides tests for Tool1CD library
+    Copyright © 2009-2017 awa
+    Copyright © 2017-2018 E8 Tools contributors
+
+    This file is part of test_project.
+
+    test_project is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    test_project is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with test_project.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "../catch.hpp"
+#include "testbase.h"
+
+using boost::filesystem::path;
+using namespace std;
+
+namespace {
+
+Index *primary_index(Table *table)
+{
+	for (int32_t i = 0; i < table->get_num_indexes(); i++) {
+		if (table->get_index(i)->is_primary()) {
+			return table->get_index(i);
+		}
+	}
+	return nullptr;
+}
+
+string make_data(const string &key)
+{
+	string data(2000, '-');
+	memcpy(&data[0], key.data(), key.size());
+	return data;
+}
+
+// добавляет пакетом count записей в таблицу _EXTENSIONSINFO, номера ключей повторяются после distinct
+void insert_batch(Table *table, uint8_t series, uint32_t count, uint32_t distinct = 0)
+{
+	table->begin_insert_batch(count);
+	for (uint32_t i = 0; i < count; i++) {
+		// номера ключей идут не по порядку индекса
+		string key = make_test_key(series, distinct ? i % distinct : i * 7919 % count);
+		insert_test_record(table, key, i, make_data(key));
+	}
+	table->end_insert_batch();
+}
+
+// проверяет, что записи по первичному индексу идут строго по возрастанию ключа,
+// и возвращает количество записей серии series с правильным blob
+uint32_t check_table(Table *table, uint8_t series)
+{
+	table->fill_records_index();
+	Index *primary = primary_index(table);
+	REQUIRE( primary != nullptr );
+	REQUIRE( primary->get_numrecords() == table->numrecords_found );
+
+	Field *idrref = table->get_field("_IDRREF");
+	Field *synonym = table->get_field("_EXTSYNONYM");
+	string prev_key;
+	uint32_t found = 0;
+	for (uint32_t j = 0; j < primary->get_numrecords(); j++) {
+		unique_ptr<TableRecord> rec(table->get_record(primary->get_numrec(j)));
+		string key(rec->get_raw(idrref), 16);
+		REQUIRE( prev_key < key );
+		prev_key = key;
+
+		if (key[0] != 0x7f || (uint8_t)key[1] != series) {
+			continue;
+		}
+		auto bp = rec->get<table_blob_file>(synonym);
+		TMemoryStream st;
+		table->readBlob(&st, bp.blob_start, bp.blob_length);
+		REQUIRE( string((const char *)st.GetMemory(), (size_t)st.GetSize()) == make_data(key) );
+		found++;
+	}
+	return found;
+}
+
+} // namespace
+
+TEST_CASE("Пакетное добавление записей", "[tool1cd][Table][batch]")
+{
+	GIVEN( "Копия базы tests/db838/db01/1Cv8.1CD" ) {
+		TestBaseCopy copy;
+		const path &dbpath = copy.dbpath;
+
+		uint32_t old_count;
+		uint32_t old_phys_count;
+		{
+			T_1CD base1CD(dbpath, nullptr, false);
+			Table *table = find_table(base1CD, "_EXTENSIONSINFO");
+			REQUIRE( table != nullptr );
+			table->fill_records_index();
+			old_count = table->numrecords_found;
+			old_phys_count = table->get_phys_numrecords();
+		}
+
+		WHEN( "Добавляем большой пакет (перестроение индекса) и малый пакет (вставка по одной)" ) {
+			{
+				T_1CD base1CD(dbpath, nullptr, true);
+				Table *table = find_table(base1CD, "_EXTENSIONSINFO");
+				table->begin_edit();
+				insert_batch(table, 1, 5000);
+				table->end_edit();
+			}
+			{
+				T_1CD base1CD(dbpath, nullptr, true);
+				Table *table = find_table(base1CD, "_EXTENSIONSINFO");
+				table->begin_edit();
+				insert_batch(table, 2, 1000);
+				table->end_edit();
+			}
+
+			THEN( "После переоткрытия все записи на месте и индекс упорядочен" ) {
+				T_1CD base1CD(dbpath, nullptr, false);
+				Table *table = find_table(base1CD, "_EXTENSIONSINFO");
+				REQUIRE( check_table(table, 1) == 5000 );
+				REQUIRE( check_table(table, 2) == 1000 );
+				REQUIRE( table->numrecords_found == old_count + 6000 );
+			}
+		}
+
+		WHEN( "Добавляем в пакет запись с уже добавленным значением первичного индекса" ) {
+			{
+				T_1CD base1CD(dbpath, nullptr, true);
+				Table *table = find_table(base1CD, "_EXTENSIONSINFO");
+				table->begin_edit();
+				// повтор после того, как часть пакета уже записана в файлы
+				REQUIRE_THROWS( insert_batch(table, 3, 3000, 2500) );
+				table->cancel_edit();
+
+				table->begin_edit();
+				insert_batch(table, 4, 10);
+				table->end_edit();
+			}
+
+			THEN( "Отмененный пакет не попадает в базу, следующий пакет записывается" ) {
+				T_1CD base1CD(dbpath, nullptr, false);
+				Table *table = find_table(base1CD, "_EXTENSIONSINFO");
+				REQUIRE( check_table(table, 3) == 0 );
+				REQUIRE( check_table(table, 4) == 10 );
+				REQUIRE( table->numrecords_found == old_count + 10 );
+				REQUIRE( table->get_phys_numrecords() == old_phys_count + 10 );
+			}
+		}
+	}
+}
@@ -44,3 +44,72 @@ TEST_CASE( "Проверка обработки Двоично-Десятичн
 		}
 	}
 }
+
+TEST_CASE( "Быстрое чтение Двоично-Десятичных чисел", "[tool1cd][lib][BinaryDecimal]" ) {
+
+	GIVEN ("Числа длиной 10 с точностью 3 в упакованном виде") {
+		const int LENGTH = 10;
+		const int PRECISION = 3;
+		unsigned char positive[6];
+		BinaryDecimalNumber(std::string("1234567.89"), true, LENGTH, PRECISION).write_to(positive);
+		unsigned char negative[6];
+		BinaryDecimalNumber negative_bdn(std::string("0.005"), true, LENGTH, PRECISION);
+		negative_bdn.sign = -1;
+		negative_bdn.write_to(negative);
+		unsigned char zero[6];
+		BinaryDecimalNumber(std::string("0"), true, LENGTH, PRECISION).write_to(zero);
+
+		WHEN ("Получаем представление") {
+			std::string presentation = "=";
+			append_decimal_presentation(presentation, positive, LENGTH, PRECISION, true);
+			THEN ("Оно совпадает с BinaryDecimalNumber::get_presentation") {
+				REQUIRE(presentation == "=1234567.89");
+				for (auto raw : {positive, negative, zero}) {
+					std::string fast;
+					append_decimal_presentation(fast, raw, LENGTH, PRECISION, true);
+					REQUIRE(fast == BinaryDecimalNumber(raw, LENGTH, PRECISION, true).get_presentation());
+				}
+			}
+		}
+
+		WHEN ("Получаем целое значение") {
+			int64_t value = 0;
+			THEN ("Получаем все цифры числа со знаком") {
+				REQUIRE(decimal_to_int64(positive, LENGTH, true, value));
+				REQUIRE(value == 1234567890);
+				REQUIRE(decimal_to_int64(negative, LENGTH, true, value));
+				REQUIRE(value == -5);
+			}
+		}
+	}
+
+	GIVEN ("Число из 20 цифр") {
+		unsigned char raw[11];
+		BinaryDecimalNumber(std::string("12345678901234567890"), true, 20, 0).write_to(raw);
+		THEN ("Оно не помещается в int64_t") {
+			int64_t value = 0;
+			REQUIRE_FALSE(decimal_to_int64(raw, 20, true, value));
+		}
+	}
+
+	GIVEN ("Дата '09.01.2018 12:34:56' в упакованном виде") {
+		unsigned char raw[7];
+		BinaryDecimalDate(std::string("09.01.2018 12:34:56")).write_to(raw);
+		THEN ("Разбираем её на части и получаем представления") {
+			decimal_datetime dt = decode_decimal_date(raw);
+			REQUIRE(dt.year == 2018);
+			REQUIRE(dt.month == 1);
+			REQUIRE(dt.day == 9);
+			REQUIRE(dt.hour == 12);
+			REQUIRE(dt.minute == 34);
+			REQUIRE(dt.second == 56);
+
+			std::string presentation;
+			append_date_presentation(presentation, raw);
+			REQUIRE(presentation == "09.01.2018 12:34:56");
+			std::string presentation1C;
+			append_date_presentation1C(presentation1C, raw);
+			REQUIRE(presentation1C == "20180109123456");
+		}
+	}
+}
@@ -35,3 +35,30 @@ TEST_CASE( "Проверка работы BinaryGuid", "[tool1cd][lib][BinaryGui
 	}
 }
 
+
+TEST_CASE( "Представления GUID в порядке 1С и MS", "[tool1cd][lib][BinaryGuid]" ) {
+
+	GIVEN ("Двоичный GUID из байтов 00 01 ... 0e ff") {
+		unsigned char raw[GUID_BINARY_SIZE];
+		for (int i = 0; i < GUID_BINARY_SIZE; i++) {
+			raw[i] = static_cast<unsigned char>(i);
+		}
+		raw[15] = 0xff;
+
+		THEN ("Получаем представления в порядке 1С и MS") {
+			REQUIRE(GUIDas1C(raw) == "0c0d0eff-0a0b-0809-0001-020304050607");
+			REQUIRE(GUIDasMS(raw) == "03020100-0504-0706-0809-0a0b0c0d0eff");
+
+			std::string out = "guid=";
+			append_GUIDasMS(out, raw);
+			REQUIRE(out == "guid=03020100-0504-0706-0809-0a0b0c0d0eff");
+		}
+
+		AND_THEN ("Разбор представлений возвращает исходные байты") {
+			BinaryGuid guid(reinterpret_cast<const char *>(raw));
+			REQUIRE(BinaryGuid(std::string("0C0D0EFF-0A0B-0809-0001-020304050607")) == guid);
+			REQUIRE(BinaryGuid(std::string("000102030405060708090a0b0c0d0eff")) == guid);
+			REQUIRE_THROWS(BinaryGuid(std::string("0c0d0eff")));
+		}
+	}
+}
@@ -0,0 +1,129 @@
+/*
+    test_project provides tests for Tool1CD library
+    Copyright © 2009-2017 awa
+    Copyright © 2017-2018 E8 Tools contributors
+
+    This file is part of test_project.
+
+    test_project is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    test_project is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with test_project.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "../catch.hpp"
+#include "testbase.h"
+#include <algorithm>
+
+using boost::filesystem::path;
+using namespace std;
+
+namespace {
+
+// добавляет в таблицу _EXTENSIONSINFO по записи на каждое значение data, blob _EXTSYNONYM - значение
+void insert_records(const path &dbpath, uint8_t series, const vector<string> &data)
+{
+	T_1CD base1CD(dbpath, nullptr, true);
+	Table *table = find_table(base1CD, "_EXTENSIONSINFO");
+	table->begin_edit();
+	for (uint32_t i = 0; i < data.size(); i++) {
+		vector<char> buf = make_test_record(table, make_test_key(series, i), i, data[i]);
+		TableRecord rec(table, buf.data());
+		table->insert_record(&rec);
+	}
+	table->end_edit();
+}
+
+// физический номер записи с ключом key
+uint32_t find_record(Table *table, const string &key)
+{
+	Field *idrref = table->get_field("_IDRREF");
+	for (uint32_t i = 0; i < table->get_phys_numrecords(); i++) {
+		unique_ptr<TableRecord> rec(table->get_record(i));
+		if (!rec->is_removed() && string(rec->get_raw(idrref), key.size()) == key) {
+			return i;
+		}
+	}
+	return UINT32_MAX;
+}
+
+// чтение цепочки blob по одной записи, без упреждающего чтения; blocks - номера записей цепочки
+string read_chain(V8Object *file_blob, uint32_t block, vector<uint32_t> &blocks)
+{
+	string result;
+	char record[0x100];
+	while (block) {
+		blocks.push_back(block);
+		file_blob->get_data(record, (uint64_t)block << 8, sizeof(record));
+		block = *(uint32_t *)record;
+		result.append(record + 6, *(uint16_t *)(record + 4));
+	}
+	return result;
+}
+
+string make_text(char c, size_t size)
+{
+	string result;
+	for (size_t i = 0; i < size; i++) {
+		result += (char)(c + i % 23);
+	}
+	return result;
+}
+
+} // namespace
+
+TEST_CASE("Чтение blob с цепочкой не по возрастанию", "[tool1cd][Table][blob]")
+{
+	GIVEN( "Копия базы tests/db838/db01/1Cv8.1CD" ) {
+		TestBaseCopy copy;
+
+		WHEN( "Две записи с blob удалены, и новая запись заняла их освободившиеся блоки" ) {
+			insert_records(copy.dbpath, 1, {make_text('a', 600), make_text('A', 600)});
+			{
+				T_1CD base1CD(copy.dbpath, nullptr, true);
+				Table *table = find_table(base1CD, "_EXTENSIONSINFO");
+				table->begin_edit();
+				table->delete_record(find_record(table, make_test_key(1, 0)));
+				table->delete_record(find_record(table, make_test_key(1, 1)));
+				table->end_edit();
+			}
+			string text = make_text('0', 3000);
+			insert_records(copy.dbpath, 2, {text});
+
+			T_1CD base1CD(copy.dbpath, nullptr, false);
+			Table *table = find_table(base1CD, "_EXTENSIONSINFO");
+			uint32_t numrec = find_record(table, make_test_key(2, 0));
+			REQUIRE( numrec != UINT32_MAX );
+			unique_ptr<TableRecord> rec(table->get_record(numrec));
+			auto bp = rec->get<table_blob_file>(table->get_field("_EXTSYNONYM"));
+			REQUIRE( bp.blob_length == text.size() );
+
+			vector<uint32_t> blocks;
+			string expected = read_chain(table->get_file_blob(), bp.blob_start, blocks);
+			REQUIRE( expected == text );
+
+			THEN( "Цепочка идет не по возрастанию, упреждающее чтение дает те же данные" ) {
+				REQUIRE_FALSE( std::is_sorted(blocks.begin(), blocks.end()) );
+
+				TMemoryStream st;
+				table->readBlob(&st, bp.blob_start, bp.blob_length);
+				REQUIRE( string((const char *)st.GetMemory(), (size_t)st.GetSize()) == expected );
+
+				string buf(bp.blob_length, '\0');
+				REQUIRE( table->readBlob(&buf[0], bp.blob_start, bp.blob_length) == bp.blob_length );
+				REQUIRE( buf == expected );
+
+				TMemoryStream object_st;
+				table->get_file_blob()->readBlob(&object_st, bp.blob_start, bp.blob_length);
+				REQUIRE( string((const char *)object_st.GetMemory(), (size_t)object_st.GetSize()) == expected );
+			}
+		}
+	}
+}
@@ -0,0 +1,95 @@
+/*
+    test_project provides tests for Tool1CD library
+    Copyright © 2009-2017 awa
+    Copyright © 2017-2018 E8 Tools contributors
+
+    This file is part of test_project.
+
+    test_project is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    test_project is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with test_project.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "../catch.hpp"
+#include "testbase.h"
+#include <ExportCheckpoint.h>
+#include <boost/filesystem.hpp>
+#include <fstream>
+#include <sstream>
+
+using boost::filesystem::path;
+using namespace std;
+
+namespace {
+
+string read_file(const path &filepath)
+{
+	ifstream in(filepath.string(), ios::binary);
+	stringstream result;
+	result << in.rdbuf();
+	return result.str();
+}
+
+void write_file(const path &filepath, const string &data)
+{
+	ofstream out(filepath.string(), ios::binary);
+	out << data;
+}
+
+} // namespace
+
+TEST_CASE("Продолжение прерванной выгрузки в XML", "[tool1cd][ExportCheckpoint]")
+{
+	GIVEN( "Таблица CONFIG базы tests/db838/db01/1Cv8.1CD, выгруженная целиком" ) {
+		string dbpath(CMAKE_SOURCE_DIR);
+		dbpath += "/tests/db838/db01/1Cv8.1CD";
+		path dir = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+		boost::filesystem::create_directories(dir);
+
+		T_1CD base1CD(dbpath, nullptr, false);
+		Table *table = find_table(base1CD, "CONFIG");
+		REQUIRE( table != nullptr );
+		table->fill_records_index();
+
+		path serial = dir / "serial.xml";
+		table->export_to_xml(serial.string(), false, false);
+		string expected = read_file(serial);
+
+		// конец записи с номером records - граница, на которой сохраняется состояние
+		const string record_end = "</Record>\r\n";
+		uint32_t records = 3;
+		size_t size = 0;
+		for (uint32_t i = 0; i < records; i++) {
+			size = expected.find(record_end, size);
+			REQUIRE( size != string::npos );
+			size += record_end.size();
+		}
+
+		WHEN( "Выгрузка прервана после сохранения состояния: в файле лишний хвост, строка состояния дописана не полностью" ) {
+			path output = dir / "CONFIG.xml";
+			write_file(output, expected.substr(0, size) + "\t\t<Record>\r\n\t\t\t<ID>обрыв");
+			path state = dir / EXPORT_CHECKPOINT_FILE_NAME;
+			write_file(state, "part\t" + to_string(records) + "\t" + to_string(size) + "\tCONFIG.xml\r\n"
+							  + "part\t100\t999999\tCONFIG.xml");
+
+			ExportCheckpoint checkpoint(state);
+			REQUIRE_FALSE( checkpoint.is_done(output.string()) );
+			table->export_to_xml(output.string(), false, false, 1, &checkpoint);
+
+			THEN( "Продолженная выгрузка совпадает с выгрузкой целиком" ) {
+				REQUIRE( read_file(output) == expected );
+				REQUIRE( ExportCheckpoint(state).is_done(output.string()) );
+			}
+		}
+
+		boost::filesystem::remove_all(dir);
+	}
+}
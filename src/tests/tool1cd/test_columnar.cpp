@@ -0,0 +1,143 @@
+/*
+    test_project provides tests for Tool1CD library
+    Copyright © 2009-2017 awa
+    Copyright © 2017-2018 E8 Tools contributors
+
+    This file is part of test_project.
+
+    test_project is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    test_project is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with test_project.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "../catch.hpp"
+#include "testbase.h"
+#include <ColumnarFormat.h>
+
+using boost::filesystem::path;
+using namespace std;
+
+TEST_CASE("Колоночная выгрузка таблицы", "[tool1cd][Table][columnar]")
+{
+	GIVEN( "Таблица CONFIG базы tests/db838/db01/1Cv8.1CD" ) {
+		string dbpath(CMAKE_SOURCE_DIR);
+		dbpath += "/tests/db838/db01/1Cv8.1CD";
+
+		T_1CD base1CD(dbpath, nullptr, true);
+		Table *table = base1CD.table_config;
+		REQUIRE( table != nullptr );
+		table->fill_records_index();
+
+		WHEN( "Выгружаем таблицу и читаем выгрузку" ) {
+			path filepath = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+			table->export_to_columnar(filepath.string(), vector<Field*>(), false);
+
+			ColumnarReader reader(filepath);
+			const vector<ColumnarColumn> &columns = reader.get_columns();
+
+			THEN( "Количество строк и столбцов совпадает с таблицей" ) {
+				REQUIRE( reader.get_table_name() == table->get_name() );
+				REQUIRE( reader.get_num_rows() == table->numrecords_found );
+				REQUIRE( columns.size() == (size_t)table->get_num_fields() );
+			}
+
+			THEN( "Значения совпадают со значениями записей" ) {
+				Field *filename = table->get_field("FILENAME");
+				Field *partno = table->get_field("PARTNO");
+				uint32_t filename_col = 0;
+				uint32_t partno_col = 0;
+				for (uint32_t i = 0; i < columns.size(); i++) {
+					if (columns[i].name == "FILENAME") filename_col = i;
+					if (columns[i].name == "PARTNO") partno_col = i;
+				}
+				REQUIRE( columns[filename_col].type == columnar_type::string );
+				REQUIRE( columns[partno_col].type == columnar_type::int64 );
+
+				ColumnarChunk names = reader.read_chunk(0, filename_col);
+				ColumnarChunk partnos = reader.read_chunk(0, partno_col);
+				Index *primary = nullptr;
+				for (int i = 0; i < table->get_num_indexes(); i++) {
+					if (table->get_index(i)->is_primary()) primary = table->get_index(i);
+				}
+				for (uint32_t j = 0; j < names.num_rows; j++) {
+					unique_ptr<TableRecord> rec(table->get_record(table->get_phys_numrec(j + 1, primary)));
+					REQUIRE( names.values[j] == rec->get_string(filename) );
+					REQUIRE( to_string(partnos.ints[j]) == rec->get_string(partno) );
+				}
+			}
+
+			boost::filesystem::remove(filepath);
+		}
+	}
+}
+
+TEST_CASE("Статистика строковых столбцов колоночной выгрузки", "[tool1cd][Table][columnar]")
+{
+	GIVEN( "Копия базы tests/db838/db01/1Cv8.1CD с длинными строками в таблице _EXTENSIONSINFO" ) {
+		TestBaseCopy copy;
+		const path &dir = copy.dir;
+
+		{
+			T_1CD base1CD(copy.dbpath, nullptr, true);
+			Table *table = find_table(base1CD, "_EXTENSIONSINFO");
+			REQUIRE( table != nullptr );
+
+			table->begin_edit();
+			table->begin_insert_batch();
+			for (int i = 0; i < 10; i++) {
+				// текст в UTF-16LE: 1000 символов, отличающихся только последним
+				string text(1000, 'a');
+				text.back() = (char)('a' + i);
+				string wide;
+				for (char c : text) {
+					wide += c;
+					wide += '\0';
+				}
+				insert_test_record(table, make_test_key(0, i), 0, wide);
+			}
+			table->end_insert_batch();
+			table->end_edit();
+		}
+
+		T_1CD base1CD(copy.dbpath, nullptr, false);
+		Table *table = find_table(base1CD, "_EXTENSIONSINFO");
+		table->fill_records_index();
+
+		WHEN( "Выгружаем таблицу" ) {
+			path filepath = dir / "export.t1cc";
+			table->export_to_columnar(filepath.string(), vector<Field*>(), false);
+
+			ColumnarReader reader(filepath);
+			uint32_t synonym_col = 0;
+			for (uint32_t i = 0; i < reader.get_columns().size(); i++) {
+				if (reader.get_columns()[i].name == "_EXTSYNONYM") synonym_col = i;
+			}
+			REQUIRE( reader.get_columns()[synonym_col].type == columnar_type::string );
+
+			THEN( "min и max усечены и ограничивают значения блока" ) {
+				const ColumnarChunkInfo &info = reader.get_row_groups()[0].chunks[synonym_col];
+				REQUIRE( info.min.size() <= COLUMNAR_STATS_PREFIX );
+				REQUIRE( info.max.size() <= COLUMNAR_STATS_PREFIX );
+
+				ColumnarChunk chunk = reader.read_chunk(0, synonym_col);
+				uint32_t long_values = 0;
+				for (uint32_t j = 0; j < chunk.num_rows; j++) {
+					if (chunk.is_null(j)) continue;
+					const string &value = chunk.values[j];
+					REQUIRE( info.min <= value );
+					REQUIRE( value.substr(0, COLUMNAR_STATS_PREFIX) <= info.max );
+					if (value.size() == 1000) long_values++;
+				}
+				REQUIRE( long_values == 10 );
+			}
+		}
+	}
+}
@@ -0,0 +1,97 @@
+/*
+    test_project provides tests for Tool1CD library
+    Copyright © 2009-2017 awa
+    Copyright © 2017-2018 E8 Tools contributors
+
+    This file is part of test_project.
+
+    test_project is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    test_project is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with test_project.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "../catch.hpp"
+#include <Class_1CD.h>
+#include <boost/filesystem.hpp>
+#include <fstream>
+#include <sstream>
+
+using boost::filesystem::path;
+using namespace std;
+
+namespace {
+
+string read_file(const path &filepath)
+{
+	ifstream in(filepath.string(), ios::binary);
+	stringstream result;
+	result << in.rdbuf();
+	return result.str();
+}
+
+// XML-выгрузка всех таблиц базы, по одной строке на таблицу
+vector<string> export_tables(T_1CD &base, const path &dir)
+{
+	vector<string> result;
+	for (int32_t i = 0; i < base.get_numtables(); i++) {
+		Table *table = base.get_table(i);
+		path filepath = dir / (table->get_name() + ".xml");
+		table->export_to_xml(filepath.string(), false, false);
+		result.push_back(read_file(filepath));
+	}
+	return result;
+}
+
+} // namespace
+
+TEST_CASE("Сжатие базы", "[tool1cd][Class_1CD][compact]")
+{
+	path dir = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+	boost::filesystem::create_directories(dir);
+
+	GIVEN( "Хранилище tests/depotv5/depot/1cv8ddb.1CD (8.2.14)" ) {
+		string dbpath(CMAKE_SOURCE_DIR);
+		dbpath += "/tests/depotv5/depot/1cv8ddb.1CD";
+		path compacted = dir / "compacted.1CD";
+
+		T_1CD base1CD(dbpath, nullptr, false);
+		REQUIRE( base1CD.save_compacted(compacted) );
+
+		THEN( "Сжатая копия не больше исходной и содержит те же таблицы и записи" ) {
+			REQUIRE( boost::filesystem::file_size(compacted) <= boost::filesystem::file_size(dbpath) );
+
+			boost::filesystem::create_directories(dir / "before");
+			boost::filesystem::create_directories(dir / "after");
+			vector<string> before = export_tables(base1CD, dir / "before");
+
+			T_1CD compacted1CD(compacted, nullptr, false);
+			REQUIRE( compacted1CD.is_open() );
+			vector<string> after = export_tables(compacted1CD, dir / "after");
+
+			REQUIRE( before.size() > 0 );
+			REQUIRE( after == before );
+		}
+	}
+
+	GIVEN( "База tests/db838/db01/1Cv8.1CD (8.3.8)" ) {
+		string dbpath(CMAKE_SOURCE_DIR);
+		dbpath += "/tests/db838/db01/1Cv8.1CD";
+
+		T_1CD base1CD(dbpath, nullptr, false);
+
+		THEN( "Сжатие не поддерживается" ) {
+			REQUIRE_THROWS( base1CD.save_compacted(dir / "compacted.1CD") );
+			REQUIRE_FALSE( boost::filesystem::exists(dir / "compacted.1CD") );
+		}
+	}
+
+	boost::filesystem::remove_all(dir);
+}
@@ -0,0 +1,215 @@
+/*
+    test_project provides tests for Tool1CD library
+    Copyright © 2009-2017 awa
+    Copyright © 2017-2018 E8 Tools contributors
+
+    This file is part of test_project.
+
+    test_project is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    test_project is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with test_project.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "../catch.hpp"
+#include "testbase.h"
+#include <map>
+
+using boost::filesystem::path;
+using namespace std;
+
+namespace {
+
+// значение двоичного поля для set_edit_value - шестнадцатеричные цифры без разделителей
+string to_hex(const string &data)
+{
+	static const char digits[] = "0123456789abcdef";
+	string result;
+	for (unsigned char c : data) {
+		result += digits[c >> 4];
+		result += digits[c & 0xf];
+	}
+	return result;
+}
+
+TStream *make_stream(const string &data)
+{
+	TStream *st = new TMemoryStream;
+	st->Write(data.data(), data.size());
+	return st;
+}
+
+string read_synonym(Table *table, const TableRecord &rec)
+{
+	Field *synonym = table->get_field("_EXTSYNONYM");
+	if (rec.is_null_value(synonym)) {
+		return string();
+	}
+	auto bp = rec.get<table_blob_file>(synonym);
+	TMemoryStream st;
+	table->readBlob(&st, bp.blob_start, bp.blob_length);
+	return string((const char *)st.GetMemory(), (size_t)st.GetSize());
+}
+
+// значения _EXTENSIONORDER и _EXTSYNONYM записи
+struct TestValues
+{
+	string order;
+	string synonym;
+
+	bool operator==(const TestValues &other) const
+	{
+		return order == other.order && synonym == other.synonym;
+	}
+};
+
+} // namespace
+
+TEST_CASE("Журнал изменений таблицы", "[tool1cd][Table][edit]")
+{
+	GIVEN( "Копия базы tests/db838/db01/1Cv8.1CD с 40 добавленными записями" ) {
+		TestBaseCopy copy;
+		const uint32_t count = 40;
+		const uint32_t inserted = 12;
+		const uint32_t removed_inserted = 5;
+		{
+			T_1CD base1CD(copy.dbpath, nullptr, true);
+			Table *table = find_table(base1CD, "_EXTENSIONSINFO");
+			table->begin_edit();
+			table->begin_insert_batch(count);
+			for (uint32_t i = 0; i < count; i++) {
+				insert_test_record(table, make_test_key(1, i), i, "s" + to_string(i));
+			}
+			table->end_edit();
+		}
+
+		WHEN( "В одном сеансе записи изменены, удалены и добавлены, одна из добавленных удалена" ) {
+			{
+				T_1CD base1CD(copy.dbpath, nullptr, true);
+				Table *table = find_table(base1CD, "_EXTENSIONSINFO");
+				int32_t order = field_number(table, "_EXTENSIONORDER");
+				int32_t synonym = field_number(table, "_EXTSYNONYM");
+				Field *idrref = table->get_field("_IDRREF");
+
+				map<string, uint32_t> numrecs;
+				for (uint32_t i = 0; i < table->get_phys_numrecords(); i++) {
+					unique_ptr<TableRecord> rec(table->get_record(i));
+					if (!rec->is_removed()) {
+						numrecs[string(rec->get_raw(idrref), 16)] = i;
+					}
+				}
+				REQUIRE( numrecs.size() >= count );
+
+				table->begin_edit();
+				for (uint32_t i = 0; i < count; i++) {
+					uint32_t numrec = numrecs[make_test_key(1, i)];
+					switch (i % 4) {
+						case 0:
+							table->set_edit_value(numrec, order, false, to_string(1000 + i));
+							break;
+						case 1:
+							table->set_rec_type(numrec, changed_rec_type::deleted);
+							break;
+						case 2:
+							table->set_edit_value(numrec, synonym, false, "", make_stream("new" + to_string(i)));
+							break;
+					}
+				}
+
+				uint32_t phys_numrecords = table->get_phys_numrecords();
+				for (uint32_t j = 0; j < inserted; j++) {
+					uint32_t numrec = phys_numrecords + table->get_added_numrecords();
+					table->set_rec_type(numrec, changed_rec_type::inserted);
+					table->set_edit_value(numrec, field_number(table, "_IDRREF"), false, to_hex(make_test_key(2, j)));
+					table->set_edit_value(numrec, order, false, to_string(5000 + j));
+					table->set_edit_value(numrec, synonym, false, "", make_stream("ins" + to_string(j)));
+				}
+
+				for (uint32_t i = 0; i < count; i++) {
+					uint32_t numrec = numrecs[make_test_key(1, i)];
+					switch (i % 4) {
+						case 0:
+							REQUIRE( table->get_rec_type(numrec) == changed_rec_type::changed );
+							REQUIRE( table->get_rec_type(numrec, order) == changed_rec_type::changed );
+							REQUIRE( table->get_rec_type(numrec, synonym) == changed_rec_type::not_changed );
+							break;
+						case 1:
+							REQUIRE( table->get_rec_type(numrec) == changed_rec_type::deleted );
+							break;
+						case 2:
+							REQUIRE( table->get_rec_type(numrec) == changed_rec_type::changed );
+							REQUIRE( table->get_rec_type(numrec, synonym) == changed_rec_type::changed );
+							break;
+						default:
+							REQUIRE( table->get_rec_type(numrec) == changed_rec_type::not_changed );
+					}
+				}
+				for (uint32_t j = 0; j < inserted; j++) {
+					REQUIRE( table->get_rec_type(phys_numrecords + j) == changed_rec_type::inserted );
+				}
+
+				// удаление добавленной записи сдвигает номера следующих за ней
+				table->set_rec_type(phys_numrecords + removed_inserted, changed_rec_type::deleted);
+				REQUIRE( table->get_added_numrecords() == inserted - 1 );
+				REQUIRE( table->get_rec_type(phys_numrecords + inserted - 1) == changed_rec_type::not_changed );
+				for (uint32_t j = 0; j < inserted - 1; j++) {
+					REQUIRE( table->get_rec_type(phys_numrecords + j) == changed_rec_type::inserted );
+					unique_ptr<TableRecord> rec(table->get_edit_record(phys_numrecords + j));
+					uint32_t n = j < removed_inserted ? j : j + 1;
+					REQUIRE( rec->get_string(table->get_field(order)) == to_string(5000 + n) );
+				}
+
+				table->end_edit();
+				REQUIRE( table->get_rec_type(numrecs[make_test_key(1, 0)]) == changed_rec_type::not_changed );
+			}
+
+			THEN( "После закрытия в базе записаны все изменения сеанса" ) {
+				T_1CD base1CD(copy.dbpath, nullptr, false);
+				Table *table = find_table(base1CD, "_EXTENSIONSINFO");
+				Field *idrref = table->get_field("_IDRREF");
+				Field *order = table->get_field("_EXTENSIONORDER");
+
+				map<string, TestValues> existing;
+				for (uint32_t i = 0; i < table->get_phys_numrecords(); i++) {
+					unique_ptr<TableRecord> rec(table->get_record(i));
+					if (rec->is_removed()) {
+						continue;
+					}
+					string key(rec->get_raw(idrref), 16);
+					TestValues values = {rec->get_string(order), read_synonym(table, *rec)};
+					if (key[0] == 0x7f) {
+						existing[key] = values;
+					}
+				}
+
+				map<string, TestValues> expected_existing;
+				for (uint32_t i = 0; i < count; i++) {
+					switch (i % 4) {
+						case 0:
+							expected_existing[make_test_key(1, i)] = {to_string(1000 + i), "s" + to_string(i)};
+							break;
+						case 2:
+							expected_existing[make_test_key(1, i)] = {to_string(i), "new" + to_string(i)};
+							break;
+						case 3:
+							expected_existing[make_test_key(1, i)] = {to_string(i), "s" + to_string(i)};
+							break;
+					}
+				}
+				for (uint32_t j = 0; j < inserted; j++) {
+					if (j != removed_inserted) {
+						expected_existing[make_test_key(2, j)] = {to_string(5000 + j), "ins" + to_string(j)};
+					}
+				}
+				REQUIRE( existing == expected_existing );
+			}
+		}
+	}
+}
@@ -21,7 +21,9 @@
 #include "../catch.hpp"
 #include <Parse_tree.h>
 #include <Field.h>
+#include <RecordDecoder.h>
 #include <string>
+#include <cstring>
 using namespace std;
 
 static Field *load_field(const string &description)
@@ -114,3 +116,91 @@ TEST_CASE( "Проверка преобразований полей", "[tool1cd
 		}
 	}
 }
+
+TEST_CASE( "Дописывание представления полей в буфер", "[tool1cd][Fields][Types]")
+{
+	GIVEN ("Описание поля binary(4)") {
+		Field *fld = load_field("{\"AnyName\",\"B\",0,4,0,\"CS\"}");
+		const char buf[] = {'\x01', '\xab', '\x00', '\xff'};
+
+		WHEN ("Дописываем представление в непустую строку") {
+			string result = "prefix:";
+			fld->append_presentation(result, buf);
+
+			THEN ("Получаем шестнадцатеричное представление без лишних символов") {
+				REQUIRE (result == "prefix:01ab00ff");
+				REQUIRE (fld->get_presentation(buf) == "01ab00ff");
+			}
+		}
+	}
+
+	GIVEN ("Описание поля version") {
+		Field *fld = load_field("{\"_VERSION\",\"RV\",0,0,0,\"CS\"}");
+		const int32_t buf[] = {1, 0, -6, 2147483647};
+
+		WHEN ("Дописываем представление в строку") {
+			string result;
+			fld->append_presentation(result, reinterpret_cast<const char*>(buf));
+
+			THEN ("Получаем четыре числа через двоеточие") {
+				REQUIRE (result == "1:0:-6:2147483647");
+			}
+		}
+	}
+}
+
+TEST_CASE( "Декодирование записи по программе RecordDecoder", "[tool1cd][Fields][Types]")
+{
+	GIVEN ("Поля string(3) с NULL, number(5,2) и bool") {
+		Field *name = load_field("{\"NAME\",\"NVC\",1,3,0,\"CI\"}");
+		Field *sum = load_field("{\"SUM\",\"N\",0,5,2,\"CS\"}");
+		Field *flag = load_field("{\"FLAG\",\"L\",0,0,0,\"CS\"}");
+		name->set_offset(0);
+		sum->set_offset(name->get_size());
+		flag->set_offset(sum->get_size() + name->get_size());
+		vector<Field*> fields = {name, sum, flag};
+
+		// name = "a<b", sum = -123.4, flag = true
+		char rec[32] = {};
+		rec[0] = 1;
+		rec[1] = 3;
+		const char16_t text[] = u"a<b";
+		memcpy(rec + 3, text, 6);
+		sum->get_binary_value(rec + sum->get_offset(), false, "123.4");
+		rec[sum->get_offset()] &= 0x0f; // отрицательное
+		rec[flag->get_offset()] = 1;
+
+		WHEN ("Декодируем запись в форматах xml и text") {
+			RecordDecoder xml(fields, decode_format::xml);
+			RecordDecoder text(fields, decode_format::text);
+
+			THEN ("Значения совпадают с представлениями полей") {
+				REQUIRE (xml.size() == 3);
+				for (size_t i = 0; i < fields.size(); i++) {
+					REQUIRE_FALSE (xml.is_null(i, rec));
+					string xml_value;
+					xml.append_value(xml_value, i, rec);
+					REQUIRE (xml_value == fields[i]->get_XML_presentation(rec));
+					string text_value;
+					text.append_value(text_value, i, rec);
+					string expected;
+					fields[i]->append_text_presentation(expected, rec);
+					REQUIRE (text_value == expected);
+				}
+				string value;
+				xml.append_value(value, 0, rec);
+				REQUIRE (value == "a&lt;b");
+				value.clear();
+				xml.append_value(value, 1, rec);
+				REQUIRE (value == "-123.4");
+			}
+
+			AND_WHEN ("Значение поля NULL") {
+				rec[0] = 0;
+				THEN ("Декодер определяет NULL по признаку в записи") {
+					REQUIRE (xml.is_null(0, rec));
+				}
+			}
+		}
+	}
+}
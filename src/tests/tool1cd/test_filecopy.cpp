@@ -0,0 +1,97 @@
+/*
+    test_project provides tests for Tool1CD library
+    Copyright © 2009-2017 awa
+    Copyright © 2017-2018 E8 Tools contributors
+
+    This file is part of test_project.
+
+    test_project is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    test_project is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with test_project.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "../catch.hpp"
+#include <Class_1CD.h>
+#include <GzipStream.h>
+#include <FileCopy.h>
+#include <boost/filesystem.hpp>
+#include <fstream>
+#include <sstream>
+
+using boost::filesystem::path;
+using namespace std;
+
+namespace {
+
+string read_file(const path &filepath)
+{
+	ifstream in(filepath.string(), ios::binary);
+	stringstream result;
+	result << in.rdbuf();
+	return result.str();
+}
+
+// содержимое файла или его распакованной копии <файл>.gz
+string read_import_file(const path &filepath)
+{
+	unique_ptr<TStream> stream = open_import_stream(filepath);
+	string result(stream->GetSize(), '\0');
+	if (!result.empty()) {
+		stream->Read(&result[0], result.size());
+	}
+	return result;
+}
+
+} // namespace
+
+TEST_CASE("Выгрузка файлов таблиц копированием участков файла базы", "[tool1cd][Table][FileCopy]")
+{
+	GIVEN( "База tests/db838/db01/1Cv8.1CD" ) {
+		string dbpath(CMAKE_SOURCE_DIR);
+		dbpath += "/tests/db838/db01/1Cv8.1CD";
+		path dir = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+		boost::filesystem::create_directories(dir / "copy");
+		boost::filesystem::create_directories(dir / "pages");
+
+		T_1CD base1CD(dbpath, nullptr, false);
+
+		WHEN( "Выгружаем таблицы без сжатия (по участкам) и со сжатием (постранично)" ) {
+			for (int32_t i = 0; i < base1CD.get_numtables(); i++) {
+				Table *table = base1CD.get_table(i);
+				table->export_table(dir / "copy");
+				table->export_table(dir / "pages", true);
+			}
+
+			THEN( "Файлы объектов совпадают" ) {
+				size_t files = 0;
+				for (int32_t i = 0; i < base1CD.get_numtables(); i++) {
+					string name = base1CD.get_table(i)->get_name();
+					for (auto &entry : boost::filesystem::directory_iterator(dir / "copy" / name)) {
+						string filename = entry.path().filename().string();
+						if (filename == "root") {
+							continue;
+						}
+						REQUIRE( read_file(entry.path()) == read_import_file(dir / "pages" / name / filename) );
+						files++;
+					}
+				}
+				REQUIRE( files > 0 );
+
+				// файлы данных базы 8.3.8 копируются по участкам, а не постранично
+				vector<file_extent> extents;
+				REQUIRE( base1CD.get_table(0)->get_file_data()->get_file_extents(extents) );
+				REQUIRE( extents.size() > 0 );
+			}
+		}
+
+		boost::filesystem::remove_all(dir);
+	}
+}
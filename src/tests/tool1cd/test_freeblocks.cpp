@@ -0,0 +1,96 @@
+/*
+    test_project provides tests for Tool1CD library
+    Copyright © 2009-2017 awa
+    Copyright © 2017-2018 E8 Tools contributors
+
+    This file is part of test_project.
+
+    test_project is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    test_project is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with test_project.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "../catch.hpp"
+#include "testbase.h"
+#include <V8Object.h>
+#include <algorithm>
+
+using namespace std;
+
+namespace {
+
+vector<char> make_data(size_t size, char seed)
+{
+	vector<char> result(size);
+	for (size_t i = 0; i < size; i++) {
+		result[i] = (char)(seed + i * 7 + i / 4096);
+	}
+	return result;
+}
+
+} // namespace
+
+TEST_CASE("Размещение файла в освобожденных страницах", "[tool1cd][V8Object][free]")
+{
+	// в формате 8.3.8 освобожденные страницы не учитываются, поэтому нужна база 8.2.14
+	GIVEN( "Копия базы tests/depotv5/depot/1cv8ddb.1CD" ) {
+		TestBaseCopy copy("tests/depotv5/depot/1cv8ddb.1CD");
+		const uint32_t pages = 40;
+		uint32_t block = 0;
+		uint64_t size = 0;
+		vector<char> data;
+
+		WHEN( "Страницы одного файла освобождаются и записывается новый файл на несколько страниц" ) {
+			vector<file_extent> freed;
+			vector<file_extent> extents;
+			uint64_t numblocks = 0;
+			{
+				T_1CD base1CD(copy.dbpath);
+				uint64_t pagesize = base1CD.get_pagesize();
+				// первая освобожденная страница может уйти под саму таблицу свободных страниц,
+				// поэтому новый файл меньше освобожденного
+				size = (pages - 2) * pagesize - 100;
+				data = make_data(size, 'a');
+
+				V8Object first(&base1CD);
+				vector<char> first_data = make_data(pages * pagesize, 'z');
+				first.set_data(first_data.data(), 0, first_data.size());
+				REQUIRE( first.get_file_extents(freed) );
+
+				V8Object second(&base1CD);
+				block = second.get_block_number();
+				first.set_len(0);
+				numblocks = base1CD.getMemBlockManager().get_numblocks();
+
+				second.set_data(data.data(), 0, data.size());
+				REQUIRE( second.get_file_extents(extents) );
+				REQUIRE( base1CD.getMemBlockManager().get_numblocks() == numblocks );
+				base1CD.flush();
+			}
+
+			THEN( "Страницы нового файла идут подряд и заняты из освобожденных" ) {
+				REQUIRE( freed.size() == 1 );
+				REQUIRE( extents.size() == 1 );
+				REQUIRE( extents[0].offset == freed[0].offset );
+				REQUIRE( extents[0].length == size );
+			}
+
+			THEN( "После повторного открытия файл читается без изменений" ) {
+				T_1CD base1CD(copy.dbpath);
+				V8Object second(&base1CD, block);
+				REQUIRE( second.get_len() == size );
+				vector<char> result(size);
+				second.get_data(result.data(), 0, size);
+				REQUIRE( result == data );
+			}
+		}
+	}
+}
@@ -0,0 +1,118 @@
+/*
+    test_project provides tests for Tool1CD library
+    Copyright © 2009-2017 awa
+    Copyright © 2017-2018 E8 Tools contributors
+
+    This file is part of test_project.
+
+    test_project is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    test_project is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with test_project.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "../catch.hpp"
+#include <GzipStream.h>
+#include <boost/filesystem.hpp>
+
+using boost::filesystem::path;
+using namespace std;
+
+namespace {
+
+// данные на несколько блоков сжатия и неполный хвост
+string make_data()
+{
+	string result;
+	size_t size = GZIP_BLOCK_SIZE * 5 + 12345;
+	result.reserve(size);
+	uint32_t x = 1;
+	while (result.size() < size) {
+		x = x * 1103515245 + 12345;
+		result += "запись " + to_string(x % 1000) + ";";
+	}
+	result.resize(size);
+	return result;
+}
+
+// запись порциями разного размера, чтобы границы порций не совпадали с границами блоков
+void write_data(TStream &stream, const string &data)
+{
+	size_t pos = 0;
+	size_t part = 1;
+	while (pos < data.size()) {
+		size_t n = min(part, data.size() - pos);
+		stream.Write(data.data() + pos, n);
+		pos += n;
+		part = part * 3 + 7;
+	}
+}
+
+string read_back(const path &filepath)
+{
+	unique_ptr<TStream> stream = open_import_stream(filepath);
+	string result(stream->GetSize(), '\0');
+	stream->Read(&result[0], result.size());
+	return result;
+}
+
+} // namespace
+
+TEST_CASE("Сжатие в gzip и чтение обратно", "[tool1cd][GzipStream]")
+{
+	path dir = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+	boost::filesystem::create_directories(dir);
+	string data = make_data();
+	// пул из нескольких потоков, даже если процессор один
+	uint32_t default_threads = GzipStream::get_default_threads();
+	GzipStream::set_default_threads(4);
+
+	GIVEN( "Данные на несколько блоков с хвостом" ) {
+
+		WHEN( "Данные сжаты в общем пуле потоков" ) {
+			{
+				GzipStream stream(dir / "data.gz");
+				write_data(stream, data);
+			}
+			THEN( "open_import_stream возвращает исходные данные" ) {
+				REQUIRE( boost::filesystem::file_size(dir / "data.gz") < data.size() );
+				REQUIRE( read_back(dir / "data") == data );
+			}
+		}
+
+		WHEN( "Данные сжаты в вызывающем потоке" ) {
+			{
+				GzipStream stream(dir / "data.gz", -1, 1);
+				write_data(stream, data);
+			}
+			THEN( "open_import_stream возвращает исходные данные" ) {
+				REQUIRE( read_back(dir / "data") == data );
+			}
+		}
+
+		WHEN( "В общий пул одновременно пишут два потока" ) {
+			string other(data.rbegin(), data.rend());
+			{
+				GzipStream first(dir / "first.gz");
+				GzipStream second(dir / "second.gz");
+				write_data(first, data);
+				write_data(second, other);
+				second.Close();
+			}
+			THEN( "Каждый файл содержит свои данные" ) {
+				REQUIRE( read_back(dir / "first") == data );
+				REQUIRE( read_back(dir / "second") == other );
+			}
+		}
+	}
+
+	GzipStream::set_default_threads(default_threads);
+	boost::filesystem::remove_all(dir);
+}
@@ -0,0 +1,206 @@
+/*
+    test_project provides tests for Tool1CD library
+    Copyright © 2009-2017 awa
+    Copyright © 2017-2018 E8 Tools contributors
+
+    This file is part of test_project.
+
+    test_project is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    test_project is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with test_project.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "../catch.hpp"
+#include "testbase.h"
+#include <FieldType.h>
+#include <fstream>
+
+using boost::filesystem::path;
+using namespace std;
+
+namespace {
+
+// изменение копии базы: удаление записей с ключами deleted, добавление записей с ключами inserted
+void change_table(const path &dbpath, const vector<uint8_t> &deleted, const vector<uint8_t> &inserted)
+{
+	T_1CD base1CD(dbpath, nullptr, true);
+	Table *table = find_table(base1CD, "_EXTENSIONSINFO");
+	Field *idrref = table->get_field("_IDRREF");
+	table->fill_records_index();
+	table->begin_edit();
+
+	// удаление меняет количество записей, поэтому номера удаляемых записей собираются заранее
+	vector<uint32_t> numrecs;
+	for (uint32_t j = 0; j < table->numrecords_found; j++) {
+		uint32_t numrec = table->get_phys_numrec(j + 1, nullptr);
+		unique_ptr<TableRecord> rec(table->get_record(numrec));
+		const char *key = rec->get_raw(idrref);
+		if (key[0] == 0x7f && std::find(deleted.begin(), deleted.end(), (uint8_t)key[15]) != deleted.end()) {
+			numrecs.push_back(numrec);
+		}
+	}
+	for (auto numrec : numrecs) {
+		table->delete_record(numrec);
+	}
+
+	table->begin_insert_batch();
+	for (auto k : inserted) {
+		insert_test_record(table, make_test_key(0, k), 0);
+	}
+	table->end_insert_batch();
+	table->end_edit();
+}
+
+// строки выгрузки изменений с операцией op
+vector<string> changes(const path &filepath, const string &op)
+{
+	vector<string> result;
+	ifstream in(filepath.string());
+	string line;
+	while (getline(in, line)) {
+		if (line.find("\"_OP\":\"" + op + "\"") != string::npos) {
+			result.push_back(line);
+		}
+	}
+	return result;
+}
+
+size_t all_changes(const path &filepath)
+{
+	return changes(filepath, "insert").size() + changes(filepath, "update").size() + changes(filepath, "delete").size();
+}
+
+} // namespace
+
+TEST_CASE("Инкрементальная выгрузка таблицы", "[tool1cd][Table][incremental]")
+{
+	GIVEN( "Копия базы tests/db838/db01/1Cv8.1CD и выгрузка таблицы _EXTENSIONSINFO" ) {
+		TestBaseCopy copy;
+		const path &dir = copy.dir;
+		const path &dbpath = copy.dbpath;
+		change_table(dbpath, {}, {1, 2, 3});
+
+		path manifest = dir / "_EXTENSIONSINFO.manifest";
+		auto export_changes = [&](const path &filepath) {
+			T_1CD base1CD(dbpath, nullptr, false);
+			Table *table = find_table(base1CD, "_EXTENSIONSINFO");
+			table->fill_records_index();
+			table->export_changes(filepath.string(), manifest.string(), text_format::jsonl, vector<Field*>(), blob_export::skip, false);
+			return table->numrecords_found;
+		};
+
+		uint32_t count = export_changes(dir / "first.jsonl");
+		REQUIRE( changes(dir / "first.jsonl", "insert").size() == count );
+		REQUIRE( all_changes(dir / "first.jsonl") == count );
+
+		WHEN( "Между выгрузками меняется представление GUID" ) {
+			bool showGUID = FieldType::showGUID;
+			bool showGUIDasMS = FieldType::showGUIDasMS;
+			FieldType::showGUID = !showGUID;
+			FieldType::showGUIDasMS = !showGUIDasMS;
+			export_changes(dir / "second.jsonl");
+			FieldType::showGUID = showGUID;
+			FieldType::showGUIDasMS = showGUIDasMS;
+
+			THEN( "Изменений нет" ) {
+				REQUIRE( all_changes(dir / "second.jsonl") == 0 );
+			}
+		}
+
+		WHEN( "Между выгрузками записи добавляются, изменяются и удаляются" ) {
+			change_table(dbpath, {1, 2}, {2, 4}); // запись 2 удаляется и добавляется заново с новой версией
+			export_changes(dir / "second.jsonl");
+
+			THEN( "Выгружаются только изменения" ) {
+				vector<string> inserted = changes(dir / "second.jsonl", "insert");
+				vector<string> updated = changes(dir / "second.jsonl", "update");
+				vector<string> deleted = changes(dir / "second.jsonl", "delete");
+				REQUIRE( inserted.size() == 1 );
+				REQUIRE( updated.size() == 1 );
+				REQUIRE( deleted.size() == 1 );
+
+				// ключ удаленной записи восстанавливается из манифеста и совпадает с ключом первой выгрузки
+				string deleted_key = deleted[0].substr(deleted[0].find("\"_IDRREF\":"));
+				deleted_key = deleted_key.substr(0, deleted_key.find(','));
+				REQUIRE( deleted_key.find("null") == string::npos );
+				vector<string> first = changes(dir / "first.jsonl", "insert");
+				REQUIRE( std::count_if(first.begin(), first.end(), [&](const string &line) {
+					return line.find(deleted_key) != string::npos;
+				}) == 1 );
+			}
+
+			THEN( "Следующая выгрузка без изменений пуста" ) {
+				export_changes(dir / "third.jsonl");
+				REQUIRE( all_changes(dir / "third.jsonl") == 0 );
+			}
+		}
+	}
+}
+
+TEST_CASE("Инкрементальная выгрузка таблицы без поля версии", "[tool1cd][Table][incremental]")
+{
+	GIVEN( "Копия базы tests/db838/db01/1Cv8.1CD и выгрузка таблицы DBSCHEMA" ) {
+		TestBaseCopy copy;
+		path manifest = copy.dir / "DBSCHEMA.manifest";
+		auto export_changes = [&](const path &filepath) {
+			T_1CD base1CD(copy.dbpath, nullptr, false);
+			Table *table = find_table(base1CD, "DBSCHEMA");
+			table->fill_records_index();
+			table->export_changes(filepath.string(), manifest.string(), text_format::jsonl, vector<Field*>(), blob_export::skip, false);
+		};
+		export_changes(copy.dir / "first.jsonl");
+
+		WHEN( "Данные blob записи заменяются другими данными той же длины" ) {
+			uint32_t numrec = UINT32_MAX;
+			string blob_ref;
+			{
+				T_1CD base1CD(copy.dbpath, nullptr, true);
+				Table *table = find_table(base1CD, "DBSCHEMA");
+				Field *data = table->get_field("SERIALIZEDDATA");
+				table_blob_file bp = {0, 0};
+				for (uint32_t i = 1; i < table->get_phys_numrecords() && numrec == UINT32_MAX; i++) {
+					unique_ptr<TableRecord> rec(table->get_record(i));
+					if (!rec->is_removed() && rec->get<table_blob_file>(data).blob_length > 0) {
+						numrec = i;
+						bp = rec->get<table_blob_file>(data);
+						blob_ref.assign(rec->get_raw(data), data->get_size());
+					}
+				}
+				REQUIRE( numrec != UINT32_MAX );
+
+				string value(bp.blob_length, '\0');
+				table->readBlob(&value[0], bp.blob_start, bp.blob_length);
+				for (auto &c : value) {
+					c = ~c;
+				}
+				TStream *st = new TMemoryStream;
+				st->Write(value.data(), value.size());
+
+				table->begin_edit();
+				table->set_edit_value(numrec, field_number(table, "SERIALIZEDDATA"), false, "", st);
+				table->end_edit();
+			}
+			export_changes(copy.dir / "second.jsonl");
+
+			THEN( "Ссылка на blob не меняется, а запись выгружается как измененная" ) {
+				{
+					T_1CD base1CD(copy.dbpath, nullptr, false);
+					Table *table = find_table(base1CD, "DBSCHEMA");
+					Field *data = table->get_field("SERIALIZEDDATA");
+					unique_ptr<TableRecord> rec(table->get_record(numrec));
+					REQUIRE( string(rec->get_raw(data), data->get_size()) == blob_ref );
+				}
+				REQUIRE( changes(copy.dir / "second.jsonl", "update").size() == 1 );
+				REQUIRE( all_changes(copy.dir / "second.jsonl") == 1 );
+			}
+		}
+	}
+}
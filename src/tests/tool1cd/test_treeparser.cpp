@@ -20,6 +20,7 @@
 */
 #include "../catch.hpp"
 #include <Parse_tree.h>
+#include <TreeReader.h>
 #include <string>
 #include <SystemClasses/TMemoryStream.hpp>
 #include <SystemClasses/System.SysUtils.hpp>
@@ -50,3 +51,159 @@ TEST_CASE( "Проверка Parse_tree", "[tool1cd][common][Parse_tree]" ) {
 		}
 	}
 }
+
+TEST_CASE( "Типы значений Parse_tree", "[tool1cd][common][Parse_tree]" ) {
+
+	std::string values = "{1,-12,1.5e-3,2.,\"a\"\"b\",0123abcd-0000-1111-2222-333344445555,"
+			"#base64:QUJD\r\nRA==,12:0123456789abcdef0123456789ABCDEF,abc+/=,#data:AQID,,";
+	std::string source = values + "{2}}";
+
+	GIVEN ("Дерево со значениями всех типов") {
+		auto tree = parse_1Ctext(source, "");
+		Tree *list = tree->get_first();
+		REQUIRE(list->get_num_subnode() == 12);
+
+		THEN ("Типы значений определены") {
+			const node_type types[] = {
+				node_type::nd_number, node_type::nd_number, node_type::nd_number_exp, node_type::nd_number_exp,
+				node_type::nd_string, node_type::nd_guid, node_type::nd_binary, node_type::nd_link,
+				node_type::nd_binary2, node_type::nd_binary_d, node_type::nd_empty, node_type::nd_list
+			};
+			for(int i = 0; i < 12; i++) {
+				REQUIRE(list->get_subnode(i)->get_type() == types[i]);
+			}
+		}
+
+		THEN ("Строки без кавычек, удвоенные кавычки заменены") {
+			REQUIRE((*list)[4].get_value() == "a\"b");
+			REQUIRE((*list)[1].get_value() == "-12");
+			REQUIRE(list->get_subnode("-12") == list->get_subnode(1));
+		}
+
+		THEN ("Текст восстанавливается") {
+			REQUIRE(outtext(tree.get()) == values + "\r\n{2}\r\n}");
+		}
+
+		AND_WHEN ("Меняем разобранное дерево") {
+			list->get_subnode(0)->set_value("2", node_type::nd_number);
+			list->add_child("x", node_type::nd_string);
+			delete list->get_subnode(11);
+
+			THEN ("Изменения видны в тексте") {
+				REQUIRE(outtext(tree.get()).substr(0, 4) == "{2,-");
+				REQUIRE(list->get_last()->get_value() == "x");
+				REQUIRE(list->get_num_subnode() == 12);
+			}
+		}
+	}
+
+	GIVEN ("Значение неизвестного типа") {
+		REQUIRE_THROWS(parse_1Ctext(std::string("{1x y,2}"), ""));
+		REQUIRE_THROWS(parse_1Ctext(std::string("{1}}"), ""));
+	}
+}
+
+TEST_CASE( "Последовательный разбор TreeReader", "[tool1cd][common][Parse_tree][TreeReader]" ) {
+
+	std::string source = "{1,{\"a\"\"b\",{2,3}},,{4}}";
+
+	GIVEN ("Текст в потоке") {
+		TBytesStream bs(TEncoding::UTF8->fromUtf8(source));
+		TreeReader reader(&bs, "");
+
+		THEN ("События соответствуют дереву") {
+			REQUIRE(reader.next() == tree_event::list_begin);
+			REQUIRE(reader.next() == tree_event::value);
+			REQUIRE(reader.get_type() == node_type::nd_number);
+			REQUIRE(reader.get_value() == "1");
+			REQUIRE(reader.next() == tree_event::list_begin);
+			REQUIRE(reader.get_level() == 2);
+			REQUIRE(reader.next() == tree_event::value);
+			REQUIRE(reader.get_type() == node_type::nd_string);
+			REQUIRE(reader.get_value() == "a\"b");
+			reader.skip();
+			REQUIRE(reader.get_level() == 1);
+			REQUIRE(reader.next() == tree_event::value);
+			REQUIRE(reader.get_type() == node_type::nd_empty);
+			REQUIRE(reader.skip_item());
+			REQUIRE_FALSE(reader.skip_item());
+			REQUIRE(reader.next() == tree_event::end);
+		}
+	}
+
+	GIVEN ("Ошибка формата в непрочитанной части") {
+		std::string text = "{1},{2}}";
+		TreeReader reader(text, "");
+		REQUIRE(reader.skip_item());
+		REQUIRE(reader.skip_item());
+		REQUIRE_THROWS(reader.next());
+	}
+}
+
+TEST_CASE( "Доступ к подчиненным Tree по номеру и имени", "[tool1cd][common][Parse_tree]" ) {
+
+	std::string source = "{";
+	for(int i = 0; i < 1000; i++) {
+		if(i) source += ",";
+		source += "\"n" + std::to_string(i % 500) + "\"";
+	}
+	source += "}";
+
+	GIVEN ("Широкий список") {
+		auto tree = parse_1Ctext(source, "");
+		Tree *list = tree->get_first();
+
+		THEN ("Подчиненные доступны по номеру и имени") {
+			REQUIRE(list->get_subnode(999)->get_value() == "n499");
+			REQUIRE((*list)[600].get_value() == "n100");
+			REQUIRE(list->get_subnode(1000) == nullptr);
+			REQUIRE(list->get_subnode(-1) == nullptr);
+			REQUIRE(list->get_subnode("n100") == list->get_subnode(100));
+			REQUIRE(list->get_subnode("x") == nullptr);
+		}
+
+		AND_WHEN ("Дерево меняется после построения индекса") {
+			REQUIRE(list->get_subnode("n7") == list->get_subnode(7));
+			delete list->get_subnode(7);
+			list->add_child("x", node_type::nd_string);
+			list->get_subnode(0)->set_value("y", node_type::nd_string);
+
+			THEN ("Индекс соответствует дереву") {
+				REQUIRE(list->get_subnode(7)->get_value() == "n8");
+				REQUIRE(list->get_subnode(999)->get_value() == "x");
+				REQUIRE(list->get_subnode("n7") == list->get_subnode(506));
+				REQUIRE(list->get_subnode("x") == list->get_last());
+				REQUIRE(list->get_subnode("y") == list->get_first());
+				REQUIRE(list->get_subnode("n0") == list->get_subnode(499));
+			}
+		}
+	}
+}
+
+TEST_CASE( "Вывод Tree в текст и в поток", "[tool1cd][common][Parse_tree]" ) {
+
+	std::string long_value = "0123456789\"abcdef0123456789abcdef\"\"0123456789abcdef\"";
+	std::string source = "{{\"" + std::string("0123456789\"\"abcdef0123456789abcdef\"\"\"\"0123456789abcdef\"\"")
+			+ "\",1},{2,{}},\"\"}";
+
+	GIVEN ("Дерево со строками длиннее блока поиска кавычек") {
+		auto tree = parse_1Ctext(source, "");
+		REQUIRE((*tree)[0][0][0].get_value() == long_value);
+
+		std::string text = outtext(tree.get());
+
+		THEN ("Кавычки удваиваются") {
+			REQUIRE(text == "{\r\n{" + source.substr(2, source.find(",1}") - 2) + ",1},\r\n{2,\r\n},\"\"}");
+		}
+
+		THEN ("В поток выводится тот же текст") {
+			TMemoryStream stream;
+			outtext(tree.get(), &stream);
+			REQUIRE(stream.GetSize() == (int64_t)text.size());
+			std::string from_stream(text.size(), '\0');
+			stream.Seek(0, soFromBeginning);
+			stream.Read(&from_stream[0], from_stream.size());
+			REQUIRE(from_stream == text);
+		}
+	}
+}
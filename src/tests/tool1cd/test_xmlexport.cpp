@@ -0,0 +1,138 @@
+/*
+    test_project provides tests for Tool1CD library
+    Copyright © 2009-2017 awa
+    Copyright © 2017-2018 E8 Tools contributors
+
+    This file is part of test_project.
+
+    test_project is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    test_project is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with test_project.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include "../catch.hpp"
+#include "testbase.h"
+#include <fstream>
+#include <sstream>
+#include <map>
+
+using boost::filesystem::path;
+using namespace std;
+
+namespace {
+
+// добавляет count записей в таблицу _EXTENSIONSINFO, чтобы выгрузка шла несколькими порциями
+void fill_table(const path &dbpath, uint32_t count)
+{
+	T_1CD base1CD(dbpath, nullptr, true);
+	Table *table = find_table(base1CD, "_EXTENSIONSINFO");
+	table->begin_edit();
+	table->begin_insert_batch(count);
+	for (uint32_t i = 0; i < count; i++) {
+		insert_test_record(table, make_test_key(0, i), i);
+	}
+	table->end_insert_batch();
+	table->end_edit();
+}
+
+string read_file(const path &filepath)
+{
+	ifstream in(filepath.string(), ios::binary);
+	stringstream result;
+	result << in.rdbuf();
+	return result.str();
+}
+
+// содержимое файлов каталога по именам
+map<string, string> read_dir(const path &dirpath)
+{
+	map<string, string> result;
+	for (auto &entry : boost::filesystem::directory_iterator(dirpath)) {
+		result[entry.path().filename().string()] = read_file(entry.path());
+	}
+	return result;
+}
+
+} // namespace
+
+TEST_CASE("Параллельная выгрузка таблицы в XML", "[tool1cd][Table][xml]")
+{
+	GIVEN( "Копия базы tests/db838/db01/1Cv8.1CD с большой таблицей" ) {
+		TestBaseCopy copy;
+		const path &dir = copy.dir;
+		fill_table(copy.dbpath, 3 * XML_EXPORT_CHUNK_RECORDS + 100);
+
+		T_1CD base1CD(copy.dbpath, nullptr, false);
+		Table *table = find_table(base1CD, "_EXTENSIONSINFO");
+		table->fill_records_index();
+
+		WHEN( "Выгружаем таблицу в несколько потоков" ) {
+			table->export_to_xml((dir / "serial.xml").string(), false, false, 1);
+			table->export_to_xml((dir / "parallel.xml").string(), false, false, 4);
+
+			THEN( "Результат совпадает с последовательной выгрузкой" ) {
+				REQUIRE( read_file(dir / "parallel.xml") == read_file(dir / "serial.xml") );
+			}
+		}
+
+#ifdef __linux__
+		WHEN( "Запись выгрузки завершается ошибкой" ) {
+			THEN( "Исключение передается вызывающему после остановки рабочих потоков" ) {
+				// запись в /dev/full всегда завершается ошибкой ENOSPC
+				REQUIRE_THROWS( table->export_to_xml("/dev/full", false, false, 4) );
+			}
+		}
+#endif
+	}
+}
+
+TEST_CASE("Выгрузка blob в файлы при выгрузке в XML", "[tool1cd][Table][xml]")
+{
+	GIVEN( "База tests/db838/db01/1Cv8.1CD" ) {
+		string dbpath(CMAKE_SOURCE_DIR);
+		dbpath += "/tests/db838/db01/1Cv8.1CD";
+		path dir = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+		boost::filesystem::create_directories(dir / "serial");
+		boost::filesystem::create_directories(dir / "parallel");
+
+		T_1CD base1CD(dbpath, nullptr, false);
+		vector<string> names {"CONFIG", "PARAMS"};
+
+		WHEN( "Выгружаем таблицы в один и в несколько потоков с общим набором экземпляров базы" ) {
+			vector<unique_ptr<T_1CD>> base_copies;
+			for (auto &name : names) {
+				Table *table = find_table(base1CD, name);
+				REQUIRE( table != nullptr );
+				table->fill_records_index();
+				// в один поток blob пишутся через текущий экземпляр базы
+				size_t opened = base_copies.size();
+				table->export_to_xml((dir / "serial" / (name + ".xml")).string(), true, false, 1, nullptr, &base_copies);
+				REQUIRE( base_copies.size() == opened );
+				table->export_to_xml((dir / "parallel" / (name + ".xml")).string(), true, false, 4, nullptr, &base_copies);
+				// экземпляры, открытые для первой таблицы, используются повторно
+				REQUIRE( base_copies.size() == 4 );
+			}
+
+			THEN( "XML и файлы blob совпадают" ) {
+				for (auto &name : names) {
+					path serial = dir / "serial" / (name + ".xml");
+					path parallel = dir / "parallel" / (name + ".xml");
+					REQUIRE( read_file(parallel) == read_file(serial) );
+					map<string, string> blobs = read_dir(serial.string() + ".blob");
+					REQUIRE( blobs.size() > 0 );
+					REQUIRE( read_dir(parallel.string() + ".blob") == blobs );
+				}
+			}
+		}
+
+		boost::filesystem::remove_all(dir);
+	}
+}
@@ -0,0 +1,121 @@
+/*
+    test_project provides tests for Tool1CD library
+    Copyright © 2009-2017 awa
+    Copyright © 2017-2018 E8 Tools contributors
+
+    This file is part of test_project.
+
+    test_project is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    test_project is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with test_project.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef TESTS_TOOL1CD_TESTBASE_H
+#define TESTS_TOOL1CD_TESTBASE_H
+
+// Общие средства тестов, изменяющих базу: временная копия tests/db838/db01/1Cv8.1CD
+// и добавление записей в таблицу _EXTENSIONSINFO (первичный индекс по _IDRREF)
+
+#include <Class_1CD.h>
+#include <SystemClasses/TMemoryStream.hpp>
+#include <boost/filesystem.hpp>
+#include <cstring>
+#include <string>
+#include <vector>
+
+// Копия базы source (путь от корня исходников) в новом временном каталоге, каталог удаляется деструктором
+class TestBaseCopy
+{
+public:
+	explicit TestBaseCopy(const std::string &source = "tests/db838/db01/1Cv8.1CD")
+		: dir(boost::filesystem::temp_directory_path() / boost::filesystem::unique_path()),
+		  dbpath(dir / boost::filesystem::path(source).filename())
+	{
+		boost::filesystem::create_directories(dir);
+		boost::filesystem::copy_file(std::string(CMAKE_SOURCE_DIR) + "/" + source, dbpath);
+	}
+
+	~TestBaseCopy()
+	{
+		boost::system::error_code ec;
+		boost::filesystem::remove_all(dir, ec);
+	}
+
+	TestBaseCopy(const TestBaseCopy &) = delete;
+	TestBaseCopy &operator=(const TestBaseCopy &) = delete;
+
+	const boost::filesystem::path dir;
+	const boost::filesystem::path dbpath;
+};
+
+inline Table *find_table(T_1CD &base, const std::string &name)
+{
+	for (int32_t i = 0; i < base.get_numtables(); i++) {
+		if (base.get_table(i)->get_name() == name) {
+			return base.get_table(i);
+		}
+	}
+	return nullptr;
+}
+
+// номер поля для set_edit_value
+inline int32_t field_number(Table *table, const std::string &name)
+{
+	for (int32_t i = 0; i < table->get_num_fields(); i++) {
+		if (table->get_field(i)->get_name() == name) {
+			return i;
+		}
+	}
+	return -1;
+}
+
+// ключ _IDRREF добавляемой записи: 0x7f, серия, номер в последних 4 байтах.
+// Записей с первым байтом 0x7f в тестовой базе нет
+inline std::string make_test_key(uint8_t series, uint32_t number)
+{
+	std::string key(16, 0);
+	key[0] = 0x7f;
+	key[1] = (char)series;
+	for (int i = 0; i < 4; i++) {
+		key[15 - i] = (char)(number >> (i * 8));
+	}
+	return key;
+}
+
+// запись таблицы _EXTENSIONSINFO с ключом key, порядком order и данными blob _EXTSYNONYM (пустые - NULL).
+// Поток blob переходит во владение записи
+inline std::vector<char> make_test_record(Table *table, const std::string &key, uint32_t order, const std::string &synonym = std::string())
+{
+	Field *idrref = table->get_field("_IDRREF");
+	Field *order_field = table->get_field("_EXTENSIONORDER");
+	Field *synonym_field = table->get_field("_EXTSYNONYM");
+
+	std::vector<char> buf(table->get_recordlen(), 0);
+	memcpy(buf.data() + idrref->get_offset(), key.data(), key.size());
+	order_field->get_binary_value(buf.data() + order_field->get_offset(), false, std::to_string(order));
+	if (!synonym.empty()) {
+		TStream *st = new TMemoryStream;
+		st->Write(synonym.data(), synonym.size());
+		*(TStream **)(buf.data() + synonym_field->get_offset() + (synonym_field->get_null_exists() ? 1 : 0)) = st;
+	}
+	return buf;
+}
+
+// добавляет запись в пакет (между begin_insert_batch и end_insert_batch)
+inline void insert_test_record(Table *table, const std::string &key, uint32_t order, const std::string &synonym = std::string())
+{
+	std::vector<char> buf = make_test_record(table, key, order, synonym);
+	TableRecord rec(table, buf.data());
+	table->insert_batch_record(&rec);
+}
+
+#endif // TESTS_TOOL1CD_TESTBASE_H
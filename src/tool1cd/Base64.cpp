@@ -18,145 +18,288 @@
     You should have received a copy of the GNU Lesser General Public License
     along with Tool1CD Library.  If not, see <http://www.gnu.org/licenses/>.
 */
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
 #include "Base64.h"
 
+#if defined(__SSSE3__) || defined(__AVX2__)
+#define TOOL1CD_BASE64_SSSE3
+#define TOOL1CD_BASE64_SSSE3_TARGET
+#include <tmmintrin.h>
+#elif defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+// сборка без -mssse3: векторная ветка компилируется для SSSE3 и выбирается при наличии его в процессоре
+#define TOOL1CD_BASE64_SSSE3
+#define TOOL1CD_BASE64_SSSE3_RUNTIME
+#define TOOL1CD_BASE64_SSSE3_TARGET __attribute__((target("ssse3")))
+#include <tmmintrin.h>
+#endif
+
 #if !defined(_WIN32)
 #pragma package(smart_init)
 #endif
 
 // Куски исходного кода взяты с http://base64.sourceforge.net/
 
+// Кодирование - по 12 бит через таблицу пар символов, при наличии SSSE3 - по 12 байт за шаг
+// (алгоритм W. Muła, "Base64 encoding with SIMD instructions").
+// Декодирование - по 4 символа через таблицу значений, переводы строк, '=' и прочий мусор пропускаются
+
+namespace {
+
 // Translation Table as described in RFC1113
-static const char cb64[]="ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+const char cb64[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
 
-//// Translation Table to decode (created by author)
-static const char cd64[]="|$$$}rstuvwxyz{$$$$$$$>?@ABCDEFGHIJKLMNOPQRSTUVW$$$$$$XYZ[\\]^_`abcdefghijklmnopq";
+const uint8_t BASE64_INVALID = 0xff;
 
-// encode
-// base64 encode a stream adding padding and line breaks as per spec.
-// linesize - длина строки. Если linesize = 0, выводится всё в одну строку, без переносов
-void base64_encode(TStream* infile, TStream* outfile, int linesize)
+struct Base64Tables
 {
-	unsigned char in[3];
-	WCHART out[4];
-	int64_t i;
-	//int len, blocksout = 0;
-	int blocksout = 0;
-	int64_t len;
-	int64_t inlenblock = infile->GetSize() / 3;
+	char pairs[4096][2]; // 12 бит -> два символа
+	uint8_t values[256]; // символ -> 6 бит, BASE64_INVALID для символов не из алфавита
 
-	infile->Seek(0, soBeginning);
-	for(i = 0; i < inlenblock; i++)
+	Base64Tables()
 	{
-		if(blocksout >= linesize/4 && linesize)
-		{
-			outfile->Write(L"\r\n", 4);
-			blocksout = 0;
+		for (int i = 0; i < 4096; i++) {
+			pairs[i][0] = cb64[i >> 6];
+			pairs[i][1] = cb64[i & 0x3f];
+		}
+		memset(values, BASE64_INVALID, sizeof(values));
+		for (int i = 0; i < 64; i++) {
+			values[static_cast<uint8_t>(cb64[i])] = static_cast<uint8_t>(i);
 		}
-		blocksout++;
-		infile->Read(in, 3);
-		out[0] = cb64[in[0] >> 2];
-		out[1] = cb64[((in[0] & 0x03) << 4) | ((in[1] & 0xf0) >> 4)];
-		out[2] = cb64[((in[1] & 0x0f) << 2) | ((in[2] & 0xc0) >> 6)];
-		out[3] = cb64[in[2] & 0x3f];
-		outfile->Write(out, 8);
 	}
+};
 
-	len = infile->GetSize() - infile->GetPosition();
-	if(len > 0)
-	{
-		if(blocksout >= linesize / 4 && linesize) outfile->Write(L"\r\n", 4);
-		in[1] = 0;
-		in[2] = 0;
-		infile->Read(in, len);
-		out[0] = cb64[in[0] >> 2];
-		out[1] = cb64[((in[0] & 0x03) << 4) | ((in[1] & 0xf0) >> 4)];
-		out[2] = len > 1 ? cb64[((in[1] & 0x0f) << 2) | ((in[2] & 0xc0) >> 6)] : L'=';
-		out[3] = len > 2 ? cb64[in[2] & 0x3f] : L'=';
-		outfile->Write(out, 8);
+const Base64Tables base64_tables;
+
+#ifdef TOOL1CD_BASE64_SSSE3
+bool has_ssse3()
+{
+#ifdef TOOL1CD_BASE64_SSSE3_RUNTIME
+	static const bool result = []() { __builtin_cpu_init(); return __builtin_cpu_supports("ssse3") != 0; }();
+	return result;
+#else
+	return true;
+#endif
+}
+
+// кодирует группы по 4 (12 байт за шаг), возвращает количество закодированных групп.
+// Читается по 16 байт, поэтому последние 2 группы всегда остаются скалярному коду
+TOOL1CD_BASE64_SSSE3_TARGET
+size_t encode_groups_ssse3(const uint8_t *in, size_t count, char *out)
+{
+	const __m128i shuffle = _mm_set_epi8(10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1);
+	const __m128i shift_lut = _mm_setr_epi8(
+			'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+			'0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '+' - 62,
+			'/' - 63, 'A', 0, 0);
+	size_t done = 0;
+	for (; count - done >= 6; done += 4) {
+		__m128i v = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(in)), shuffle);
+		__m128i t0 = _mm_mulhi_epu16(_mm_and_si128(v, _mm_set1_epi32(0x0fc0fc00)), _mm_set1_epi32(0x04000040));
+		__m128i t1 = _mm_mullo_epi16(_mm_and_si128(v, _mm_set1_epi32(0x003f03f0)), _mm_set1_epi32(0x01000010));
+		__m128i indices = _mm_or_si128(t0, t1);
+
+		__m128i shifts = _mm_subs_epu8(indices, _mm_set1_epi8(51));
+		__m128i less = _mm_cmpgt_epi8(_mm_set1_epi8(26), indices);
+		shifts = _mm_or_si128(shifts, _mm_and_si128(less, _mm_set1_epi8(13)));
+		__m128i chars = _mm_add_epi8(_mm_shuffle_epi8(shift_lut, shifts), indices);
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(out), chars);
+
+		in += 12;
+		out += 16;
 	}
+	return done;
+}
+#endif
+
+// кодирует count полных групп по 3 байта
+char *encode_groups(const uint8_t *in, size_t count, char *out)
+{
+#ifdef TOOL1CD_BASE64_SSSE3
+	if (count >= 6 && has_ssse3()) {
+		size_t done = encode_groups_ssse3(in, count, out);
+		in += done * 3;
+		out += done * 4;
+		count -= done;
+	}
+#endif
+	for (; count; count--) {
+		uint32_t v = in[0] << 16 | in[1] << 8 | in[2];
+		memcpy(out, base64_tables.pairs[v >> 12], 2);
+		memcpy(out + 2, base64_tables.pairs[v & 0xfff], 2);
+		in += 3;
+		out += 4;
+	}
+	return out;
+}
 
+// последняя неполная группа из len (1 или 2) байт с дополнением '='
+char *encode_tail(const uint8_t *in, size_t len, char *out)
+{
+	uint8_t in1 = len > 1 ? in[1] : 0;
+	out[0] = cb64[in[0] >> 2];
+	out[1] = cb64[((in[0] & 0x03) << 4) | (in1 >> 4)];
+	out[2] = len > 1 ? cb64[(in1 & 0x0f) << 2] : '=';
+	out[3] = '=';
+	return out + 4;
 }
 
+inline char *new_line(char *out)
+{
+	out[0] = '\r';
+	out[1] = '\n';
+	return out + 2;
+}
 
-// decode
-// decode a base64 encoded stream discarding padding, line breaks and noise
-void base64_decode(TStream* infile, TStream* outfile)
+} // namespace
+
+// linesize - длина строки. Если linesize = 0, выводится всё в одну строку, без переносов
+void base64_encode(const void *data, size_t size, std::string &out, int linesize)
 {
-	unsigned char in[4], out[3], v;
-	WCHART s;
-	int i, len;
+	auto src = static_cast<const uint8_t *>(data);
+	size_t groups = size / 3;
+	size_t tail = size % 3;
+	size_t total_groups = groups + (tail ? 1 : 0);
+	size_t line_groups = linesize / 4;
 
-	while(infile->GetPosition() < infile->GetSize())
-	{
-		for(len = 0, i = 0; i < 4 && infile->GetPosition() < infile->GetSize(); i++ )
-		{
-			v = 0;
-			while(infile->GetPosition() < infile->GetSize() && v == 0)
-			{
-				infile->Read(&s, 2);
-				v = (unsigned char)((s < 43 || s > 122) ? 0 : cd64[s - 43]);
-				if(v) v = (unsigned char)((v == '$') ? 0 : v - 61);
-			}
-			if(v)
-			{
-				in[i] = (unsigned char)(v - 1);
-				len++;
+	size_t breaks = 0; // перевод строки ставится перед группой, начинающей новую строку
+	if (linesize) {
+		breaks = line_groups == 0 ? total_groups : total_groups ? (total_groups - 1) / line_groups : 0;
+	}
+
+	size_t pos = out.size();
+	out.resize(pos + total_groups * 4 + breaks * 2);
+	char *dst = &out[pos];
+
+	if (!linesize) {
+		dst = encode_groups(src, groups, dst);
+		src += groups * 3;
+	}
+	else if (!line_groups) {
+		for (size_t i = 0; i < groups; i++) {
+			dst = encode_groups(src, 1, new_line(dst));
+			src += 3;
+		}
+		if (tail) {
+			dst = new_line(dst);
+		}
+	}
+	else {
+		for (size_t done = 0; done < groups; ) {
+			if (done) {
+				dst = new_line(dst);
 			}
-			else in[i] = 0;
+			size_t count = std::min(line_groups, groups - done);
+			dst = encode_groups(src, count, dst);
+			src += count * 3;
+			done += count;
 		}
-		if(len)
-		{
-			out[0] = (unsigned char) (in[0] << 2 | in[1] >> 4);
-			out[1] = (unsigned char) (in[1] << 4 | in[2] >> 2);
-			out[2] = (unsigned char) (((in[2] << 6) & 0xc0) | in[3]);
-			outfile->Write(out, len - 1);
+		if (tail && groups && groups % line_groups == 0) {
+			dst = new_line(dst);
 		}
-
 	}
 
+	if (tail) {
+		encode_tail(src, tail, dst);
+	}
 }
 
-// decode
-// decode a base64 encoded stream discarding padding, line breaks and noise
-void base64_decode(const std::string &instr, TStream *outfile, int start)
+void base64_decode(const char *data, size_t size, std::string &out)
 {
-	unsigned char in[4], out[3], v;
-	char s;
-	const char* str;
-	int i, len, is, slen;
+	auto src = reinterpret_cast<const uint8_t *>(data);
+	auto src_end = src + size;
+	const uint8_t *values = base64_tables.values;
 
-	slen = instr.size();
-	str = instr.c_str();
-	is = start;
+	size_t pos = out.size();
+	out.resize(pos + size / 4 * 3 + 3);
+	char *dst = &out[pos];
 
-	while(is < slen)
-	{
-		for(len = 0, i = 0; i < 4 && is < slen; i++ )
-		{
-			v = 0;
-			while(is < slen && v == 0)
-			{
-				s = str[is++];
-				v = (unsigned char)((s < 43 || s > 122) ? 0 : cd64[s - 43]);
-				if(v) v = (unsigned char)((v == '$') ? 0 : v - 61);
+	uint32_t acc = 0; // накопленные символы неполной группы
+	int count = 0;
+	while (src < src_end) {
+		if (count == 0 && src_end - src >= 4) {
+			uint8_t a = values[src[0]];
+			uint8_t b = values[src[1]];
+			uint8_t c = values[src[2]];
+			uint8_t d = values[src[3]];
+			if (((a | b | c | d) & 0x80) == 0) {
+				uint32_t v = a << 18 | b << 12 | c << 6 | d;
+				dst[0] = static_cast<char>(v >> 16);
+				dst[1] = static_cast<char>(v >> 8);
+				dst[2] = static_cast<char>(v);
+				dst += 3;
+				src += 4;
+				continue;
 			}
-			if(v)
-			{
-				in[i] = (unsigned char)(v - 1);
-				len++;
-			}
-			else in[i] = 0;
 		}
-		if(len)
-		{
-			out[0] = (unsigned char) (in[0] << 2 | in[1] >> 4);
-			out[1] = (unsigned char) (in[1] << 4 | in[2] >> 2);
-			out[2] = (unsigned char) (((in[2] << 6) & 0xc0) | in[3]);
-			outfile->Write(out, len - 1);
+		uint8_t v = values[*src++];
+		if (v == BASE64_INVALID) {
+			continue;
+		}
+		acc = acc << 6 | v;
+		if (++count == 4) {
+			dst[0] = static_cast<char>(acc >> 16);
+			dst[1] = static_cast<char>(acc >> 8);
+			dst[2] = static_cast<char>(acc);
+			dst += 3;
+			acc = 0;
+			count = 0;
 		}
+	}
+	// неполная группа из count символов дает count - 1 байт
+	if (count == 2) {
+		*dst++ = static_cast<char>(acc >> 4);
+	}
+	else if (count == 3) {
+		*dst++ = static_cast<char>(acc >> 10);
+		*dst++ = static_cast<char>(acc >> 2);
+	}
+	out.resize(dst - out.data());
+}
 
+// encode
+// base64 encode a stream adding padding and line breaks as per spec.
+// Результат пишется в outfile в UTF-16
+void base64_encode(TStream* infile, TStream* outfile, int linesize)
+{
+	std::vector<uint8_t> in(infile->GetSize());
+	infile->Seek(0, soBeginning);
+	infile->Read(in.data(), in.size());
+
+	std::string encoded;
+	base64_encode(in.data(), in.size(), encoded, linesize);
+
+	std::vector<WCHART> wide(encoded.begin(), encoded.end());
+	outfile->Write(wide.data(), wide.size() * sizeof(WCHART));
+}
+
+// decode
+// decode a base64 encoded UTF-16 stream discarding padding, line breaks and noise
+void base64_decode(TStream* infile, TStream* outfile)
+{
+	std::vector<WCHART> wide((infile->GetSize() - infile->GetPosition()) / sizeof(WCHART));
+	infile->Read(wide.data(), wide.size() * sizeof(WCHART));
+
+	std::string narrow(wide.size(), '\0');
+	for (size_t i = 0; i < wide.size(); i++) {
+		narrow[i] = wide[i] < 0x80 ? static_cast<char>(wide[i]) : '\0'; // вне алфавита - мусор
 	}
 
+	std::string decoded;
+	base64_decode(narrow.data(), narrow.size(), decoded);
+	outfile->Write(decoded.data(), decoded.size());
 }
 
+// decode
+// decode a base64 encoded string discarding padding, line breaks and noise
+void base64_decode(const std::string &instr, TStream *outfile, int start)
+{
+	if (start < 0 || static_cast<size_t>(start) >= instr.size()) {
+		return;
+	}
+	std::string decoded;
+	base64_decode(instr.data() + start, instr.size() - start, decoded);
+	outfile->Write(decoded.data(), decoded.size());
+}
@@ -22,8 +22,16 @@
 #ifndef Base64H
 #define Base64H
 
+#include <string>
+
 #include "SystemClasses/TStream.hpp"
 
+// дописывает в out base64-представление size байт data.
+// linesize - длина строки, строки разделяются \r\n; 0 - всё в одну строку
+void base64_encode(const void *data, size_t size, std::string &out, int linesize);
+// дописывает в out байты, декодированные из base64; переводы строк, '=' и прочие символы пропускаются
+void base64_decode(const char *data, size_t size, std::string &out);
+
 void base64_encode(TStream* infile, TStream* outfile, int linesize);
 void base64_decode(TStream* infile, TStream* outfile);
 void base64_decode(const std::string &instr, TStream *outfile, int start = 0);
@@ -282,3 +282,149 @@ int BinaryDecimalDate::get_second() const
 {
 	return data[12] * 10 + data[13];
 }
+
+namespace
+{
+
+// байт с двумя двоично-десятичными цифрами -> две цифры текстом и значение 0..99
+struct BcdTables
+{
+	char digits[256][2];
+	uint8_t values[256];
+
+	BcdTables()
+	{
+		for (int b = 0; b < 256; b++) {
+			digits[b][0] = static_cast<char>('0' + (b >> 4));
+			digits[b][1] = static_cast<char>('0' + (b & 0x0f));
+			values[b] = static_cast<uint8_t>((b >> 4) * 10 + (b & 0x0f));
+		}
+	}
+};
+
+const BcdTables bcd_tables;
+
+const int MAX_INT64_DIGITS = 18;
+
+inline int nibble(const uint8_t *data, int index)
+{
+	uint8_t b = data[index >> 1];
+	return index & 1 ? b & 0x0f : b >> 4;
+}
+
+// дописывает count цифр, начиная с полубайта first
+void append_nibbles(std::string &out, const uint8_t *data, int first, int count)
+{
+	if (count <= 0) {
+		return;
+	}
+	size_t pos = out.size();
+	out.resize(pos + count);
+	char *dst = &out[pos];
+	if (first & 1) {
+		*dst++ = static_cast<char>('0' + nibble(data, first));
+		first++;
+		count--;
+	}
+	const uint8_t *src = data + (first >> 1);
+	for (; count >= 2; count -= 2) {
+		*dst++ = bcd_tables.digits[*src][0];
+		*dst++ = bcd_tables.digits[*src][1];
+		src++;
+	}
+	if (count) {
+		*dst = bcd_tables.digits[*src][0];
+	}
+}
+
+} // namespace
+
+void append_decimal_presentation(std::string &out, const void *raw_data, int length, int precision, bool has_sign_flag)
+{
+	auto data = static_cast<const uint8_t *>(raw_data);
+	int first = has_sign_flag ? 1 : 0; // полубайт первой цифры
+	if (has_sign_flag && (data[0] >> 4) == 0) {
+		out += '-';
+	}
+
+	int int_size = length - precision;
+	int i = 0;
+	while (i < int_size && nibble(data, first + i) == 0) {
+		i++;
+	}
+	if (i < int_size) {
+		append_nibbles(out, data, first + i, int_size - i);
+	} else {
+		out += '0';
+	}
+
+	int frac_end = length;
+	while (frac_end > int_size && nibble(data, first + frac_end - 1) == 0) {
+		frac_end--;
+	}
+	if (frac_end > int_size) {
+		out += '.';
+		append_nibbles(out, data, first + int_size, frac_end - int_size);
+	}
+}
+
+bool decimal_to_int64(const void *raw_data, int length, bool has_sign_flag, int64_t &value)
+{
+	auto data = static_cast<const uint8_t *>(raw_data);
+	int index = has_sign_flag ? 1 : 0;
+	int end = index + length;
+	for (int i = index; i < end - MAX_INT64_DIGITS; i++) {
+		if (nibble(data, i)) {
+			return false;
+		}
+	}
+
+	int64_t result = 0;
+	if (index & 1) {
+		result = data[0] & 0x0f;
+		index++;
+	}
+	for (; index + 1 < end; index += 2) {
+		result = result * 100 + bcd_tables.values[data[index >> 1]];
+	}
+	if (index < end) {
+		result = result * 10 + (data[index >> 1] >> 4);
+	}
+
+	value = has_sign_flag && (data[0] >> 4) == 0 ? -result : result;
+	return true;
+}
+
+decimal_datetime decode_decimal_date(const void *raw_data)
+{
+	auto data = static_cast<const uint8_t *>(raw_data);
+	const uint8_t *v = bcd_tables.values;
+	decimal_datetime result;
+	result.year   = v[data[0]] * 100 + v[data[1]];
+	result.month  = v[data[2]];
+	result.day    = v[data[3]];
+	result.hour   = v[data[4]];
+	result.minute = v[data[5]];
+	result.second = v[data[6]];
+	return result;
+}
+
+void append_date_presentation(std::string &out, const void *raw_data)
+{
+	auto data = static_cast<const uint8_t *>(raw_data);
+	auto d = bcd_tables.digits;
+	char buf[19] = {
+		d[data[3]][0], d[data[3]][1], '.',
+		d[data[2]][0], d[data[2]][1], '.',
+		d[data[0]][0], d[data[0]][1], d[data[1]][0], d[data[1]][1], ' ',
+		d[data[4]][0], d[data[4]][1], ':',
+		d[data[5]][0], d[data[5]][1], ':',
+		d[data[6]][0], d[data[6]][1]
+	};
+	out.append(buf, sizeof(buf));
+}
+
+void append_date_presentation1C(std::string &out, const void *raw_data)
+{
+	append_nibbles(out, static_cast<const uint8_t *>(raw_data), 0, 14);
+}
@@ -24,6 +24,7 @@
 
 #include <vector>
 #include <string>
+#include <cstdint>
 
 class BinaryDecimalNumber {
 public:
@@ -62,5 +63,29 @@ public:
 	int get_second() const;
 };
 
+// Чтение упакованных двоично-десятичных значений без разбора в массив цифр и без выделения памяти.
+// Число: length цифр по полубайту, при has_sign_flag перед ними полубайт знака (0 - отрицательное)
+
+// дописывает в out представление числа, совпадающее с BinaryDecimalNumber::get_presentation
+void append_decimal_presentation(std::string &out, const void *raw_data, int length, int precision, bool has_sign_flag);
+
+// все цифры числа как целое (без учета precision); false, если значение не помещается в int64_t
+bool decimal_to_int64(const void *raw_data, int length, bool has_sign_flag, int64_t &value);
+
+struct decimal_datetime
+{
+	int year;
+	int month;
+	int day;
+	int hour;
+	int minute;
+	int second;
+};
+
+// дата - 7 байт yyyyMMddhhmmss
+decimal_datetime decode_decimal_date(const void *raw_data);
+
+void append_date_presentation(std::string &out, const void *raw_data); // dd.MM.yyyy hh:mm:ss
+void append_date_presentation1C(std::string &out, const void *raw_data); // yyyyMMddhhmmss
 
 #endif //TOOL1CD_PROJECT_BINARYDECIMALNUMBER_H
@@ -19,9 +19,95 @@
     along with Tool1CD Library.  If not, see <http://www.gnu.org/licenses/>.
 */
 
+#include <cstring>
+
 #include "BinaryGuid.h"
 #include "Common.h"
 #include "DetailedException.h"
+#include "Simd.h"
+
+namespace {
+
+// порядок байтов двоичного GUID в строковом представлении
+const int GUID_1C_ORDER[GUID_BINARY_SIZE] = {12, 13, 14, 15, 10, 11, 8, 9, 0, 1, 2, 3, 4, 5, 6, 7};
+const int GUID_MS_ORDER[GUID_BINARY_SIZE] = {3, 2, 1, 0, 5, 4, 7, 6, 8, 9, 10, 11, 12, 13, 14, 15};
+
+// позиции пар шестнадцатеричных цифр в представлении xxxxxxxx-xxxx-xxxx-xxxx-xxxxxxxxxxxx
+const int GUID_HEX_POSITIONS[GUID_BINARY_SIZE] = {0, 2, 4, 6, 9, 11, 14, 16, 19, 21, 24, 26, 28, 30, 32, 34};
+
+// байт -> две шестнадцатеричные цифры, символ -> значение цифры (0 для прочих символов, как from_hex_digit)
+struct HexTables
+{
+	char pairs[256][2];
+	uint8_t values[256];
+
+	HexTables()
+	{
+		const char hex[] = "0123456789abcdef";
+		for (int b = 0; b < 256; b++) {
+			pairs[b][0] = hex[b >> 4];
+			pairs[b][1] = hex[b & 0x0f];
+			values[b] = from_hex_digit(static_cast<char>(b));
+		}
+	}
+};
+
+const HexTables hex_tables;
+
+// 16 байт -> 32 шестнадцатеричные цифры
+void bytes_to_hex(const uint8_t *bytes, char *hex)
+{
+#ifdef TOOL1CD_SSE2
+	const __m128i low_nibble = _mm_set1_epi8(0x0f);
+	const __m128i nine = _mm_set1_epi8(9);
+	const __m128i zero_char = _mm_set1_epi8('0');
+	const __m128i letter_shift = _mm_set1_epi8('a' - '0' - 10);
+
+	__m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(bytes));
+	__m128i hi = _mm_and_si128(_mm_srli_epi16(v, 4), low_nibble);
+	__m128i lo = _mm_and_si128(v, low_nibble);
+	__m128i digits[2] = {_mm_unpacklo_epi8(hi, lo), _mm_unpackhi_epi8(hi, lo)};
+	for (int i = 0; i < 2; i++) {
+		__m128i letters = _mm_and_si128(_mm_cmpgt_epi8(digits[i], nine), letter_shift);
+		__m128i chars = _mm_add_epi8(_mm_add_epi8(digits[i], zero_char), letters);
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(hex + i * 16), chars);
+	}
+#else
+	for (int i = 0; i < GUID_BINARY_SIZE; i++) {
+		memcpy(hex + i * 2, hex_tables.pairs[bytes[i]], 2);
+	}
+#endif
+}
+
+void append_guid(std::string &out, const unsigned char *fr, const int *order)
+{
+	uint8_t bytes[GUID_BINARY_SIZE];
+	for (int i = 0; i < GUID_BINARY_SIZE; i++) {
+		bytes[i] = fr[order[i]];
+	}
+	char hex[GUID_LEN_FLAT];
+	bytes_to_hex(bytes, hex);
+
+	char buf[GUID_LEN];
+	memcpy(buf, hex, 8);
+	buf[8] = '-';
+	memcpy(buf + 9, hex + 8, 4);
+	buf[13] = '-';
+	memcpy(buf + 14, hex + 12, 4);
+	buf[18] = '-';
+	memcpy(buf + 19, hex + 16, 4);
+	buf[23] = '-';
+	memcpy(buf + 24, hex + 20, 12);
+	out.append(buf, GUID_LEN);
+}
+
+uint8_t hex_pair_value(const char *hex)
+{
+	return hex_tables.values[static_cast<uint8_t>(hex[0])] << 4
+		| hex_tables.values[static_cast<uint8_t>(hex[1])];
+}
+
+} // namespace
 
 BinaryGuid::BinaryGuid()
 {
@@ -83,17 +169,12 @@ public:
 	}
 };
 
-int get_subbyte(const std::string &presentation, int start)
-{
-	return from_hex_digit(presentation[start]) << 4
-		| from_hex_digit(presentation[start + 1]);
-}
-
 BinaryGuid::BinaryGuid(const std::string &presentation)
 {
+	const char *hex = presentation.data();
 	if (presentation.size() == GUID_LEN_FLAT) {
 		for (int i = 0; i < GUID_BINARY_SIZE; i++) {
-			data[i] = get_subbyte(presentation, i * 2);
+			data[i] = hex_pair_value(hex + i * 2);
 		}
 		return;
 	}
@@ -101,30 +182,8 @@ BinaryGuid::BinaryGuid(const std::string &presentation)
 	if (presentation.size() != GUID_LEN) {
 		throw WrongGuidPresentation(presentation);
 	}
-	int j = 0;
-	for (int ind = 12; ind < 16; ind++) {
-		data[ind] = get_subbyte(presentation, j);
-		j += 2;
-	}
-	j++;
-	for (int ind = 10; ind < 12; ind++) {
-		data[ind] = get_subbyte(presentation, j);
-		j += 2;
-	}
-	j++;
-	for (int ind = 8; ind < 10; ind++) {
-		data[ind] = get_subbyte(presentation, j);
-		j += 2;
-	}
-	j++;
-	for (int ind = 0; ind < 2; ind++) {
-		data[ind] = get_subbyte(presentation, j);
-		j += 2;
-	}
-	j++;
-	for (int ind = 2; ind < 8; ind++) {
-		data[ind] = get_subbyte(presentation, j);
-		j += 2;
+	for (int i = 0; i < GUID_BINARY_SIZE; i++) {
+		data[GUID_1C_ORDER[i]] = hex_pair_value(hex + GUID_HEX_POSITIONS[i]);
 	}
 }
 
@@ -142,49 +201,32 @@ bool string_to_GUID(const std::string &str, BinaryGuid *guid)
 	return true;
 }
 
-std::string format_guid(const unsigned char *fr, const std::vector<int> &indices)
+//---------------------------------------------------------------------------
+std::string GUIDas1C(const unsigned char* fr)
 {
 	std::string result;
-	const char hex[] = "0123456789abcdef";
-
-	for (int i : indices)
-	{
-		if (i == -1) {
-			result += '-';
-		} else {
-			result += hex[fr[i] >> 4];
-			result += hex[fr[i] & 0xf];
-		}
-	}
-
+	append_GUIDas1C(result, fr);
 	return result;
 }
 
 //---------------------------------------------------------------------------
-std::string GUIDas1C(const unsigned char* fr)
+std::string GUIDasMS(const unsigned char* fr)
 {
-	std::vector<int> indices = {
-			12, 13, 14, 15, -1,
-			10, 11, -1,
-			8, 9, -1,
-			0, 1, -1,
-			2, 3, 4, 5, 6, 7};
-
-	return format_guid(fr, indices);
+	std::string result;
+	append_GUIDasMS(result, fr);
+	return result;
 }
 
 //---------------------------------------------------------------------------
-std::string GUIDasMS(const unsigned char* fr)
+void append_GUIDas1C(std::string &out, const unsigned char* fr)
 {
-	std::vector<int> indices = {
-			3, 2, 1, 0, -1,
-			5, 4, -1,
-			7, 6, -1,
-			8, 9, -1,
-			10, 11, 12, 13, 14, 15
-	};
+	append_guid(out, fr, GUID_1C_ORDER);
+}
 
-	return format_guid(fr, indices);
+//---------------------------------------------------------------------------
+void append_GUIDasMS(std::string &out, const unsigned char* fr)
+{
+	append_guid(out, fr, GUID_MS_ORDER);
 }
 
 //---------------------------------------------------------------------------
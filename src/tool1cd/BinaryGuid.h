@@ -53,6 +53,9 @@ private:
 
 std::string GUIDas1C(const unsigned char* fr);
 std::string GUIDasMS(const unsigned char* fr);
+// дописывают в out представление GUID из 16 байт fr (GUID_LEN символов) без промежуточных строк
+void append_GUIDas1C(std::string &out, const unsigned char* fr);
+void append_GUIDasMS(std::string &out, const unsigned char* fr);
 std::string GUID_to_string(const BinaryGuid& guid);
 bool string_to_GUID(const std::string &str, BinaryGuid *guid);
 
@@ -0,0 +1,89 @@
+/*
+    Tool1CD library provides access to 1CD database files.
+    Copyright © 2009-2017 awa
+    Copyright © 2017-2018 E8 Tools contributors
+
+    This file is part of Tool1CD Library.
+
+    Tool1CD Library is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Tool1CD Library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with Tool1CD Library.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "BufferedWriter.h"
+
+//---------------------------------------------------------------------------
+BufferedWriter::BufferedWriter(TStream *stream, size_t buffer_size)
+	: stream(stream), buffer_size(buffer_size)
+{
+	buffer.reserve(buffer_size);
+}
+
+//---------------------------------------------------------------------------
+BufferedWriter::~BufferedWriter()
+{
+	try
+	{
+		flush();
+	}
+	catch(...)
+	{
+	}
+}
+
+//---------------------------------------------------------------------------
+void BufferedWriter::write(const char *data, size_t length)
+{
+	if(buffer.size() + length > buffer_size)
+	{
+		flush();
+		if(length >= buffer_size)
+		{
+			// большие куски пишутся в поток напрямую, минуя буфер
+			stream->Write(data, length);
+			return;
+		}
+	}
+	buffer.append(data, length);
+}
+
+//---------------------------------------------------------------------------
+void BufferedWriter::write(const std::string &data)
+{
+	write(data.data(), data.size());
+}
+
+//---------------------------------------------------------------------------
+std::string &BufferedWriter::get_buffer()
+{
+	return buffer;
+}
+
+//---------------------------------------------------------------------------
+void BufferedWriter::commit()
+{
+	if(buffer.size() >= buffer_size) flush();
+}
+
+//---------------------------------------------------------------------------
+void BufferedWriter::flush()
+{
+	if(buffer.empty()) return;
+	stream->Write(buffer.data(), buffer.size());
+	buffer.clear();
+}
+
+//---------------------------------------------------------------------------
+TStream *BufferedWriter::get_stream() const
+{
+	return stream;
+}
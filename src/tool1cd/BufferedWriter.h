@@ -0,0 +1,55 @@
+/*
+    Tool1CD library provides access to 1CD database files.
+    Copyright © 2009-2017 awa
+    Copyright © 2017-2018 E8 Tools contributors
+
+    This file is part of Tool1CD Library.
+
+    Tool1CD Library is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Tool1CD Library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with Tool1CD Library.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef TOOL1CD_PROJECT_BUFFEREDWRITER_H
+#define TOOL1CD_PROJECT_BUFFEREDWRITER_H
+
+#include <string>
+
+#include "SystemClasses/TStream.hpp"
+
+const size_t BUFFERED_WRITER_SIZE = 0x400000; // размер буфера по умолчанию (4 МБ)
+
+// Буферизованная запись в поток: данные накапливаются в строке и пишутся в поток крупными блоками.
+// Форматирующий код может дописывать данные прямо в буфер (get_buffer), после чего вызывается commit
+class BufferedWriter
+{
+public:
+	explicit BufferedWriter(TStream *stream, size_t buffer_size = BUFFERED_WRITER_SIZE);
+	~BufferedWriter();
+
+	BufferedWriter(const BufferedWriter &) = delete;
+	BufferedWriter &operator=(const BufferedWriter &) = delete;
+
+	void write(const char *data, size_t length);
+	void write(const std::string &data);
+	std::string &get_buffer(); // буфер для дописывания данных на месте
+	void commit(); // запись буфера в поток, если он заполнен
+	void flush(); // запись всего буфера в поток
+	TStream *get_stream() const;
+
+private:
+	TStream *stream;
+	size_t buffer_size;
+	std::string buffer;
+};
+
+#endif //TOOL1CD_PROJECT_BUFFEREDWRITER_H
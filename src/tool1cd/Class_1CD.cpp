@@ -33,6 +33,7 @@
 #include "Common.h"
 #include "TempStream.h"
 #include "ConfigStorage.h"
+#include "TreeReader.h"
 #include "Constants.h"
 #include "CRC32.h"
 #include "PackDirectory.h"
@@ -562,6 +563,12 @@ uint32_t T_1CD::get_free_block()
 	return free_blocks->get_free_block();
 }
 
+//---------------------------------------------------------------------------
+uint32_t T_1CD::get_free_extent(uint32_t count)
+{
+	return free_blocks->get_free_extent(count);
+}
+
 const MemBlockManager & T_1CD::getMemBlockManager() const
 {
 	return memBlockManager;
@@ -1130,12 +1137,10 @@ bool T_1CD::recursive_test_stream_format(TStream *str, const string &path, bool
 				}
 			}
 			if (first_symbol == '{' && !EqualIC(sf.substr(i, 15), "{ХАРАКТЕРИСТИКИ")) {
-				auto rt = parse_1Ctext(sf, path);
-				if(rt != nullptr)
-				{
-					result = true;
-				}
-				else result = false;
+				// проверяется только формат, дерево не строится
+				TreeReader reader(sf, path);
+				while(reader.next() != tree_event::end);
+				result = true;
 			}
 			else result = true;
 		}
@@ -1410,8 +1415,6 @@ bool T_1CD::test_list_of_tables()
 	int32_t i, j, l, l2;
 	uint32_t k;
 	int32_t offset;
-	Tree* t;
-	Tree* firstt;
 
 	if(!table_params)
 	{
@@ -1536,69 +1539,87 @@ bool T_1CD::test_list_of_tables()
 					}
 					if(first_symbol == '{')
 					{
-						auto rt = parse_1Ctext(sf, "PARAMS/DBNames");
-						if(rt != nullptr)
+						// {<>,{<количество>,{<guid>,<имя>,<номер>,...},...},...}
+						TreeReader reader(sf, "PARAMS/DBNames");
+						if(reader.next() != tree_event::list_begin || !reader.skip_item()
+							|| reader.next() != tree_event::list_begin || !reader.skip_item())
 						{
-							firstt = &((*rt)[0][1][1]);
+							throw DetailedException("Ошибка тестирования. Ошибка разбора файла PARAMS/DBNames");
+						}
 
-							for(t = firstt; t; t = t->get_next())
+						tree_event entry;
+						while((entry = reader.next()) != tree_event::list_end)
+						{
+							string entry_values[3]; // guid, имя, номер
+							if(entry != tree_event::list_begin)
 							{
-								bool is_slave = false;
-								string _name = t->get_subnode(1)->get_value();
-								if(EqualIC(_name, "Fld")) continue;
-								if(EqualIC(_name, "LineNo")) continue;
-								if(EqualIC(_name, "Turnover")) continue;
-								if(EqualIC(_name, "TurnoverDt")) continue;
-								if(EqualIC(_name, "TurnoverCt")) continue;
-								if(EqualIC(_name, "ByField")) continue;
-								if(EqualIC(_name, "ByOwnerField")) continue;
-								if(EqualIC(_name, "ByParentField")) continue;
-								if(EqualIC(_name, "ByProperty")) continue;
-								if(EqualIC(_name, "ByPropRecorder")) continue;
-								if(EqualIC(_name, "ByResource")) continue;
-								if(EqualIC(_name, "ByDim")) continue;
-								if(EqualIC(_name, "ByDims")) continue;
-								if(EqualIC(_name, "ByDimension")) continue;
-								if(EqualIC(_name, "ByDimensions")) continue;
-								if(EqualIC(_name, "ByDimRecorder")) continue;
-								if(EqualIC(_name, "VT")) is_slave = true;
-								if(EqualIC(_name, "ExtDim")) is_slave = true;
-
-								string _guid = t->get_subnode(0)->get_value();
-								string _num = t->get_subnode(2)->get_value();
-
-								if (_guid == EMPTY_GUID) {
-									continue;
+								throw DetailedException("Ошибка тестирования. Ошибка разбора файла PARAMS/DBNames");
+							}
+							for(auto &v : entry_values)
+							{
+								if(reader.next() != tree_event::value)
+								{
+									throw DetailedException("Ошибка тестирования. Ошибка разбора файла PARAMS/DBNames");
 								}
+								v = reader.get_value();
+							}
+							reader.skip();
+
+							const string &_guid = entry_values[0];
+							const string &_name = entry_values[1];
+							const string &_num = entry_values[2];
+
+							bool is_slave = false;
+							if(EqualIC(_name, "Fld")) continue;
+							if(EqualIC(_name, "LineNo")) continue;
+							if(EqualIC(_name, "Turnover")) continue;
+							if(EqualIC(_name, "TurnoverDt")) continue;
+							if(EqualIC(_name, "TurnoverCt")) continue;
+							if(EqualIC(_name, "ByField")) continue;
+							if(EqualIC(_name, "ByOwnerField")) continue;
+							if(EqualIC(_name, "ByParentField")) continue;
+							if(EqualIC(_name, "ByProperty")) continue;
+							if(EqualIC(_name, "ByPropRecorder")) continue;
+							if(EqualIC(_name, "ByResource")) continue;
+							if(EqualIC(_name, "ByDim")) continue;
+							if(EqualIC(_name, "ByDims")) continue;
+							if(EqualIC(_name, "ByDimension")) continue;
+							if(EqualIC(_name, "ByDimensions")) continue;
+							if(EqualIC(_name, "ByDimRecorder")) continue;
+							if(EqualIC(_name, "VT")) is_slave = true;
+							if(EqualIC(_name, "ExtDim")) is_slave = true;
+
+
+							if (_guid == EMPTY_GUID) {
+								continue;
+							}
 
-								string _tabname = string("_") + _name + _num;
+							string _tabname = string("_") + _name + _num;
 
-								bool table_found = false;
-								for (int i = 0; i < get_numtables(); i++)
+							bool table_found = false;
+							for (int i = 0; i < get_numtables(); i++)
+							{
+								if(is_slave)
 								{
-									if(is_slave)
-									{
-										if (EndsWithIC(get_table(i)->get_name(), _tabname)) {
-											table_found = true;
-											break;
-										}
-									}
-									else if (EqualIC(get_table(i)->get_name(), _tabname))
-									{
+									if (EndsWithIC(get_table(i)->get_name(), _tabname)) {
 										table_found = true;
 										break;
 									}
 								}
-
-
-								if(!table_found)
+								else if (EqualIC(get_table(i)->get_name(), _tabname))
 								{
-									throw DetailedException("Отсутствует таблица")
-										.add_detail("Имя таблицы", _tabname);
+									table_found = true;
+									break;
 								}
 							}
+
+
+							if(!table_found)
+							{
+								throw DetailedException("Отсутствует таблица")
+									.add_detail("Имя таблицы", _tabname);
+							}
 						}
-						else result = false;
 					}
 					else
 					{
@@ -224,6 +224,7 @@ public:
 	int32_t get_ver_depot_config(int32_t ver); // Получение номера версии конфигурации (0 - последняя, -1 - предпоследняя и т.д.)
 	bool save_config_ext(const boost::filesystem::path &file_name, const BinaryGuid &uid, const std::string &hashname);
 	bool save_config_ext_db(const boost::filesystem::path &file_name, const std::string &hashname);
+	bool save_compacted(const boost::filesystem::path &file_name); // запись дефрагментированной копии базы в новый файл (кроме баз 8.3.8)
 		
 	bool get_readonly();
 	void set_readonly(bool ro);
@@ -251,6 +252,7 @@ public:
 	char* get_block_for_write(uint32_t block_number, bool read); // буфер не принадлежит вызывающей стороне (принадлежит memblock)
 	void set_block_as_free(uint32_t block_number); // пометить блок как свободный
 	uint32_t get_free_block(); // получить номер свободного блока (и пометить как занятый)
+	uint32_t get_free_extent(uint32_t count); // получить count свободных блоков подряд (и пометить как занятые), возвращает номер первого
 
 	const MemBlockManager &getMemBlockManager() const;
 
@@ -0,0 +1,251 @@
+/*
+    Tool1CD library provides access to 1CD database files.
+    Copyright © 2009-2017 awa
+    Copyright © 2017-2018 E8 Tools contributors
+
+    This file is part of Tool1CD Library.
+
+    Tool1CD Library is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Tool1CD Library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with Tool1CD Library.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <cstring>
+
+#include "ColumnarFormat.h"
+#include "DetailedException.h"
+
+using namespace std;
+
+namespace {
+
+// Последовательное чтение значений из буфера с проверкой границ
+class ColumnarParser
+{
+public:
+	ColumnarParser(const string &_data, const string &_file_name)
+		: data(_data), file_name(_file_name), pos(0) {}
+
+	const char *take(size_t count)
+	{
+		if(count > data.size() - pos)
+		{
+			throw DetailedException("Неожиданный конец данных колоночной выгрузки")
+				.add_detail("Файл", file_name)
+				.add_detail("Смещение", pos);
+		}
+		const char *result = data.data() + pos;
+		pos += count;
+		return result;
+	}
+
+	template <typename T>
+	T get()
+	{
+		T result;
+		memcpy(&result, take(sizeof(T)), sizeof(T));
+		return result;
+	}
+
+	string get_string(size_t count)
+	{
+		return string(take(count), count);
+	}
+
+private:
+	const string &data;
+	const string &file_name;
+	size_t pos;
+};
+
+} // namespace
+
+//---------------------------------------------------------------------------
+ColumnarReader::ColumnarReader(const boost::filesystem::path &file_name)
+{
+	stream.reset(new TFileStream(file_name, fmOpenRead));
+
+	char signature[4];
+	uint32_t version = 0;
+	int64_t size = stream->GetSize();
+	if(size < 16)
+	{
+		throw DetailedException("Файл не является колоночной выгрузкой")
+			.add_detail("Файл", file_name.string());
+	}
+	stream->Read(signature, 4);
+	stream->Read(&version, 4);
+	if(memcmp(signature, COLUMNAR_SIGNATURE, 4) != 0)
+	{
+		throw DetailedException("Файл не является колоночной выгрузкой")
+			.add_detail("Файл", file_name.string());
+	}
+	if(version != COLUMNAR_VERSION)
+	{
+		throw DetailedException("Неподдерживаемая версия колоночной выгрузки")
+			.add_detail("Файл", file_name.string())
+			.add_detail("Версия", version);
+	}
+
+	uint32_t footer_length = 0;
+	stream->Seek(size - 8, soBeginning);
+	stream->Read(&footer_length, 4);
+	stream->Read(signature, 4);
+	if(memcmp(signature, COLUMNAR_SIGNATURE, 4) != 0 || footer_length > size - 16)
+	{
+		throw DetailedException("Поврежден заголовок колоночной выгрузки")
+			.add_detail("Файл", file_name.string());
+	}
+
+	string footer(footer_length, '\0');
+	stream->Seek(size - 8 - footer_length, soBeginning);
+	stream->Read(&footer[0], footer_length);
+
+	ColumnarParser parser(footer, file_name.string());
+	table_name = parser.get_string(parser.get<uint16_t>());
+
+	uint32_t num_columns = parser.get<uint32_t>();
+	for(uint32_t i = 0; i < num_columns; i++)
+	{
+		ColumnarColumn column;
+		column.name = parser.get_string(parser.get<uint16_t>());
+		uint8_t type = parser.get<uint8_t>();
+		if(type > static_cast<uint8_t>(columnar_type::bytes))
+		{
+			throw DetailedException("Неизвестный тип столбца колоночной выгрузки")
+				.add_detail("Файл", file_name.string())
+				.add_detail("Столбец", column.name)
+				.add_detail("Тип", type);
+		}
+		column.type = static_cast<columnar_type>(type);
+		column.nullable = parser.get<uint8_t>() != 0;
+		column.field_type = parser.get<uint8_t>();
+		column.length = parser.get<int32_t>();
+		column.scale = parser.get<int32_t>();
+		columns.push_back(column);
+	}
+
+	uint32_t num_row_groups = parser.get<uint32_t>();
+	for(uint32_t g = 0; g < num_row_groups; g++)
+	{
+		ColumnarRowGroup row_group;
+		row_group.offset = parser.get<uint64_t>();
+		row_group.num_rows = parser.get<uint32_t>();
+		uint64_t offset = row_group.offset;
+		for(uint32_t i = 0; i < num_columns; i++)
+		{
+			ColumnarChunkInfo chunk;
+			chunk.offset = offset;
+			chunk.size = parser.get<uint64_t>();
+			chunk.null_count = parser.get<uint32_t>();
+			chunk.min = parser.get_string(parser.get<uint32_t>());
+			chunk.max = parser.get_string(parser.get<uint32_t>());
+			offset += chunk.size;
+			row_group.chunks.push_back(chunk);
+		}
+		row_groups.push_back(row_group);
+	}
+}
+
+//---------------------------------------------------------------------------
+const std::string &ColumnarReader::get_table_name() const
+{
+	return table_name;
+}
+
+//---------------------------------------------------------------------------
+const std::vector<ColumnarColumn> &ColumnarReader::get_columns() const
+{
+	return columns;
+}
+
+//---------------------------------------------------------------------------
+const std::vector<ColumnarRowGroup> &ColumnarReader::get_row_groups() const
+{
+	return row_groups;
+}
+
+//---------------------------------------------------------------------------
+uint64_t ColumnarReader::get_num_rows() const
+{
+	uint64_t result = 0;
+	for(auto &row_group : row_groups) result += row_group.num_rows;
+	return result;
+}
+
+//---------------------------------------------------------------------------
+ColumnarChunk ColumnarReader::read_chunk(uint32_t row_group, uint32_t column)
+{
+	const ColumnarChunkInfo &info = row_groups.at(row_group).chunks.at(column);
+	const ColumnarColumn &col = columns.at(column);
+
+	string data(info.size, '\0');
+	stream->Seek(info.offset, soBeginning);
+	if(stream->Read(&data[0], info.size) != (int64_t)info.size)
+	{
+		throw DetailedException("Ошибка чтения блока столбца колоночной выгрузки")
+			.add_detail("Столбец", col.name)
+			.add_detail("Группа строк", row_group);
+	}
+
+	ColumnarChunk chunk;
+	chunk.type = col.type;
+	chunk.num_rows = row_groups[row_group].num_rows;
+	uint32_t n = chunk.num_rows;
+
+	ColumnarParser parser(data, table_name);
+	if(col.nullable)
+	{
+		const char *bitmap = parser.take((n + 7) / 8);
+		chunk.nulls.resize(n);
+		for(uint32_t i = 0; i < n; i++) chunk.nulls[i] = (bitmap[i >> 3] >> (i & 7)) & 1;
+	}
+
+	switch(col.type)
+	{
+		case columnar_type::boolean:
+			for(uint32_t i = 0; i < n; i++) chunk.ints.push_back(parser.get<uint8_t>());
+			break;
+		case columnar_type::int64:
+		case columnar_type::timestamp:
+			for(uint32_t i = 0; i < n; i++) chunk.ints.push_back(parser.get<int64_t>());
+			break;
+		case columnar_type::guid:
+			for(uint32_t i = 0; i < n; i++) chunk.values.push_back(parser.get_string(16));
+			break;
+		case columnar_type::string: {
+			vector<string> dictionary(parser.get<uint32_t>());
+			for(auto &entry : dictionary) entry = parser.get_string(parser.get<uint32_t>());
+			for(uint32_t i = 0; i < n; i++)
+			{
+				uint32_t index = parser.get<uint32_t>();
+				if(index < dictionary.size()) chunk.values.push_back(dictionary[index]);
+				else if(chunk.is_null(i)) chunk.values.push_back(string());
+				else
+				{
+					throw DetailedException("Индекс за пределами словаря колоночной выгрузки")
+						.add_detail("Столбец", col.name)
+						.add_detail("Индекс", index);
+				}
+			}
+			break;
+		}
+		case columnar_type::bytes: {
+			vector<uint32_t> lengths(n);
+			for(auto &length : lengths) length = parser.get<uint32_t>();
+			for(auto length : lengths) chunk.values.push_back(parser.get_string(length));
+			break;
+		}
+	}
+
+	return chunk;
+}
@@ -0,0 +1,138 @@
+/*
+    Tool1CD library provides access to 1CD database files.
+    Copyright © 2009-2017 awa
+    Copyright © 2017-2018 E8 Tools contributors
+
+    This file is part of Tool1CD Library.
+
+    Tool1CD Library is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Tool1CD Library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with Tool1CD Library.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef TOOL1CD_PROJECT_COLUMNARFORMAT_H
+#define TOOL1CD_PROJECT_COLUMNARFORMAT_H
+
+// Колоночный формат выгрузки таблицы (T1CC), версия 1.
+// Все числа little-endian, строки в UTF-8.
+//
+// Файл:
+//   char[4] "T1CC", u32 версия
+//   группы строк, одна за другой
+//   заголовок-оглавление (footer)
+//   u32 длина footer, char[4] "T1CC"
+//
+// Группа строк - блоки всех столбцов подряд, в порядке столбцов. Блок столбца из n строк:
+//   если столбец допускает NULL - битовая карта NULL, (n + 7) / 8 байт, бит i (младший первым) = 1 - строка i NULL
+//   значения (для NULL записывается ноль, пустая строка или индекс 0):
+//     bool      - u8[n]
+//     int64     - i64[n], значение numeric, умноженное на 10^scale
+//     timestamp - i64[n], микросекунды от 1970-01-01T00:00:00 (без часового пояса)
+//     guid      - u8[16][n], байты в порядке хранения в базе
+//     string    - u32 размер словаря, элементы словаря (u32 длина, байты), u32 индекс в словаре[n]
+//     bytes     - u32 длина[n], затем данные всех значений подряд
+//
+// Footer:
+//   u16 длина, имя таблицы
+//   u32 количество столбцов, для каждого:
+//     u16 длина, имя; u8 тип (columnar_type); u8 допускает NULL; u8 тип поля в базе (type_fields);
+//     i32 длина поля; i32 scale (количество знаков после запятой для int64, иначе 0)
+//   u32 количество групп строк, для каждой:
+//     u64 смещение группы в файле, u32 количество строк, для каждого столбца:
+//       u64 размер блока, u32 количество NULL,
+//       u32 длина, min; u32 длина, max - в кодировке значения (i64, u8, 16 байт guid, байты строки),
+//       сравнение знаковое для int64/timestamp и побайтовое для остальных; для bytes и блоков из одних NULL длины 0.
+//       Для string min и max усечены до COLUMNAR_STATS_PREFIX байт (возможно, посреди символа UTF-8):
+//       все значения блока не меньше min, а их первые COLUMNAR_STATS_PREFIX байт не больше max
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <boost/filesystem.hpp>
+
+#include "SystemClasses/TFileStream.hpp"
+
+const char COLUMNAR_SIGNATURE[4] = {'T', '1', 'C', 'C'};
+const uint32_t COLUMNAR_VERSION = 1;
+const uint32_t COLUMNAR_ROW_GROUP_ROWS = 0x10000; // максимальное количество строк в группе
+const uint64_t COLUMNAR_ROW_GROUP_SIZE = 0x4000000; // объем данных, после которого группа строк записывается досрочно
+const uint32_t COLUMNAR_STATS_PREFIX = 64; // сколько байт строки попадает в статистику min/max
+
+enum class columnar_type : uint8_t
+{
+	boolean = 0,
+	int64 = 1,
+	timestamp = 2,
+	guid = 3,
+	string = 4,
+	bytes = 5
+};
+
+struct ColumnarColumn
+{
+	std::string name;
+	columnar_type type;
+	bool nullable;
+	uint8_t field_type; // type_fields поля базы
+	int32_t length;
+	int32_t scale;
+};
+
+struct ColumnarChunkInfo
+{
+	uint64_t offset;
+	uint64_t size;
+	uint32_t null_count;
+	std::string min; // пустые, если статистики нет
+	std::string max;
+};
+
+struct ColumnarRowGroup
+{
+	uint64_t offset;
+	uint32_t num_rows;
+	std::vector<ColumnarChunkInfo> chunks;
+};
+
+// Прочитанный блок столбца. Значения bool, int64 и timestamp - в ints, guid, string и bytes - в values
+struct ColumnarChunk
+{
+	columnar_type type;
+	uint32_t num_rows {0};
+	std::vector<bool> nulls; // пустой, если столбец не допускает NULL
+	std::vector<int64_t> ints;
+	std::vector<std::string> values;
+
+	bool is_null(uint32_t row) const { return !nulls.empty() && nulls[row]; }
+};
+
+// Чтение файла колоночной выгрузки
+class ColumnarReader
+{
+public:
+	explicit ColumnarReader(const boost::filesystem::path &file_name);
+
+	const std::string &get_table_name() const;
+	const std::vector<ColumnarColumn> &get_columns() const;
+	const std::vector<ColumnarRowGroup> &get_row_groups() const;
+	uint64_t get_num_rows() const;
+
+	ColumnarChunk read_chunk(uint32_t row_group, uint32_t column);
+
+private:
+	std::unique_ptr<TFileStream> stream;
+	std::string table_name;
+	std::vector<ColumnarColumn> columns;
+	std::vector<ColumnarRowGroup> row_groups;
+};
+
+#endif //TOOL1CD_PROJECT_COLUMNARFORMAT_H
@@ -22,6 +22,7 @@
 #include "Common.h"
 #include "MessageRegistration.h"
 #include "BinaryDecimalNumber.h"
+#include "Simd.h"
 //---------------------------------------------------------------------------
 #if !defined(_WIN32)
 #pragma package(smart_init)
@@ -39,13 +40,13 @@ void time1CD_to_FileTime(FILETIME *ft, const void *time1CD)
 {
 	SYSTEMTIME st;
 	FILETIME lft;
-	BinaryDecimalDate bdd(time1CD);
-	st.wYear = bdd.get_year();
-	st.wMonth = bdd.get_month();
-	st.wDay = bdd.get_day();
-	st.wHour = bdd.get_hour();
-	st.wMinute = bdd.get_minute();
-	st.wSecond = bdd.get_second();
+	decimal_datetime dt = decode_decimal_date(time1CD);
+	st.wYear = dt.year;
+	st.wMonth = dt.month;
+	st.wDay = dt.day;
+	st.wHour = dt.hour;
+	st.wMinute = dt.minute;
+	st.wSecond = dt.second;
 	SystemTimeToFileTime(&st, &lft);
 	LocalFileTimeToFileTime(&lft, ft);
 }
@@ -107,16 +108,18 @@ bool string_to_date(const string &str, void *bytedate)
 // char[7] -> yyyymmddhhmmss
 string date_to_string1C(const void *bytedate)
 {
-	BinaryDecimalDate bdd(bytedate);
-	return bdd.get_part(0, 14);
+	string result;
+	append_date_presentation1C(result, bytedate);
+	return result;
 }
 
 //---------------------------------------------------------------------------
 // char[7] -> dd.mm.yyyy hh:mm:ss
 string date_to_string(const void *bytedate)
 {
-	BinaryDecimalDate bdd(bytedate);
-	return bdd.get_presentation();
+	string result;
+	append_date_presentation(result, bytedate);
+	return result;
 }
 
 //---------------------------------------------------------------------------
@@ -148,18 +151,100 @@ string hexstring(TStream *str)
 	return result;
 }
 
+//---------------------------------------------------------------------------
+static inline const char* xml_entity(char c)
+{
+	switch(c)
+	{
+		case '&': return "&amp;";
+		case '<': return "&lt;";
+		case '>': return "&gt;";
+		case '\'': return "&apos;";
+		case '"': return "&quot;";
+	}
+	return nullptr;
+}
+
+//---------------------------------------------------------------------------
+// Участки без спецсимволов копируются целиком, спецсимволы ищутся блоками по 16 байт
+void append_xml_escaped(std::string &out, const char *in, size_t length)
+{
+	const char *end = in + length;
+	const char *p = in;
+	const char *copied = in; // начало еще не скопированного участка
+
+#ifdef TOOL1CD_SSE2
+	const __m128i amp  = _mm_set1_epi8('&');
+	const __m128i lt   = _mm_set1_epi8('<');
+	const __m128i gt   = _mm_set1_epi8('>');
+	const __m128i apos = _mm_set1_epi8('\'');
+	const __m128i quot = _mm_set1_epi8('"');
+#endif
+
+	out.reserve(out.size() + length);
+	while(p < end)
+	{
+#ifdef TOOL1CD_SSE2
+		while(end - p >= 16)
+		{
+			__m128i block = _mm_loadu_si128((const __m128i*)p);
+			__m128i found = _mm_or_si128(
+				_mm_or_si128(_mm_cmpeq_epi8(block, amp), _mm_cmpeq_epi8(block, lt)),
+				_mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(block, gt), _mm_cmpeq_epi8(block, apos)), _mm_cmpeq_epi8(block, quot)));
+			uint32_t mask = _mm_movemask_epi8(found);
+			if(mask)
+			{
+				p += first_bit(mask);
+				break;
+			}
+			p += 16;
+		}
+#endif
+		while(p < end && !xml_entity(*p)) p++;
+		if(p == end) break;
+		out.append(copied, p - copied);
+		out.append(xml_entity(*p));
+		copied = ++p;
+	}
+	out.append(copied, end - copied);
+}
+
 //---------------------------------------------------------------------------
 std::string toXML(const std::string &in)
 {
-	string result(in);
-	result = StringReplace(result, "&", "&amp;");
-	result = StringReplace(result, "<", "&lt;");
-	result = StringReplace(result, ">", "&gt;");
-	result = StringReplace(result, "'", "&apos;");
-	result = StringReplace(result, "\"", "&quot;");
+	string result;
+	append_xml_escaped(result, in.data(), in.size());
 	return result;
 }
 
+//---------------------------------------------------------------------------
+// Обычно спецсимволов нет, и строка остается на месте; иначе хвост экранируется заново
+void escape_xml_tail(std::string &out, size_t start)
+{
+	size_t p = start;
+	while(p < out.size() && !xml_entity(out[p])) p++;
+	if(p == out.size()) return;
+
+	string tail(out, p);
+	out.resize(p);
+	append_xml_escaped(out, tail.data(), tail.size());
+}
+
+//---------------------------------------------------------------------------
+void append_int(std::string &out, int64_t value)
+{
+	char buf[24];
+	char *p = buf + sizeof(buf);
+	uint64_t v = value < 0 ? 0 - static_cast<uint64_t>(value) : value;
+	do
+	{
+		*--p = '0' + v % 10;
+		v /= 10;
+	} while(v);
+	if(value < 0) *--p = '-';
+	out.append(p, buf + sizeof(buf) - p);
+}
+
 //---------------------------------------------------------------------------
 unsigned char from_hex_digit(char digit)
 {
@@ -38,6 +38,9 @@ std::string date_to_string(const void *bytedate);
 std::string hexstring(const char *buf, int n);
 std::string hexstring(TStream *str);
 std::string toXML(const std::string &in);
+void append_xml_escaped(std::string &out, const char *in, size_t length); // дописывает в out строку с заменой спецсимволов XML
+void escape_xml_tail(std::string &out, size_t start); // заменяет спецсимволы XML в out, начиная с позиции start
+void append_int(std::string &out, int64_t value); // дописывает в out десятичное представление числа
 unsigned char from_hex_digit(char digit);
 
 //---------------------------------------------------------------------------
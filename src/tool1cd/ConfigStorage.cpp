@@ -21,6 +21,7 @@
 #include <memory>
 
 #include "ConfigStorage.h"
+#include "TreeReader.h"
 #include "Common.h"
 #include "Base64.h"
 #include "TempStream.h"
@@ -38,7 +39,8 @@ const int lsdynupdate = sdynupdate.size();
 
 extern Registrator msreg_g;
 
-std::vector<BinaryGuid> parse_dynamically_updated_tree(unique_ptr<Tree> tt);
+std::vector<BinaryGuid> read_dynamically_updated(TStream *stream, const std::string &path);
+int read_configinfo_header(TreeReader &reader, const std::string &path);
 
 //********************************************************
 // Класс ConfigStorageDirectory
@@ -580,8 +582,6 @@ ConfigStorageTableConfig::ConfigStorageTableConfig(TableFiles* tabf, T_1CD* _bas
 	TableFile* tf;
 	TableFile* _DynamicallyUpdated;
 	ContainerFile* DynamicallyUpdated;
-	Tree* tt;
-	Tree* ct;
 	std::vector<BinaryGuid> dynup;
 	BinaryGuid g;
 	Table* tab;
@@ -603,9 +603,8 @@ ConfigStorageTableConfig::ConfigStorageTableConfig(TableFiles* tabf, T_1CD* _bas
 		string detail_path_name = tab->get_base()->get_filename()
 								  + "\\" + tab->get_name()
 								  + "\\" + DynamicallyUpdated.name;
-		auto tt = parse_1Cstream(DynamicallyUpdated.stream, detail_path_name);
 		try {
-			dynup = parse_dynamically_updated_tree(std::move(tt));
+			dynup = read_dynamically_updated(DynamicallyUpdated.stream, detail_path_name);
 		} catch (DetailedException &ex) {
 			ex.add_detail("Путь", detail_path_name);
 			throw ex;
@@ -701,8 +700,6 @@ ConfigStorageTableConfigSave::ConfigStorageTableConfigSave(TableFiles* tabc, Tab
 	std::map<string,ContainerFile*>::iterator pfiles;
 	TableFile* _DynamicallyUpdated;
 	TableFile* _deleted;
-	Tree* tt;
-	Tree* ct;
 	BinaryGuid g;
 	Table* tab;
 	int dynno;
@@ -726,10 +723,9 @@ ConfigStorageTableConfigSave::ConfigStorageTableConfigSave(TableFiles* tabc, Tab
 		string detail_path_name = tab->get_base()->get_filename()
 				   + "\\" + tab->get_name()
 				   + "\\" + deleted.name;
-		auto tt = parse_1Cstream(deleted.stream, detail_path_name);
 		std::vector<BinaryGuid> dynup;
 		try {
-			dynup = parse_dynamically_updated_tree(std::move(tt));
+			dynup = read_dynamically_updated(deleted.stream, detail_path_name);
 		} catch (DetailedException &ex) {
 			ex.add_detail("Путь", detail_path_name);
 			throw ex;
@@ -750,9 +746,8 @@ ConfigStorageTableConfigSave::ConfigStorageTableConfigSave(TableFiles* tabc, Tab
 		string detail_path_name = tab->get_base()->get_filename()
 				+ "\\" + tab->get_name()
 				+ "\\" + DynamicallyUpdated.name;
-		auto tt = parse_1Cstream(DynamicallyUpdated.stream, detail_path_name);
 		try {
-			dynup = parse_dynamically_updated_tree(std::move(tt));
+			dynup = read_dynamically_updated(DynamicallyUpdated.stream, detail_path_name);
 		} catch (DetailedException &ex) {
 			ex.add_detail("Путь", detail_path_name);
 			throw ex;
@@ -858,7 +853,6 @@ ConfigStorageTableConfigCas::ConfigStorageTableConfigCas(TableFiles *tabc, const
 	int m;
 	TableFile* _configinfo;
 	ContainerFile* configinfo;
-	Tree* ct;
 	TableFile* tf;
 	ContainerFile* pcf;
 	TMemoryStream* stream;
@@ -882,66 +876,26 @@ ConfigStorageTableConfigCas::ConfigStorageTableConfigCas(TableFiles *tabc, const
 	files["configinfo"] = configinfo;
 	configinfo->open();
 
-	auto tt = parse_1Cstream(configinfo->stream, filepath);
-	if(tt == nullptr)
-	{
-		throw DetailedException("Ошибка разбора файла configinfo")
-			.add_detail("Путь", filepath);
-	}
-	ct = tt->get_first();
-	if(!ct)
-	{
-		throw DetailedException("Ошибка разбора файла configinfo")
-			.add_detail("Путь", filepath);
-	}
-	ct = ct->get_next();
-	if(!ct)
-	{
-		throw DetailedException("Ошибка разбора файла configinfo")
-			.add_detail("Путь", filepath);
-	}
-	ct = ct->get_next();
-	if(!ct)
-	{
-		throw DetailedException("Ошибка разбора файла configinfo")
-			.add_detail("Путь", filepath);
-	}
-	ct = ct->get_first();
-	if(!ct)
-	{
-		throw DetailedException("Ошибка разбора файла configinfo")
-			.add_detail("Путь", filepath);
-	}
+	TreeReader reader(configinfo->stream, filepath);
+	m = read_configinfo_header(reader, filepath);
 
 	stream = new TMemoryStream;
-	for(m = ToIntDef(ct->get_value(), 0); m; --m)
+	for(; m; --m)
 	{
-		ct = ct->get_next();
-		if(!ct)
-		{
-			throw DetailedException("Ошибка разбора файла configinfo")
-				.add_detail("Путь", filepath);
-		}
-		if(ct->get_type() != node_type::nd_string)
+		if(reader.next() != tree_event::value || reader.get_type() != node_type::nd_string)
 		{
 			throw DetailedException("Ошибка разбора файла configinfo")
 				.add_detail("Путь", filepath);
 		}
-		string name = ct->get_value();
+		string name = reader.get_value();
 
-		ct = ct->get_next();
-		if(!ct)
-		{
-			throw DetailedException("Ошибка разбора файла configinfo")
-				.add_detail("Путь", filepath);
-		}
-		if(ct->get_type() != node_type::nd_binary2)
+		if(reader.next() != tree_event::value || reader.get_type() != node_type::nd_binary2)
 		{
 			throw DetailedException("Ошибка разбора файла configinfo")
 				.add_detail("Путь", filepath);
 		}
 		stream->Seek(0l, soBeginning);
-		base64_decode(ct->get_value(), stream);
+		base64_decode(reader.get_value(), stream);
 		stream->Seek(0l, soBeginning);
 		string hashname = hexstring(stream);
 
@@ -981,7 +935,6 @@ ConfigStorageTableConfigCasSave::ConfigStorageTableConfigCasSave(TableFiles *tab
 	int m;
 	TableFile* _configinfo;
 	ContainerFile* configinfo;
-	Tree* ct;
 	TMemoryStream* stream;
 	std::map<string,TableFile*>::iterator ptf;
 
@@ -1037,70 +990,32 @@ ConfigStorageTableConfigCasSave::ConfigStorageTableConfigCasSave(TableFiles *tab
 
 	configinfo->open();
 
-	auto tt = parse_1Cstream(configinfo->stream, config_info_path);
-	if(tt == nullptr)
-	{
-		throw DetailedException("Ошибка разбора файла configinfo")
-			.add_detail("Путь", config_info_path);
-	}
-	ct = tt->get_first();
-	if(!ct)
-	{
-		throw DetailedException("Ошибка разбора файла configinfo")
-			.add_detail("Путь", config_info_path);
-	}
-	ct = ct->get_next();
-	if(!ct)
-	{
-		throw DetailedException("Ошибка разбора файла configinfo")
-			.add_detail("Путь", config_info_path);
-	}
-	ct = ct->get_next();
-	if(!ct)
-	{
-		throw DetailedException("Ошибка разбора файла configinfo")
-			.add_detail("Путь", config_info_path);
-	}
-	ct = ct->get_first();
-	if(!ct)
-	{
-		throw DetailedException("Ошибка разбора файла configinfo")
-			.add_detail("Путь", config_info_path);
-	}
+	TreeReader reader(configinfo->stream, config_info_path);
+	m = read_configinfo_header(reader, config_info_path);
 
 	stream = new TMemoryStream;
-	for (auto m = ToIntDef(ct->get_value(), 0); m; --m)
+	for(; m; --m)
 	{
-		ct = ct->get_next();
-		if(!ct)
+		if(reader.next() != tree_event::value || reader.get_type() != node_type::nd_string)
 		{
 			throw DetailedException("Ошибка разбора файла configinfo")
 				.add_detail("Путь", config_info_path);
 		}
-		if(ct->get_type() != node_type::nd_string)
-		{
-			throw DetailedException("Ошибка разбора файла configinfo")
-				.add_detail("Путь", config_info_path);
-		}
-		string name = ct->get_value();
+		string name = reader.get_value();
 
-		ct = ct->get_next();
+		tree_event hash_event = reader.next();
+		if(hash_event == tree_event::list_begin) reader.skip();
 		if (files.find(LowerCase(name)) != files.end()) {
 			continue;
 		}
 
-		if(!ct)
-		{
-			throw DetailedException("Ошибка разбора файла configinfo")
-				.add_detail("Путь", config_info_path);
-		}
-		if(ct->get_type() != node_type::nd_binary2)
+		if(hash_event != tree_event::value || reader.get_type() != node_type::nd_binary2)
 		{
 			throw DetailedException("Ошибка разбора файла configinfo")
 				.add_detail("Путь", config_info_path);
 		}
 		stream->Seek(0l, soBeginning);
-		base64_decode(ct->get_value(), stream);
+		base64_decode(reader.get_value(), stream);
 		stream->Seek(0l, soBeginning);
 		string hashname = hexstring(stream);
 
@@ -1129,39 +1044,52 @@ std::string ConfigStorageTableConfigCasSave::presentation() const
 	return present;
 }
 
-std::vector<BinaryGuid> parse_dynamically_updated_tree(unique_ptr<Tree> tt)
+//---------------------------------------------------------------------------
+// Файл DynamicallyUpdated: {<версия>,<количество>,<guid>,...}
+std::vector<BinaryGuid> read_dynamically_updated(TStream *stream, const std::string &path)
 {
-	if (!tt) {
+	TreeReader reader(stream, path);
+	if (reader.next() != tree_event::list_begin || !reader.skip_item()) {
 		throw DetailedException("Ошибка разбора файла DynamicallyUpdated");
 	}
 
-	Tree *ct = tt->get_first();
-	if (!ct) {
-		throw DetailedException("Ошибка разбора файла DynamicallyUpdated");
-	}
-	ct = ct->get_first();
-	if (!ct) {
+	if (reader.next() != tree_event::value || reader.get_type() != node_type::nd_number) {
 		throw DetailedException("Ошибка разбора файла DynamicallyUpdated");
 	}
 
-	ct = ct->get_next();
-	if (!ct) {
-		throw DetailedException("Ошибка разбора файла DynamicallyUpdated");
-	}
-
-	if (ct->get_type() != node_type::nd_number) {
-		throw DetailedException("Ошибка разбора файла DynamicallyUpdated");
-	}
-
-	int ndynup = ToIntDef(ct->get_value(), 0);
+	int ndynup = ToIntDef(reader.get_value(), 0);
 	std::vector<BinaryGuid> dynup;
-	dynup.reserve(ndynup);
 	if (ndynup > 0) {
 		dynup.reserve(ndynup);
 		while (ndynup--) {
-			ct = ct->get_next();
-			dynup.emplace_back(BinaryGuid(ct->get_value()));
+			if (reader.next() != tree_event::value) {
+				throw DetailedException("Ошибка разбора файла DynamicallyUpdated");
+			}
+			dynup.emplace_back(BinaryGuid(reader.get_value()));
 		}
 	}
 	return dynup;
 }
+
+//---------------------------------------------------------------------------
+// Файл configinfo: <>,<>,{<количество>,<имя>,<хеш>,...},...
+// Читает начало списка файлов и возвращает количество файлов
+int read_configinfo_header(TreeReader &reader, const std::string &path)
+{
+	if(!reader.skip_item() || !reader.skip_item() || reader.next() != tree_event::list_begin)
+	{
+		throw DetailedException("Ошибка разбора файла configinfo")
+			.add_detail("Путь", path);
+	}
+
+	switch(reader.next())
+	{
+		case tree_event::value:
+			return ToIntDef(reader.get_value(), 0);
+		case tree_event::list_begin:
+			return 0;
+		default:
+			throw DetailedException("Ошибка разбора файла configinfo")
+				.add_detail("Путь", path);
+	}
+}
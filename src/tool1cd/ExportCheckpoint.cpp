@@ -0,0 +1,206 @@
+/*
+    Tool1CD library provides access to 1CD database files.
+    Copyright © 2009-2017 awa
+    Copyright © 2017-2018 E8 Tools contributors
+
+    This file is part of Tool1CD Library.
+
+    Tool1CD Library is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Tool1CD Library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with Tool1CD Library.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <boost/filesystem/fstream.hpp>
+
+#include "ExportCheckpoint.h"
+#include "BufferedWriter.h"
+#include "GzipStream.h"
+#include "DetailedException.h"
+#include "SystemClasses/TFileStream.hpp"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#endif
+
+using namespace std;
+
+namespace {
+
+//---------------------------------------------------------------------------
+// Сбрасывает записанные данные файла на диск. Поток выгрузки уже передал их системе,
+// поэтому файл открывается заново по имени
+void sync_file(const boost::filesystem::path &path)
+{
+#ifdef _WIN32
+	HANDLE handle = CreateFileW(path.c_str(), GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr,
+								OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	bool ok = handle != INVALID_HANDLE_VALUE && FlushFileBuffers(handle);
+	string error = ok ? string() : to_string(GetLastError());
+	if(handle != INVALID_HANDLE_VALUE) CloseHandle(handle);
+#else
+	int fd = ::open(path.c_str(), O_RDONLY);
+#ifdef __linux__
+	bool ok = fd >= 0 && ::fdatasync(fd) == 0;
+#else
+	bool ok = fd >= 0 && ::fsync(fd) == 0;
+#endif
+	string error = ok ? string() : string(strerror(errno));
+	if(fd >= 0) ::close(fd);
+#endif
+	if(!ok)
+	{
+		throw DetailedException("Ошибка сброса файла на диск")
+			.add_detail("Файл", path.string())
+			.add_detail("Ошибка", error);
+	}
+}
+
+} // namespace
+
+//---------------------------------------------------------------------------
+ExportCheckpoint::ExportCheckpoint(const boost::filesystem::path &state_file)
+	: state_file(state_file)
+{
+	if(!boost::filesystem::exists(state_file)) return;
+
+	boost::filesystem::ifstream in(state_file, ios::binary);
+	string line;
+	uint64_t complete_size = 0; // размер файла без последней строки, записанной не полностью
+	uint64_t pos = 0;
+	while(getline(in, line))
+	{
+		// последняя строка может быть записана не полностью
+		pos += line.size() + (in.eof() ? 0 : 1);
+		if(in.eof()) continue;
+		complete_size = pos;
+		if(line.empty() || line.back() != '\r') continue;
+		line.pop_back();
+
+		if(line.compare(0, 5, "done\t") == 0)
+		{
+			states[line.substr(5)].done = true;
+			continue;
+		}
+		if(line.compare(0, 5, "part\t") != 0) continue;
+
+		size_t p1 = line.find('\t', 5);
+		size_t p2 = p1 == string::npos ? p1 : line.find('\t', p1 + 1);
+		if(p2 == string::npos) continue;
+		State &state = states[line.substr(p2 + 1)];
+		state.done = false;
+		state.records = stoul(line.substr(5, p1 - 5));
+		state.size = stoull(line.substr(p1 + 1, p2 - p1 - 1));
+	}
+	in.close();
+
+	// иначе следующая строка будет дописана в продолжение оборванной
+	if(complete_size < pos) boost::filesystem::resize_file(state_file, complete_size);
+}
+
+//---------------------------------------------------------------------------
+string ExportCheckpoint::get_key(const string &file_name)
+{
+	return boost::filesystem::path(file_name).filename().string();
+}
+
+//---------------------------------------------------------------------------
+bool ExportCheckpoint::is_done(const string &file_name) const
+{
+	lock_guard<mutex> guard(lock);
+	auto state = states.find(get_key(file_name));
+	return state != states.end() && state->second.done;
+}
+
+//---------------------------------------------------------------------------
+void ExportCheckpoint::set_done(const string &file_name)
+{
+	if(boost::filesystem::is_regular_file(file_name)) sync_file(file_name);
+
+	lock_guard<mutex> guard(lock);
+	string key = get_key(file_name);
+	states[key].done = true;
+	append("done\t" + key);
+}
+
+//---------------------------------------------------------------------------
+unique_ptr<TStream> ExportCheckpoint::open_stream(const string &file_name, uint32_t &records)
+{
+	records = 0;
+	boost::filesystem::path path(file_name);
+
+	State state;
+	{
+		lock_guard<mutex> guard(lock);
+		auto found = states.find(get_key(file_name));
+		if(found != states.end()) state = found->second;
+	}
+
+	bool compressed = path.extension() == ".gz";
+	if(compressed || state.done || !state.records || !boost::filesystem::exists(path)
+		|| boost::filesystem::file_size(path) < state.size)
+	{
+		return create_export_stream(path);
+	}
+
+	boost::filesystem::resize_file(path, state.size);
+	unique_ptr<TStream> stream(new TFileStream(path, fmOpenReadWrite));
+	stream->Seek(0, soFromEnd);
+	records = state.records;
+	return stream;
+}
+
+//---------------------------------------------------------------------------
+void ExportCheckpoint::save(const string &file_name, uint32_t records, BufferedWriter &f)
+{
+	if(boost::filesystem::path(file_name).extension() == ".gz") return;
+
+	f.flush();
+	uint64_t size = f.get_stream()->GetPosition();
+	// состояние не должно ссылаться на данные, которые после сбоя питания могут не оказаться в файле
+	sync_file(file_name);
+
+	lock_guard<mutex> guard(lock);
+	string key = get_key(file_name);
+	State &state = states[key];
+	state.done = false;
+	state.records = records;
+	state.size = size;
+	append("part\t" + to_string(records) + "\t" + to_string(size) + "\t" + key);
+}
+
+//---------------------------------------------------------------------------
+void ExportCheckpoint::clear()
+{
+	lock_guard<mutex> guard(lock);
+	states.clear();
+	boost::system::error_code ec;
+	boost::filesystem::remove(state_file, ec);
+}
+
+//---------------------------------------------------------------------------
+void ExportCheckpoint::append(const string &line)
+{
+	boost::filesystem::ofstream out(state_file, ios::binary | ios::app);
+	out << line << "\r\n";
+	out.close();
+	if(!out)
+	{
+		throw DetailedException("Ошибка записи файла состояния выгрузки")
+			.add_detail("Файл", state_file.string());
+	}
+	sync_file(state_file);
+}
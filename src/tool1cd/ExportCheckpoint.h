@@ -0,0 +1,81 @@
+/*
+    Tool1CD library provides access to 1CD database files.
+    Copyright © 2009-2017 awa
+    Copyright © 2017-2018 E8 Tools contributors
+
+    This file is part of Tool1CD Library.
+
+    Tool1CD Library is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Tool1CD Library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with Tool1CD Library.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef TOOL1CD_PROJECT_EXPORTCHECKPOINT_H
+#define TOOL1CD_PROJECT_EXPORTCHECKPOINT_H
+
+#include <string>
+#include <map>
+#include <mutex>
+#include <memory>
+#include <boost/filesystem.hpp>
+
+#include "SystemClasses/TStream.hpp"
+
+class BufferedWriter;
+
+const char EXPORT_CHECKPOINT_FILE_NAME[] = "tool1cd.checkpoint"; // имя файла состояния в каталоге выгрузки
+const uint32_t EXPORT_CHECKPOINT_RECORDS = 0x10000; // через сколько выгруженных записей сохраняется состояние
+
+// Состояние выгрузки для продолжения после сбоя.
+// Файл состояния текстовый, строки только дописываются в конец, последняя строка для файла выгрузки главнее:
+//   part<TAB>количество выгруженных записей<TAB>размер файла выгрузки<TAB>имя файла выгрузки
+//   done<TAB>имя файла выгрузки
+// Файлы выгрузки идентифицируются по имени без каталога, так как файл состояния лежит в каталоге выгрузки.
+// Перед записью строки файл выгрузки сбрасывается на диск, после записи - сам файл состояния
+class ExportCheckpoint
+{
+public:
+	explicit ExportCheckpoint(const boost::filesystem::path &state_file);
+
+	ExportCheckpoint(const ExportCheckpoint &) = delete;
+	ExportCheckpoint &operator=(const ExportCheckpoint &) = delete;
+
+	bool is_done(const std::string &file_name) const;
+	void set_done(const std::string &file_name);
+
+	// Открывает файл выгрузки. Если выгрузка файла была прервана и файл не короче сохраненного размера,
+	// файл обрезается до этого размера, а в records возвращается количество уже выгруженных записей.
+	// Иначе файл создается заново (сжатые файлы всегда создаются заново) и records = 0
+	std::unique_ptr<TStream> open_stream(const std::string &file_name, uint32_t &records);
+
+	// сбрасывает буфер выгрузки в файл и сохраняет количество выгруженных записей
+	void save(const std::string &file_name, uint32_t records, BufferedWriter &f);
+
+	void clear(); // удаляет файл состояния после успешного завершения всей выгрузки
+
+private:
+	struct State
+	{
+		bool done {false};
+		uint32_t records {0};
+		uint64_t size {0};
+	};
+
+	boost::filesystem::path state_file;
+	std::map<std::string, State> states;
+	mutable std::mutex lock;
+
+	static std::string get_key(const std::string &file_name);
+	void append(const std::string &line);
+};
+
+#endif //TOOL1CD_PROJECT_EXPORTCHECKPOINT_H
@@ -71,16 +71,28 @@ int32_t Field::get_size() const // возвращает длину поля в 
 // При ignore_showGUID binary16 всегда преобразуется в GUID
 std::string Field::get_presentation(const char *rec, bool EmptyNull, wchar_t Delimiter, bool ignore_showGUID,
 									bool detailed) const
+{
+	std::string result;
+	append_presentation(result, rec, EmptyNull, Delimiter, ignore_showGUID, detailed);
+	return result;
+}
+
+//---------------------------------------------------------------------------
+void Field::append_presentation(std::string &out, const char *rec, bool EmptyNull, wchar_t Delimiter, bool ignore_showGUID,
+								bool detailed) const
 {
 	const char* fr = rec + offset;
 	if (get_null_exists()) {
 		if (fr[0] == 0) {
-			return EmptyNull ? "" : "{NULL}";
+			if (!EmptyNull) {
+				out += "{NULL}";
+			}
+			return;
 		}
 		fr++;
 	}
-	return type_manager->get_presentation(
-			fr,
+	type_manager->append_presentation(
+			out, fr,
 			EmptyNull, Delimiter, ignore_showGUID, detailed
 	);
 }
@@ -102,15 +114,36 @@ bool Field::get_binary_value(char *binary_value, bool null, const std::string &v
 
 //---------------------------------------------------------------------------
 std::string Field::get_XML_presentation(const char *rec, bool ignore_showGUID) const
+{
+	std::string result;
+	append_XML_presentation(result, rec, ignore_showGUID);
+	return result;
+}
+
+//---------------------------------------------------------------------------
+void Field::append_XML_presentation(std::string &out, const char *rec, bool ignore_showGUID) const
+{
+	const char *fr = rec + offset;
+	if (null_exists) {
+		if (fr[0] == 0) {
+			return;
+		}
+		fr++;
+	}
+	type_manager->append_XML_presentation(out, fr, parent, ignore_showGUID);
+}
+
+//---------------------------------------------------------------------------
+void Field::append_text_presentation(std::string &out, const char *rec) const
 {
 	const char *fr = rec + offset;
 	if (null_exists) {
 		if (fr[0] == 0) {
-			return "";
+			return;
 		}
 		fr++;
 	}
-	return type_manager->get_XML_presentation(fr, parent, ignore_showGUID);
+	type_manager->append_text_presentation(out, fr, parent);
 }
 
 //---------------------------------------------------------------------------
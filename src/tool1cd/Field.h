@@ -50,8 +50,17 @@ public:
 			wchar_t Delimiter = 0,
 			bool ignore_showGUID = false,
 			bool detailed = false) const;
+	void append_presentation(
+			std::string &out,
+			const char *rec,
+			bool EmptyNull = false,
+			wchar_t Delimiter = 0,
+			bool ignore_showGUID = false,
+			bool detailed = false) const;
 
 	std::string get_XML_presentation(const char *rec, bool ignore_showGUID = false) const;
+	void append_XML_presentation(std::string &out, const char *rec, bool ignore_showGUID = false) const;
+	void append_text_presentation(std::string &out, const char *rec) const;
 
 	bool get_binary_value(char *buf, bool null, const std::string &value) const;
 	type_fields get_type() const;
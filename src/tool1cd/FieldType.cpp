@@ -25,6 +25,8 @@
 #include "Base64.h"
 #include "Table.h"
 #include "BinaryDecimalNumber.h"
+#include "SystemClasses/String.hpp"
+#include "RecordDecoder.h"
 #include <vector>
 
 using namespace std;
@@ -37,51 +39,189 @@ bool FieldType::showGUID = false;
 
 namespace Convert {
 
-string from_binary(const uint8_t *fr, int32_t length)
-{
-	string result;
-	result.resize((length + 1) * 2);
+const char hex_digits[] = "0123456789abcdef";
 
+void append_binary(string &out, const uint8_t *fr, int32_t length)
+{
+	size_t pos = out.size();
+	out.resize(pos + length * 2);
 	for(int32_t i = 0; i < length; i++) {
-		char sym = '0' + (fr[i] >> 4);
-		if(sym > '9') {
-			sym += ('a' - '9' - 1);
-		}
-		result[i << 1] = sym;
-		sym = '0' + (fr[i] & 0xf);
-		if(sym > '9') {
-			sym += ('a' - '9' - 1);
-		}
-		result[(i << 1) + 1] = sym;
+		out[pos++] = hex_digits[fr[i] >> 4];
+		out[pos++] = hex_digits[fr[i] & 0xf];
 	}
+}
 
-	result[length << 1] = 0;
+void append_varbinary(string &out, const uint8_t *fr, int32_t length)
+{
+	int32_t m = *(int16_t*)fr; // длина + смещение
+	append_binary(out, fr + 2, std::max(0, std::min(m, length)));
+}
 
-	return result;
+// то же, что to_hex_string для int32_t: 0x и 8 шестнадцатеричных цифр
+void append_hex(string &out, uint32_t value)
+{
+	out += "0x";
+	for(int shift = 28; shift >= 0; shift -= 4) {
+		out += hex_digits[(value >> shift) & 0xf];
+	}
 }
 
-string from_varbinary(const uint8_t *fr, int32_t length)
+// как минимум две цифры
+void append_two_digits(string &out, int value)
 {
-	string result;
-	result.resize((length + 1) * 2);
+	if(value >= 0 && value < 10) {
+		out += '0';
+	}
+	append_int(out, value);
+}
 
-	int32_t m = *(int16_t*)fr; // длина + смещение
-	for(int32_t i = 0; i < m; i++) {
-		char sym = '0' + (fr[i + 2] >> 4);
-		if(sym > '9') {
-			sym += ('a' - '9' - 1);
+}
+
+// Ядра RecordDecoder: специализации по типу поля и формату (xml - с экранированием спецсимволов XML).
+// Результат совпадает с append_XML_presentation (xml) и append_text_presentation (text)
+namespace Decoders {
+
+template <type_fields type, bool xml>
+struct Value;
+
+template <bool xml>
+struct Value<type_fields::tf_bool, xml>
+{
+	static void decode(string &out, const char *rec, const field_decoder_step &)
+	{
+		out += rec[0] ? "true" : "false";
+	}
+};
+
+template <bool xml>
+struct Value<type_fields::tf_char, xml>
+{
+	static void decode(string &out, const char *rec, const field_decoder_step &step)
+	{
+		size_t start = out.size();
+		System::AppendUtf16AsUtf8(out, rec, step.length * sizeof(WCHART));
+		if(xml) {
+			escape_xml_tail(out, start);
 		}
-		result[i << 1] = sym;
-		sym = '0' + (fr[i + 2] & 0xf);
-		if(sym > '9') {
-			sym += ('a' - '9' - 1);
+	}
+};
+
+template <bool xml>
+struct Value<type_fields::tf_varchar, xml>
+{
+	static void decode(string &out, const char *rec, const field_decoder_step &step)
+	{
+		size_t start = out.size();
+		int16_t length = *reinterpret_cast<const int16_t *>(rec);
+		size_t full_size = length * sizeof(WCHART);
+		size_t max_size = step.length * sizeof(WCHART) + sizeof(length);
+		System::AppendUtf16AsUtf8(out, rec + sizeof(length), std::min(full_size, max_size));
+		if(xml) {
+			escape_xml_tail(out, start);
 		}
-		result[(i << 1) + 1] = sym;
 	}
+};
 
-	result[m << 1] = 0;
+template <bool xml>
+struct Value<type_fields::tf_version, xml>
+{
+	static void decode(string &out, const char *rec, const field_decoder_step &)
+	{
+		auto retyped = reinterpret_cast<const int32_t *>(rec);
+		append_int(out, retyped[0]);
+		out += ':';
+		append_int(out, retyped[1]);
+		out += ':';
+		append_int(out, retyped[2]);
+		out += ':';
+		append_int(out, retyped[3]);
+	}
+};
 
-	return result;
+template <bool xml>
+struct Value<type_fields::tf_version8, xml>
+{
+	static void decode(string &out, const char *rec, const field_decoder_step &)
+	{
+		auto retyped = reinterpret_cast<const int32_t *>(rec);
+		append_int(out, retyped[0]);
+		out += ':';
+		append_int(out, retyped[1]);
+	}
+};
+
+template <bool xml>
+struct Value<type_fields::tf_binary, xml>
+{
+	static void decode(string &out, const char *rec, const field_decoder_step &step)
+	{
+		Convert::append_binary(out, reinterpret_cast<const uint8_t *>(rec), step.length);
+	}
+};
+
+template <bool xml>
+struct Value<type_fields::tf_varbinary, xml>
+{
+	static void decode(string &out, const char *rec, const field_decoder_step &step)
+	{
+		Convert::append_varbinary(out, reinterpret_cast<const uint8_t *>(rec), step.length);
+	}
+};
+
+template <bool xml>
+struct Value<type_fields::tf_numeric, xml>
+{
+	static void decode(string &out, const char *rec, const field_decoder_step &step)
+	{
+		append_decimal_presentation(out, rec, step.length, step.precision, true);
+	}
+};
+
+template <bool xml>
+struct Value<type_fields::tf_datetime, xml>
+{
+	static void decode(string &out, const char *rec, const field_decoder_step &)
+	{
+		decimal_datetime dt = decode_decimal_date(rec);
+		append_int(out, dt.year);
+		out += '-';
+		Convert::append_two_digits(out, dt.month);
+		out += '-';
+		Convert::append_two_digits(out, dt.day);
+		out += 'T';
+		Convert::append_two_digits(out, dt.hour);
+		out += ':';
+		Convert::append_two_digits(out, dt.minute);
+		out += ':';
+		Convert::append_two_digits(out, dt.second);
+	}
+};
+
+template <type_fields type>
+field_decoder_kernel kernel(decode_format format)
+{
+	return format == decode_format::xml ? &Value<type, true>::decode : &Value<type, false>::decode;
+}
+
+void guid_1C(string &out, const char *rec, const field_decoder_step &)
+{
+	append_GUIDas1C(out, reinterpret_cast<const unsigned char *>(rec));
+}
+
+void guid_MS(string &out, const char *rec, const field_decoder_step &)
+{
+	append_GUIDasMS(out, reinterpret_cast<const unsigned char *>(rec));
+}
+
+// типы, для которых нет специализации (blob-поля): значение формирует сам FieldType
+void generic_xml(string &out, const char *rec, const field_decoder_step &step)
+{
+	step.type_manager->append_XML_presentation(out, rec, step.parent, false);
+}
+
+void generic_text(string &out, const char *rec, const field_decoder_step &step)
+{
+	step.type_manager->append_text_presentation(out, rec, step.parent);
 }
 
 }
@@ -157,7 +297,8 @@ public:
 		return len;
 	}
 
-	virtual string get_presentation(
+	virtual void append_presentation(
+			string &out,
 			const char *rec,
 			bool EmptyNull,
 			wchar_t Delimiter,
@@ -169,16 +310,24 @@ public:
 
 	virtual bool get_binary_value(char *buf, const string &value) const override;
 
-	virtual string get_XML_presentation(
+	virtual void append_XML_presentation(
+			string &out,
 			const char *rec,
 			const Table *parent,
 			bool ignore_showGUID) const override;
 
+	virtual void append_text_presentation(
+			string &out,
+			const char *rec,
+			const Table *parent) const override;
+
 	virtual uint32_t get_sort_key(
 			const char* rec,
 			unsigned char* SortKey,
 			int32_t maxlen) const override;
 
+	virtual field_decoder_kernel get_decoder_kernel(decode_format format) const override;
+
 	type_fields type {type_fields::tf_binary};
 	int32_t length {0};
 	int32_t precision {0};
@@ -200,7 +349,8 @@ public:
 	{
 	}
 
-	virtual string get_presentation(
+	virtual void append_presentation(
+			string &out,
 			const char *rec,
 			bool EmptyNull,
 			wchar_t Delimiter,
@@ -211,7 +361,8 @@ public:
 			char *buf,
 			const string &value) const override;
 
-	virtual string get_XML_presentation(
+	virtual void append_XML_presentation(
+			string &out,
 			const char *rec,
 			const Table *parent,
 			bool ignore_showGUID) const override;
@@ -220,6 +371,8 @@ public:
 			const char* rec,
 			unsigned char* SortKey,
 			int32_t maxlen) const override;
+
+	virtual field_decoder_kernel get_decoder_kernel(decode_format format) const override;
 };
 
 class NumericFieldType : public CommonFieldType
@@ -230,8 +383,9 @@ public:
 	{
 	}
 
-	virtual string get_presentation(
-			const char* rec,
+	virtual void append_presentation(
+			string &out,
+			const char *rec,
 			bool EmptyNull,
 			wchar_t Delimiter,
 			bool ignore_showGUID,
@@ -241,7 +395,8 @@ public:
 			char *buf,
 			const string &value) const override;
 
-	virtual string get_XML_presentation(
+	virtual void append_XML_presentation(
+			string &out,
 			const char *rec,
 			const Table *parent,
 			bool ignore_showGUID) const override;
@@ -250,6 +405,8 @@ public:
 			const char* rec,
 			unsigned char* SortKey,
 			int32_t maxlen) const override;
+
+	virtual field_decoder_kernel get_decoder_kernel(decode_format format) const override;
 };
 
 class DatetimeFieldType : public CommonFieldType
@@ -260,8 +417,9 @@ public:
 			{
 			}
 
-	virtual string get_presentation(
-			const char* rec,
+	virtual void append_presentation(
+			string &out,
+			const char *rec,
 			bool EmptyNull,
 			wchar_t Delimiter,
 			bool ignore_showGUID,
@@ -271,7 +429,8 @@ public:
 			char* buf,
 			const string& value) const override;
 
-	virtual string get_XML_presentation(
+	virtual void append_XML_presentation(
+			string &out,
 			const char *rec,
 			const Table *parent,
 			bool ignore_showGUID) const override;
@@ -280,6 +439,8 @@ public:
 			const char* rec,
 			unsigned char* SortKey,
 			int32_t maxlen) const override;
+
+	virtual field_decoder_kernel get_decoder_kernel(decode_format format) const override;
 };
 
 class GuidFieldType : public BinaryFieldType
@@ -290,17 +451,21 @@ public:
 	{
 	}
 
-	virtual string get_presentation(
+	virtual void append_presentation(
+			string &out,
 			const char *rec,
 			bool EmptyNull,
 			wchar_t Delimiter,
 			bool ignore_showGUID,
 			bool detailed) const override;
 
-	virtual string get_XML_presentation(
+	virtual void append_XML_presentation(
+			string &out,
 			const char *rec,
 			const Table *parent,
 			bool ignore_showGUID) const override;
+
+	virtual field_decoder_kernel get_decoder_kernel(decode_format format) const override;
 };
 
 bool BinaryFieldType::get_binary_value(char *binary_value, const string &value) const
@@ -314,30 +479,35 @@ bool BinaryFieldType::get_binary_value(char *binary_value, const string &value)
 			if(value.size() == 0) {
 				break;
 			}
-			int32_t j = 1;
+			size_t j = 0;
+			auto hex_byte = [&value, &j]() {
+				unsigned char b = (from_hex_digit(value[j]) << 4) + from_hex_digit(value[j + 1]);
+				j += 2;
+				return b;
+			};
 			if(length == GUID_BINARY_SIZE && showGUID) // TODO Надо доделать для showGUIDasMS
 			{
 				if(value.size() < GUID_LEN) {
 					break;
 				}
 				for(int32_t ind = 12; ind < GUID_BINARY_SIZE; ind++) {
-					fr[ind] = (from_hex_digit(value[j++]) << 4) + from_hex_digit(value[j++]);
+					fr[ind] = hex_byte();
 				}
 				j++;
 				for(int32_t ind = 10; ind < 12; ind++) {
-					fr[ind] = (from_hex_digit(value[j++]) << 4) + from_hex_digit(value[j++]);
+					fr[ind] = hex_byte();
 				}
 				j++;
 				for(int32_t ind = 8; ind < 10; ind++) {
-					fr[ind] = (from_hex_digit(value[j++]) << 4) + from_hex_digit(value[j++]);
+					fr[ind] = hex_byte();
 				}
 				j++;
 				for(int32_t ind = 0; ind < 2; ind++) {
-					fr[ind] = (from_hex_digit(value[j++]) << 4) + from_hex_digit(value[j++]);
+					fr[ind] = hex_byte();
 				}
 				j++;
 				for(int32_t ind = 2; ind < 8; ind++) {
-					fr[ind] = (from_hex_digit(value[j++]) << 4) + from_hex_digit(value[j++]);
+					fr[ind] = hex_byte();
 				}
 			}
 			else {
@@ -345,7 +515,7 @@ bool BinaryFieldType::get_binary_value(char *binary_value, const string &value)
 					break;
 				}
 				for(int32_t ind = 0; ind < length; ind++) {
-					fr[ind] = (from_hex_digit(value[j++]) << 4) + from_hex_digit(value[j++]);
+					fr[ind] = hex_byte();
 				}
 			}
 			break;
@@ -358,7 +528,7 @@ bool BinaryFieldType::get_binary_value(char *binary_value, const string &value)
 	return true;
 }
 
-string BinaryFieldType::get_presentation(const char *rec, bool EmptyNull, wchar_t Delimiter, bool ignore_showGUID,
+void BinaryFieldType::append_presentation(string &out, const char *rec, bool EmptyNull, wchar_t Delimiter, bool ignore_showGUID,
 										 bool detailed) const
 {
 	auto fr = reinterpret_cast<const uint8_t *>(rec);
@@ -368,51 +538,27 @@ string BinaryFieldType::get_presentation(const char *rec, bool EmptyNull, wchar_
 	case type_fields::tf_binary:
 		if(length == GUID_BINARY_SIZE && (showGUID || ignore_showGUID)) {
 			if(showGUIDasMS) {
-				return GUIDasMS(fr);
+				append_GUIDasMS(out, fr);
 			}
 			else {
-				return GUIDas1C(fr);
+				append_GUIDas1C(out, fr);
 			}
 		}
 		else {
-			return Convert::from_binary(fr, length);
+			Convert::append_binary(out, fr, length);
 		}
-
-		break;
+		return;
 	case type_fields::tf_varbinary:
-		return Convert::from_varbinary(fr, length);
-
-		break;
+		Convert::append_varbinary(out, fr, length);
+		return;
 	}
 
-	return "{?}";
+	out += "{?}";
 }
 
-string BinaryFieldType::get_XML_presentation(const char *rec, const Table *parent, bool ignore_showGUID) const
+void BinaryFieldType::append_XML_presentation(string &out, const char *rec, const Table *parent, bool ignore_showGUID) const
 {
-	auto fr = reinterpret_cast<const uint8_t *>(rec);
-
-	switch(type)
-	{
-	case type_fields::tf_binary:
-		if(length == GUID_BINARY_SIZE && (showGUID || ignore_showGUID)) {
-			if(showGUIDasMS) {
-				return GUIDasMS(fr);
-			}
-			else {
-				return GUIDas1C(fr);
-			}
-		}
-		else {
-			return Convert::from_binary(fr, length);
-		}
-
-		break;
-	case type_fields::tf_varbinary:
-		return Convert::from_varbinary(fr, length);
-	}
-
-	return "{?}";
+	append_presentation(out, rec, false, 0, ignore_showGUID, false);
 }
 
 uint32_t BinaryFieldType::get_sort_key(const char* rec, unsigned char* SortKey, int32_t maxlen) const
@@ -457,15 +603,14 @@ bool NumericFieldType::get_binary_value(char *binary_value, const string &value)
 	return true;
 }
 
-string NumericFieldType::get_presentation(const char* rec, bool EmptyNull, wchar_t Delimiter, bool ignore_showGUID, bool detailed) const
+void NumericFieldType::append_presentation(string &out, const char* rec, bool EmptyNull, wchar_t Delimiter, bool ignore_showGUID, bool detailed) const
 {
-	BinaryDecimalNumber bdn(rec, length, precision, true);
-	return bdn.get_presentation();
+	append_decimal_presentation(out, rec, length, precision, true);
 }
 
-string NumericFieldType::get_XML_presentation(const char *rec, const Table *parent, bool ignore_showGUID) const
+void NumericFieldType::append_XML_presentation(string &out, const char *rec, const Table *parent, bool ignore_showGUID) const
 {
-	return get_presentation(rec, false, 0, false, false);
+	append_presentation(out, rec, false, 0, false, false);
 }
 
 uint32_t NumericFieldType::get_sort_key(const char* rec, unsigned char* SortKey, int32_t maxlen) const
@@ -554,38 +699,26 @@ bool DatetimeFieldType::get_binary_value(char* binary_value, const string& value
 	return true;
 }
 
-string DatetimeFieldType::get_presentation(const char* rec, bool EmptyNull, wchar_t Delimiter, bool ignore_showGUID, bool detailed) const
-{
-	return date_to_string(rec);
-}
-
-std::string s02(const std::string &s)
+void DatetimeFieldType::append_presentation(string &out, const char* rec, bool EmptyNull, wchar_t Delimiter, bool ignore_showGUID, bool detailed) const
 {
-	if (s.size() < 2) {
-		string result = "0";
-		return result + s;
-	}
-	return s;
+	append_date_presentation(out, rec);
 }
 
-string DatetimeFieldType::get_XML_presentation(const char *rec, const Table *parent, bool ignore_showGUID) const
+void DatetimeFieldType::append_XML_presentation(string &out, const char *rec, const Table *parent, bool ignore_showGUID) const
 {
-	BinaryDecimalDate bdd(rec);
-	string result;
-	result.append(to_string(bdd.get_year()));
-	result.append("-");
-	result.append(s02(to_string(bdd.get_month())));
-	result.append("-");
-	result.append(s02(to_string(bdd.get_day())));
-	result.append("T");
-
-	result.append(s02(to_string(bdd.get_hour())));
-	result.append(":");
-	result.append(s02(to_string(bdd.get_minute())));
-	result.append(":");
-	result.append(s02(to_string(bdd.get_second())));
-
-	return result;
+	decimal_datetime dt = decode_decimal_date(rec);
+	append_int(out, dt.year);
+	out += '-';
+	Convert::append_two_digits(out, dt.month);
+	out += '-';
+	Convert::append_two_digits(out, dt.day);
+	out += 'T';
+
+	Convert::append_two_digits(out, dt.hour);
+	out += ':';
+	Convert::append_two_digits(out, dt.minute);
+	out += ':';
+	Convert::append_two_digits(out, dt.second);
 }
 
 uint32_t DatetimeFieldType::get_sort_key(const char* rec, unsigned char* SortKey, int32_t maxlen) const
@@ -668,7 +801,7 @@ bool CommonFieldType::get_binary_value(char *binary_value, const string &value)
 	return true;
 }
 
-string CommonFieldType::get_presentation(const char *rec, bool EmptyNull, wchar_t Delimiter, bool ignore_showGUID,
+void CommonFieldType::append_presentation(string &out, const char *rec, bool EmptyNull, wchar_t Delimiter, bool ignore_showGUID,
 										 bool detailed) const
 {
 	auto fr = reinterpret_cast<const uint8_t *>(rec);
@@ -676,11 +809,11 @@ string CommonFieldType::get_presentation(const char *rec, bool EmptyNull, wchar_
 	switch(type)
 	{
 		case type_fields::tf_bool:
-			if(fr[0]) return "true";
-			return "false";
-		case type_fields::tf_char: {
-			return TEncoding::Unicode->toUtf8(vector<uint8_t>(fr, fr + (length * sizeof(WCHART))));
-		}
+			out += fr[0] ? "true" : "false";
+			return;
+		case type_fields::tf_char:
+			System::AppendUtf16AsUtf8(out, fr, length * sizeof(WCHART));
+			return;
 		case type_fields::tf_varchar: {
 			int16_t length = *(int16_t *) fr;
 			fr += sizeof(length);
@@ -688,87 +821,143 @@ string CommonFieldType::get_presentation(const char *rec, bool EmptyNull, wchar_
 			if (full_size > get_size()) {
 				full_size = get_size();
 			}
-			return TEncoding::Unicode->toUtf8(vector<uint8_t>(fr, fr + full_size));
+			System::AppendUtf16AsUtf8(out, fr, full_size);
+			return;
 		}
 		case type_fields::tf_version: {
 			auto retyped = reinterpret_cast<const int32_t *>(fr);
-			return to_string(retyped[0])
-				   + ":" + to_string(retyped[1])
-				   + ":" + to_string(retyped[2])
-				   + ":" + to_string(retyped[3]);
+			for(int i = 0; i < 4; i++) {
+				if(i) {
+					out += ':';
+				}
+				append_int(out, retyped[i]);
+			}
+			return;
 		}
 		case type_fields::tf_version8: {
 			auto retyped = reinterpret_cast<const int32_t*>(fr);
-			return to_string(retyped[0]) + string(":") + to_string(retyped[1]);
+			append_int(out, retyped[0]);
+			out += ':';
+			append_int(out, retyped[1]);
+			return;
 		}
 		case type_fields::tf_string:
-			return detailed ? string("{MEMO} [") + to_hex_string(*(int32_t*)fr)
-							  + string("][") + to_hex_string(*(int32_t*)(fr + 4)) + string("]") : string("{MEMO}");
 		case type_fields::tf_text:
-			return detailed ? string("{TEXT} [") + to_hex_string(*(int32_t*)fr)
-							  + string("][") + to_hex_string(*(int32_t*)(fr + 4)) + string("]") : string("{TEXT}");
 		case type_fields::tf_image:
-			return detailed ? string("{IMAGE} [") + to_hex_string(*(int32_t*)fr)
-							  + string("][") + to_hex_string(*(int32_t*)(fr + 4)) + "]" : string("{IMAGE}");
+			out += type == type_fields::tf_string ? "{MEMO}" : type == type_fields::tf_text ? "{TEXT}" : "{IMAGE}";
+			if(detailed) {
+				auto retyped = reinterpret_cast<const uint32_t*>(fr);
+				out += " [";
+				Convert::append_hex(out, retyped[0]);
+				out += "][";
+				Convert::append_hex(out, retyped[1]);
+				out += ']';
+			}
+			return;
 		case type_fields::tf_varbinary:
-			return Convert::from_varbinary(fr, length);
+			Convert::append_varbinary(out, fr, length);
+			return;
 	}
 
-	return "{?}";
+	out += "{?}";
 }
 
-string CommonFieldType::get_XML_presentation(const char *rec, const Table *parent, bool ignore_showGUID) const
+string FieldType::get_presentation(const char *rec, bool EmptyNull, wchar_t Delimiter, bool ignore_showGUID, bool detailed) const
 {
-	int32_t i;
-
-	TMemoryStream* in;
-	TMemoryStream* out;
+	string result;
+	append_presentation(result, rec, EmptyNull, Delimiter, ignore_showGUID, detailed);
+	return result;
+}
 
-	auto fr = reinterpret_cast<const uint8_t *>(rec);
+string FieldType::get_XML_presentation(const char *rec, const Table *parent, bool ignore_showGUID) const
+{
+	string result;
+	append_XML_presentation(result, rec, parent, ignore_showGUID);
+	return result;
+}
 
+void CommonFieldType::append_XML_presentation(string &out, const char *rec, const Table *parent, bool ignore_showGUID) const
+{
+	size_t start = out.size();
 	switch(type)
 	{
-
 		case type_fields::tf_bool:
-			if(fr[0]) return "true";
-			return "false";
-
+			out += rec[0] ? "true" : "false";
+			return;
 		case type_fields::tf_varchar:
 		case type_fields::tf_char:
 		case type_fields::tf_version:
 		case type_fields::tf_version8:
-			return toXML(get_presentation(rec, true, 0, false, false));
-
+			append_presentation(out, rec, true, 0, false, false);
+			escape_xml_tail(out, start);
+			return;
 		case type_fields::tf_string: {
-			uint32_t *retyped = (uint32_t*)fr;
-			out = new TMemoryStream();
-			parent->readBlob(out, retyped[0], retyped[1]);
-			string s = TEncoding::Unicode->toUtf8(out->GetBytes());
-			delete out;
-			return toXML(s);
+			auto retyped = reinterpret_cast<const uint32_t*>(rec);
+			TMemoryStream blob;
+			parent->readBlob(&blob, retyped[0], retyped[1]);
+			System::AppendUtf16AsUtf8(out, blob.GetMemory(), blob.GetSize());
+			escape_xml_tail(out, start);
+			return;
 		}
 		case type_fields::tf_text: {
-			uint32_t *retyped = (uint32_t*)fr;
-			out = new TMemoryStream();
-			parent->readBlob(out, retyped[0], retyped[1]);
-			string s = toXML(string(static_cast<char*>(out->GetMemory()), 0, out->GetSize()));
-			delete out;
-			return s;
+			auto retyped = reinterpret_cast<const uint32_t*>(rec);
+			TMemoryStream blob;
+			parent->readBlob(&blob, retyped[0], retyped[1]);
+			append_xml_escaped(out, static_cast<const char*>(blob.GetMemory()), blob.GetSize());
+			return;
 		}
 		case type_fields::tf_image: {
-			uint32_t *retyped = (uint32_t*)fr;
-			in = new TMemoryStream();
-			out = new TMemoryStream();
-			parent->readBlob(in, retyped[0], retyped[1]);
-			base64_encode(in, out, 72);
-			string s = TEncoding::Unicode->toUtf8(out->GetBytes());
-			delete in;
-			delete out;
-			return s;
+			auto retyped = reinterpret_cast<const uint32_t*>(rec);
+			TMemoryStream blob;
+			parent->readBlob(&blob, retyped[0], retyped[1]);
+			base64_encode(blob.GetMemory(), blob.GetSize(), out, 72);
+			return;
 		}
 	}
 
-	return "{?}";
+	out += "{?}";
+}
+
+void FieldType::append_text_presentation(string &out, const char *rec, const Table *parent) const
+{
+	append_XML_presentation(out, rec, parent, false);
+}
+
+void CommonFieldType::append_text_presentation(string &out, const char *rec, const Table *parent) const
+{
+	switch(type)
+	{
+		case type_fields::tf_varchar:
+		case type_fields::tf_char:
+		case type_fields::tf_version:
+		case type_fields::tf_version8:
+			append_presentation(out, rec, true, 0, false, false);
+			return;
+		case type_fields::tf_string: {
+			auto retyped = reinterpret_cast<const uint32_t*>(rec);
+			TMemoryStream blob;
+			parent->readBlob(&blob, retyped[0], retyped[1]);
+			System::AppendUtf16AsUtf8(out, blob.GetMemory(), blob.GetSize());
+			return;
+		}
+		case type_fields::tf_text: {
+			auto retyped = reinterpret_cast<const uint32_t*>(rec);
+			TMemoryStream blob;
+			parent->readBlob(&blob, retyped[0], retyped[1]);
+			out.append(static_cast<const char*>(blob.GetMemory()), blob.GetSize());
+			return;
+		}
+		case type_fields::tf_image: {
+			// base64 одной строкой
+			auto retyped = reinterpret_cast<const uint32_t*>(rec);
+			TMemoryStream blob;
+			parent->readBlob(&blob, retyped[0], retyped[1]);
+			base64_encode(blob.GetMemory(), blob.GetSize(), out, 0);
+			return;
+		}
+		default:
+			append_XML_presentation(out, rec, parent, false);
+	}
 }
 
 uint32_t CommonFieldType::get_sort_key(const char* rec, unsigned char* SortKey, int32_t maxlen) const
@@ -807,16 +996,72 @@ uint32_t CommonFieldType::get_sort_key(const char* rec, unsigned char* SortKey,
 			.add_detail("Значение поля", get_fast_presentation(rec));
 }
 
-string GuidFieldType::get_presentation(const char *rec, bool EmptyNull, wchar_t Delimiter, bool ignore_showGUID,
+void GuidFieldType::append_presentation(string &out, const char *rec, bool EmptyNull, wchar_t Delimiter, bool ignore_showGUID,
 										 bool detailed) const
 {
-	BinaryGuid guid(rec);
-	return guid.as_1C();
+	append_GUIDas1C(out, reinterpret_cast<const unsigned char *>(rec));
+}
+
+void GuidFieldType::append_XML_presentation(string &out, const char *rec, const Table *parent, bool ignore_showGUID) const
+{
+	append_presentation(out, rec, false, 0, true, false);
+}
+
+field_decoder_kernel FieldType::get_decoder_kernel(decode_format format) const
+{
+	return format == decode_format::xml ? &Decoders::generic_xml : &Decoders::generic_text;
+}
+
+field_decoder_kernel CommonFieldType::get_decoder_kernel(decode_format format) const
+{
+	switch(type)
+	{
+		case type_fields::tf_bool:
+			return Decoders::kernel<type_fields::tf_bool>(format);
+		case type_fields::tf_char:
+			return Decoders::kernel<type_fields::tf_char>(format);
+		case type_fields::tf_varchar:
+			return Decoders::kernel<type_fields::tf_varchar>(format);
+		case type_fields::tf_version:
+			return Decoders::kernel<type_fields::tf_version>(format);
+		case type_fields::tf_version8:
+			return Decoders::kernel<type_fields::tf_version8>(format);
+		default:
+			break;
+	}
+	return FieldType::get_decoder_kernel(format);
+}
+
+field_decoder_kernel BinaryFieldType::get_decoder_kernel(decode_format format) const
+{
+	switch(type)
+	{
+		case type_fields::tf_binary:
+			if(length == GUID_BINARY_SIZE && showGUID) {
+				return showGUIDasMS ? &Decoders::guid_MS : &Decoders::guid_1C;
+			}
+			return Decoders::kernel<type_fields::tf_binary>(format);
+		case type_fields::tf_varbinary:
+			return Decoders::kernel<type_fields::tf_varbinary>(format);
+		default:
+			break;
+	}
+	return FieldType::get_decoder_kernel(format);
+}
+
+field_decoder_kernel NumericFieldType::get_decoder_kernel(decode_format format) const
+{
+	return Decoders::kernel<type_fields::tf_numeric>(format);
+}
+
+field_decoder_kernel DatetimeFieldType::get_decoder_kernel(decode_format format) const
+{
+	return Decoders::kernel<type_fields::tf_datetime>(format);
 }
 
-string GuidFieldType::get_XML_presentation(const char *rec, const Table *parent, bool ignore_showGUID) const
+field_decoder_kernel GuidFieldType::get_decoder_kernel(decode_format) const
 {
-	return get_presentation(rec, false, 0, true, false);
+	return &Decoders::guid_1C;
 }
 
 
@@ -26,6 +26,16 @@
 #include "Parse_tree.h"
 
 class Table;
+struct field_decoder_step;
+
+// представление значений, формируемое RecordDecoder
+enum class decode_format {
+	xml, // как append_XML_presentation
+	text // как append_text_presentation
+};
+
+// ядро декодирования значения поля; rec указывает на значение (после признака NULL)
+typedef void (*field_decoder_kernel)(std::string &out, const char *rec, const field_decoder_step &step);
 
 struct field_type_declaration {
 	type_fields type {type_fields::tf_binary};
@@ -47,7 +57,16 @@ public:
 	virtual bool get_case_sensitive() const = 0;
 	virtual std::string get_presentation_type() const = 0;
 
-	virtual std::string get_presentation(
+	std::string get_presentation(
+			const char *rec,
+			bool EmptyNull,
+			wchar_t Delimiter,
+			bool ignore_showGUID,
+			bool detailed) const;
+
+	// дописывает представление в конец out, без промежуточных строк
+	virtual void append_presentation(
+			std::string &out,
 			const char *rec,
 			bool EmptyNull,
 			wchar_t Delimiter,
@@ -56,16 +75,32 @@ public:
 
 	virtual bool get_binary_value(char *buf, const std::string &value) const = 0;
 
-	virtual std::string get_XML_presentation(
+	std::string get_XML_presentation(
+			const char *rec,
+			const Table *parent,
+			bool ignore_showGUID) const;
+
+	// дописывает XML-представление в конец out, без промежуточных строк
+	virtual void append_XML_presentation(
+			std::string &out,
 			const char *rec,
 			const Table *parent,
 			bool ignore_showGUID) const = 0;
 
+	// дописывает текстовое значение без экранирования в конец out (для выгрузки в CSV, TSV, JSON)
+	virtual void append_text_presentation(
+			std::string &out,
+			const char *rec,
+			const Table *parent) const;
+
 	virtual uint32_t get_sort_key(
 			const char* rec,
 			unsigned char* SortKey,
 			int32_t maxlen) const = 0;
 
+	// ядро, специализированное под тип поля. По умолчанию - вызов append_XML_presentation/append_text_presentation
+	virtual field_decoder_kernel get_decoder_kernel(decode_format format) const;
+
 
 	static FieldType *create_type_manager(
 			const field_type_declaration &type_declaration,
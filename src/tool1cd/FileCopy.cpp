@@ -0,0 +1,153 @@
+/*
+    Tool1CD library provides access to 1CD database files.
+    Copyright © 2009-2017 awa
+    Copyright © 2017-2018 E8 Tools contributors
+
+    This file is part of Tool1CD Library.
+
+    Tool1CD Library is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Tool1CD Library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with Tool1CD Library.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "FileCopy.h"
+#include "DetailedException.h"
+
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#endif
+#ifdef __linux__
+#include <sys/syscall.h>
+#endif
+
+using namespace std;
+
+#if !defined(_WIN32)
+
+namespace {
+
+const size_t FILE_COPY_BUFFER_SIZE = 0x100000; // буфер копирования через pread/pwrite (1 МБ)
+
+// Дескриптор файла, закрываемый при выходе из области видимости
+class FileDescriptor
+{
+public:
+	explicit FileDescriptor(int fd) : fd(fd) {}
+	~FileDescriptor() { if(fd >= 0) ::close(fd); }
+
+	FileDescriptor(const FileDescriptor &) = delete;
+	FileDescriptor &operator=(const FileDescriptor &) = delete;
+
+	int get() const { return fd; }
+	int release() { int result = fd; fd = -1; return result; }
+
+private:
+	int fd;
+};
+
+//---------------------------------------------------------------------------
+// Копирует участок через буфер. Используется, если copy_file_range недоступен
+void copy_extent_buffered(int in, uint64_t in_offset, int out, uint64_t out_offset, uint64_t length, vector<char> &buf)
+{
+	if(buf.empty()) buf.resize(FILE_COPY_BUFFER_SIZE);
+	while(length)
+	{
+		size_t part = std::min<uint64_t>(length, buf.size());
+		ssize_t have = ::pread(in, buf.data(), part, in_offset);
+		if(have < 0 && errno == EINTR) continue;
+		if(have <= 0)
+		{
+			throw DetailedException("Ошибка чтения файла базы при копировании")
+				.add_detail("Смещение", to_string(in_offset))
+				.add_detail("Ошибка", have < 0 ? string(strerror(errno)) : string("Неожиданный конец файла"));
+		}
+		for(ssize_t done = 0; done < have; )
+		{
+			ssize_t written = ::pwrite(out, buf.data() + done, have - done, out_offset + done);
+			if(written < 0 && errno == EINTR) continue;
+			if(written <= 0)
+			{
+				throw DetailedException("Ошибка записи файла при копировании")
+					.add_detail("Ошибка", string(strerror(errno)));
+			}
+			done += written;
+		}
+		in_offset += have;
+		out_offset += have;
+		length -= have;
+	}
+}
+
+} // namespace
+
+#endif
+
+//---------------------------------------------------------------------------
+bool copy_file_extents(const boost::filesystem::path &source, const vector<file_extent> &extents,
+					   const boost::filesystem::path &dest)
+{
+#if defined(_WIN32)
+	return false;
+#else
+	FileDescriptor in(::open(source.c_str(), O_RDONLY));
+	if(in.get() < 0) return false;
+	FileDescriptor out(::open(dest.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0666));
+	if(out.get() < 0) return false;
+
+	// copy_file_range есть только в Linux и вызывается через syscall, чтобы не зависеть от версии libc;
+	// в остальных системах участки копируются через pread/pwrite
+#if defined(__linux__) && defined(SYS_copy_file_range)
+	bool kernel_copy = true;
+#endif
+	vector<char> buf;
+	uint64_t out_offset = 0;
+	for(auto &extent : extents)
+	{
+		int64_t in_pos = extent.offset;
+		int64_t out_pos = out_offset;
+		uint64_t rest = extent.length;
+#if defined(__linux__) && defined(SYS_copy_file_range)
+		while(rest && kernel_copy)
+		{
+			ssize_t copied = ::syscall(SYS_copy_file_range, in.get(), &in_pos, out.get(), &out_pos, rest, 0);
+			if(copied > 0)
+			{
+				rest -= copied;
+				continue;
+			}
+			if(copied < 0 && errno == EINTR) continue;
+			if(copied < 0 && errno != ENOSYS && errno != EXDEV && errno != EINVAL && errno != EOPNOTSUPP)
+			{
+				throw DetailedException("Ошибка копирования файла")
+					.add_detail("Файл", dest.string())
+					.add_detail("Ошибка", string(strerror(errno)));
+			}
+			// ядро или файловая система не поддерживают копирование, либо файл базы короче ожидаемого
+			kernel_copy = false;
+		}
+#endif
+		if(rest) copy_extent_buffered(in.get(), in_pos, out.get(), out_pos, rest, buf);
+		out_offset += extent.length;
+	}
+
+	if(::close(out.release()) != 0)
+	{
+		throw DetailedException("Ошибка записи файла при копировании")
+			.add_detail("Файл", dest.string())
+			.add_detail("Ошибка", string(strerror(errno)));
+	}
+	return true;
+#endif
+}
@@ -0,0 +1,43 @@
+/*
+    Tool1CD library provides access to 1CD database files.
+    Copyright © 2009-2017 awa
+    Copyright © 2017-2018 E8 Tools contributors
+
+    This file is part of Tool1CD Library.
+
+    Tool1CD Library is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Tool1CD Library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with Tool1CD Library.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef TOOL1CD_PROJECT_FILECOPY_H
+#define TOOL1CD_PROJECT_FILECOPY_H
+
+#include <vector>
+#include <boost/filesystem.hpp>
+
+// Непрерывный участок файла
+struct file_extent
+{
+	uint64_t offset;
+	uint64_t length;
+};
+
+// Записывает в файл dest подряд участки extents файла source.
+// Данные копируются средствами ядра (copy_file_range, только в Linux), если ядро или файловая система этого не умеют -
+// через pread/pwrite, без разбора страниц в памяти процесса.
+// Возвращает false, если копирование средствами ОС недоступно (Windows) или файлы не удалось открыть,
+// в этом случае вызывающий выполняет копирование обычным способом
+bool copy_file_extents(const boost::filesystem::path &source, const std::vector<file_extent> &extents,
+					   const boost::filesystem::path &dest);
+
+#endif //TOOL1CD_PROJECT_FILECOPY_H
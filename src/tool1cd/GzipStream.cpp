@@ -0,0 +1,357 @@
+/*
+    Tool1CD library provides access to 1CD database files.
+    Copyright © 2009-2017 awa
+    Copyright © 2017-2018 E8 Tools contributors
+
+    This file is part of Tool1CD Library.
+
+    Tool1CD Library is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Tool1CD Library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with Tool1CD Library.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <algorithm>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#include "GzipStream.h"
+#include "UZLib.h"
+#include "TempStream.h"
+#include "SystemClasses/String.hpp"
+
+using namespace std;
+using namespace System;
+
+uint32_t GzipStream::default_threads = std::max(1u, std::thread::hardware_concurrency());
+
+//---------------------------------------------------------------------------
+// Общий пул потоков сжатия. Запускается при первой отправке блока, останавливается при завершении программы
+struct GzipStream::Pool
+{
+	mutex lock;
+	condition_variable cond;
+	deque<shared_ptr<Block>> pending; // блоки, ожидающие сжатия
+	vector<thread> workers;
+	bool stopping {false};
+
+	~Pool()
+	{
+		{
+			lock_guard<mutex> guard(lock);
+			stopping = true;
+		}
+		cond.notify_all();
+		for(auto &w : workers) w.join();
+	}
+
+	// вызывается под lock
+	void start()
+	{
+		if(!workers.empty()) return;
+		for(uint32_t t = 0; t < default_threads; t++) workers.emplace_back(&Pool::worker, this);
+	}
+
+	void worker()
+	{
+		while(true)
+		{
+			shared_ptr<Block> block;
+			{
+				unique_lock<mutex> guard(lock);
+				cond.wait(guard, [&]() { return stopping || !pending.empty(); });
+				if(pending.empty()) return;
+				block = pending.front();
+				pending.pop_front();
+				if(block->cancelled) continue;
+			}
+
+			exception_ptr error;
+			try
+			{
+				compress_block(*block);
+			}
+			catch(...)
+			{
+				error = current_exception();
+			}
+
+			{
+				lock_guard<mutex> guard(lock);
+				block->error = error;
+				block->ready = true;
+			}
+			cond.notify_all();
+		}
+	}
+};
+
+//---------------------------------------------------------------------------
+GzipStream::Pool &GzipStream::pool()
+{
+	static Pool instance;
+	return instance;
+}
+
+//---------------------------------------------------------------------------
+GzipStream::GzipStream(const boost::filesystem::path &file_name, int level, uint32_t threads)
+	: file(new TFileStream(file_name, fmCreate)), level(level), parallel(threads != 1 && default_threads > 1)
+{
+	// заголовок gzip: deflate, без имени файла и времени, ОС - unix
+	const char header[10] = {'\x1f', '\x8b', 8, 0, 0, 0, 0, 0, 0, 3};
+	file->Write(header, sizeof(header));
+	input.reserve(GZIP_BLOCK_SIZE);
+}
+
+//---------------------------------------------------------------------------
+GzipStream::~GzipStream()
+{
+	try
+	{
+		Close();
+	}
+	catch(...)
+	{
+	}
+	cancel_blocks();
+}
+
+//---------------------------------------------------------------------------
+void GzipStream::set_default_threads(uint32_t threads)
+{
+	default_threads = std::max(1u, threads);
+}
+
+//---------------------------------------------------------------------------
+uint32_t GzipStream::get_default_threads()
+{
+	return default_threads;
+}
+
+//---------------------------------------------------------------------------
+int64_t GzipStream::Read(void *, int64_t)
+{
+	throw DetailedException("Чтение из потока сжатия gzip не поддерживается");
+}
+
+//---------------------------------------------------------------------------
+int64_t GzipStream::Write(const void *Buffer, int64_t Count)
+{
+	if(closed) throw DetailedException("Запись в закрытый поток сжатия gzip");
+
+	const char *data = static_cast<const char*>(Buffer);
+	int64_t rest = Count;
+	while(rest > 0)
+	{
+		size_t part = std::min<uint64_t>(rest, GZIP_BLOCK_SIZE - input.size());
+		input.append(data, part);
+		data += part;
+		rest -= part;
+		if(input.size() == GZIP_BLOCK_SIZE) submit(false);
+	}
+	m_position += Count;
+	m_size = m_position;
+	return Count;
+}
+
+//---------------------------------------------------------------------------
+void GzipStream::Close()
+{
+	if(closed) return;
+	closed = true;
+
+	submit(true);
+	write_blocks(true);
+
+	char trailer[8];
+	for(int i = 0; i < 4; i++)
+	{
+		trailer[i] = static_cast<char>(crc >> (i * 8));
+		trailer[i + 4] = static_cast<char>(total_size >> (i * 8));
+	}
+	file->Write(trailer, sizeof(trailer));
+	file.reset();
+}
+
+//---------------------------------------------------------------------------
+void GzipStream::submit(bool last)
+{
+	shared_ptr<Block> block(new Block);
+	block->input.swap(input);
+	block->dictionary = dictionary;
+	block->level = level;
+	block->last = last;
+
+	// словарь следующего блока - последние GZIP_DICTIONARY_SIZE байт данных
+	if(block->input.size() >= GZIP_DICTIONARY_SIZE)
+	{
+		dictionary.assign(block->input, block->input.size() - GZIP_DICTIONARY_SIZE, GZIP_DICTIONARY_SIZE);
+	}
+	else
+	{
+		dictionary += block->input;
+		if(dictionary.size() > GZIP_DICTIONARY_SIZE) dictionary.erase(0, dictionary.size() - GZIP_DICTIONARY_SIZE);
+	}
+	input.reserve(GZIP_BLOCK_SIZE);
+
+	if(!parallel)
+	{
+		compress_block(*block);
+		write_block(*block);
+		return;
+	}
+
+	Pool &p = pool();
+	{
+		lock_guard<mutex> guard(p.lock);
+		p.start();
+		p.pending.push_back(block);
+	}
+	p.cond.notify_all();
+	order.push_back(block);
+
+	write_blocks(false);
+}
+
+//---------------------------------------------------------------------------
+// Записывает готовые блоки по порядку. Ждет, пока в очереди не останется больше default_threads * 4 блоков,
+// а при wait_all - пока не будут записаны все блоки
+void GzipStream::write_blocks(bool wait_all)
+{
+	Pool &p = pool();
+	while(!order.empty())
+	{
+		shared_ptr<Block> block = order.front();
+		{
+			unique_lock<mutex> guard(p.lock);
+			bool must_wait = wait_all || order.size() > default_threads * 4;
+			if(must_wait) p.cond.wait(guard, [&]() { return block->ready; });
+			if(!block->ready) return;
+		}
+		order.pop_front();
+		if(block->error) rethrow_exception(block->error);
+		write_block(*block);
+	}
+}
+
+//---------------------------------------------------------------------------
+void GzipStream::write_block(const Block &block)
+{
+	file->Write(block.output.data(), block.output.size());
+	crc = crc32_combine(crc, block.crc, block.input.size());
+	total_size += block.input.size();
+}
+
+//---------------------------------------------------------------------------
+// Отменяет сжатие незаписанных блоков (при ошибке записи или сжатия)
+void GzipStream::cancel_blocks()
+{
+	if(order.empty()) return;
+	Pool &p = pool();
+	lock_guard<mutex> guard(p.lock);
+	for(auto &block : order) block->cancelled = true;
+	order.clear();
+}
+
+//---------------------------------------------------------------------------
+void GzipStream::compress_block(Block &block)
+{
+	z_stream strm = {};
+	if(deflateInit2(&strm, block.level, Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+	{
+		throw ZError("Ошибка инициализации сжатия gzip");
+	}
+	if(!block.dictionary.empty())
+	{
+		deflateSetDictionary(&strm, reinterpret_cast<const Bytef*>(block.dictionary.data()), block.dictionary.size());
+	}
+
+	strm.next_in = reinterpret_cast<Bytef*>(&block.input[0]);
+	strm.avail_in = block.input.size();
+	int flush = block.last ? Z_FINISH : Z_SYNC_FLUSH;
+	size_t have = 0;
+	block.output.resize(deflateBound(&strm, block.input.size()) + 16);
+	while(true)
+	{
+		strm.next_out = reinterpret_cast<Bytef*>(&block.output[have]);
+		strm.avail_out = block.output.size() - have;
+		int ret = deflate(&strm, flush);
+		have = block.output.size() - strm.avail_out;
+		if(ret == Z_STREAM_ERROR)
+		{
+			deflateEnd(&strm);
+			throw ZError("Ошибка сжатия gzip");
+		}
+		if(block.last ? ret == Z_STREAM_END : strm.avail_out != 0) break;
+		block.output.resize(block.output.size() * 2);
+	}
+	deflateEnd(&strm);
+	block.output.resize(have);
+
+	block.crc = crc32(0, reinterpret_cast<const Bytef*>(block.input.data()), block.input.size());
+}
+
+//---------------------------------------------------------------------------
+std::unique_ptr<TStream> create_export_stream(const boost::filesystem::path &file_name)
+{
+	if(EqualIC(file_name.extension().string(), ".gz")) return unique_ptr<TStream>(new GzipStream(file_name));
+	return unique_ptr<TStream>(new TFileStream(file_name, fmCreate));
+}
+
+//---------------------------------------------------------------------------
+std::unique_ptr<TStream> open_import_stream(const boost::filesystem::path &file_name)
+{
+	boost::filesystem::path gz_name(file_name.string() + ".gz");
+	if(boost::filesystem::exists(file_name) || !boost::filesystem::exists(gz_name))
+	{
+		return unique_ptr<TStream>(new TFileStream(file_name, fmOpenRead));
+	}
+
+	TFileStream src(gz_name, fmOpenRead);
+	unique_ptr<TStream> dst(new TTempStream);
+
+	z_stream strm = {};
+	if(inflateInit2(&strm, 16 + MAX_WBITS) != Z_OK) throw ZError("Ошибка инициализации распаковки gzip");
+
+	vector<char> in(GZIP_BLOCK_SIZE);
+	vector<char> out(GZIP_BLOCK_SIZE);
+	int ret = Z_OK;
+	while(ret != Z_STREAM_END)
+	{
+		strm.avail_in = src.Read(in.data(), in.size());
+		if(strm.avail_in == 0) break;
+		strm.next_in = reinterpret_cast<Bytef*>(in.data());
+		do
+		{
+			strm.next_out = reinterpret_cast<Bytef*>(out.data());
+			strm.avail_out = out.size();
+			ret = inflate(&strm, Z_NO_FLUSH);
+			if(ret != Z_OK && ret != Z_STREAM_END && ret != Z_BUF_ERROR)
+			{
+				inflateEnd(&strm);
+				throw ZError("Ошибка распаковки gzip")
+					.add_detail("Файл", gz_name.string());
+			}
+			dst->Write(out.data(), out.size() - strm.avail_out);
+		} while(strm.avail_out == 0 && ret != Z_STREAM_END);
+	}
+	inflateEnd(&strm);
+	if(ret != Z_STREAM_END)
+	{
+		throw ZError("Неожиданный конец файла gzip")
+			.add_detail("Файл", gz_name.string());
+	}
+
+	dst->Seek(0, soBeginning);
+	return dst;
+}
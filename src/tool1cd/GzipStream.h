@@ -0,0 +1,104 @@
+/*
+    Tool1CD library provides access to 1CD database files.
+    Copyright © 2009-2017 awa
+    Copyright © 2017-2018 E8 Tools contributors
+
+    This file is part of Tool1CD Library.
+
+    Tool1CD Library is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Tool1CD Library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with Tool1CD Library.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef TOOL1CD_PROJECT_GZIPSTREAM_H
+#define TOOL1CD_PROJECT_GZIPSTREAM_H
+
+#include <string>
+#include <deque>
+#include <memory>
+#include <exception>
+#include <boost/filesystem.hpp>
+
+#include "SystemClasses/TFileStream.hpp"
+
+const size_t GZIP_BLOCK_SIZE = 0x20000; // размер блока, сжимаемого одним потоком (128 КБ)
+const size_t GZIP_DICTIONARY_SIZE = 0x8000; // окно deflate, передаваемое следующему блоку как словарь
+
+// Запись файла gzip со сжатием блоков в пуле потоков (как в pigz).
+// Каждый блок сжимается независимо со словарем из конца предыдущего блока и завершается Z_SYNC_FLUSH,
+// поэтому сжатые блоки, записанные подряд, образуют один обычный поток gzip.
+// Пул потоков сжатия общий для всех потоков GzipStream, поэтому одновременная выгрузка нескольких таблиц
+// не умножает число потоков сжатия.
+// Поток только для записи; Close дописывает последний блок и завершение gzip, деструктор вызывает Close
+class GzipStream : public TStream
+{
+public:
+	// threads == 1 - сжатие в вызывающем потоке, иначе - в общем пуле потоков
+	explicit GzipStream(const boost::filesystem::path &file_name, int level = -1, uint32_t threads = 0);
+	virtual ~GzipStream();
+
+	GzipStream(const GzipStream &) = delete;
+	GzipStream &operator=(const GzipStream &) = delete;
+
+	virtual int64_t Read(void *, int64_t) override;
+	virtual int64_t Write(const void *Buffer, int64_t Count) override;
+	virtual void Close() override;
+
+	// размер общего пула потоков сжатия; действует, если пул еще не запущен
+	static void set_default_threads(uint32_t threads);
+	static uint32_t get_default_threads();
+
+private:
+	struct Block
+	{
+		std::string input;
+		std::string dictionary;
+		std::string output;
+		int level {-1};
+		uint32_t crc {0};
+		bool last {false};
+		bool ready {false};
+		bool cancelled {false};
+		std::exception_ptr error;
+	};
+	struct Pool;
+
+	std::unique_ptr<TFileStream> file;
+	int level;
+	bool parallel;
+	bool closed {false};
+
+	std::string input; // накапливаемый блок
+	std::string dictionary; // конец последнего отправленного на сжатие блока
+	uint32_t crc {0};
+	uint64_t total_size {0};
+
+	std::deque<std::shared_ptr<Block>> order; // блоки, ожидающие записи, в порядке следования
+
+	static uint32_t default_threads;
+
+	static Pool &pool();
+
+	void submit(bool last);
+	void write_blocks(bool wait_all);
+	void write_block(const Block &block);
+	void cancel_blocks();
+	static void compress_block(Block &block);
+};
+
+// Открывает файл выгрузки для записи. Если имя оканчивается на .gz, данные сжимаются в gzip (GzipStream)
+std::unique_ptr<TStream> create_export_stream(const boost::filesystem::path &file_name);
+
+// Открывает файл для чтения. Если файла нет, но есть <файл>.gz, возвращает временный поток с распакованными данными
+std::unique_ptr<TStream> open_import_stream(const boost::filesystem::path &file_name);
+
+#endif //TOOL1CD_PROJECT_GZIPSTREAM_H
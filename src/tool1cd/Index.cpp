@@ -21,6 +21,7 @@
 
 #include "Index.h"
 #include <limits>
+#include <algorithm>
 #include "TableRecord.h"
 #include "DetailedException.h"
 
@@ -515,12 +516,12 @@ bool Index::pack_leafpage(char* unpack_index, uint32_t number_indexes, char* pag
 
 		if(i)
 		{
-			for(j = 0; cur[j] == cur[j - step] && j < length; j++);
+			for(j = 0; j < length && cur[j] == (cur - step)[j]; j++);
 			left = j;
 		}
 		else left = 0;
 
-		for(j = 1; cur[length - j] == 0 && j <= length; j++);
+		for(j = 1; j <= length && cur[length - j] == 0; j++);
 		right = j - 1;
 
 
@@ -611,7 +612,7 @@ void Index::calcRecordIndex(const TableRecord *rec, char *indexBuf)
 {
 	int32_t index_buf_size = length;
 	for( const auto& record : records) {
-		uint32_t k = record.field->get_sort_key(rec->get_raw(record.field), (unsigned char *)indexBuf, index_buf_size);
+		uint32_t k = record.field->get_sort_key(rec->get_record_data(), (unsigned char *)indexBuf, index_buf_size);
 		indexBuf += k;
 		index_buf_size -= k;
 	}
@@ -1058,7 +1059,7 @@ void Index::write_index_record(const uint32_t phys_numrecord, const char* index_
 			else if(_result == 2)
 			{
 			    char* page2 = new char[pagesize];
-			    unpack_indexes_buf = new char[delta * number_indexes];
+			    unpack_indexes_buf = new char[delta * (number_indexes + 1)];
 
 				number_indexes++;
 				if(number_indexes > max_num_indexes)
@@ -1069,7 +1070,7 @@ void Index::write_index_record(const uint32_t phys_numrecord, const char* index_
 					tbase->get_file_index()->get_data(&k, 0, 4);
 					if(k)
 					{
-						new_last_block2 = k << 12;
+						new_last_block2 = k * pagesize;
 						tbase->get_file_index()->get_data(&k, new_last_block2, 4);
 						tbase->get_file_index()->set_data(&k, 0, 4);
 					}
@@ -1127,7 +1128,7 @@ void Index::write_index_record(const uint32_t phys_numrecord, const char* index_
 					cur_index += length;
 					new_last_phys_num = reverse_byte_order(*(uint32_t*)cur_index);
 					cur_index = unpack_indexes_buf + (number_indexes - 1) * delta;
-					memcpy(new_last_index_buf2, cur_index + 4, length);
+					memcpy(new_last_index_buf2, cur_index, length);
 					cur_index += length;
 					new_last_phys_num2 = reverse_byte_order(*(uint32_t*)cur_index);
 
@@ -1136,13 +1137,14 @@ void Index::write_index_record(const uint32_t phys_numrecord, const char* index_
 				}
 				else
 				{
+					bph->number_indexes = number_indexes;
 
 					k = (number_indexes - i - 2) * delta;
 					if(k)
 					{
 						cur_index = page + 12 + ((i + 1) * delta);
 						cur_index2 = page + 12 + ((i + 2) * delta);
-						memcpy(cur_index, cur_index2, k);
+						memmove(cur_index2, cur_index, k);
 					}
 
 					cur_index = page + 12 + (i * delta);
@@ -1180,6 +1182,294 @@ void Index::write_index_record(const uint32_t phys_numrecord, const char* index_
 
 }
 
+//---------------------------------------------------------------------------
+bool Index::find_key(const char* index_buf)
+{
+	if(!start) return false;
+	get_rootblock();
+
+	std::vector<char> page(pagesize);
+	BranchPageHeader* bph = (BranchPageHeader*)page.data();
+	uint64_t block = rootblock;
+	while(true)
+	{
+		tbase->get_file_index()->get_data(page.data(), block, pagesize);
+		if(bph->flags & indexpage_is_leaf)
+		{
+			uint32_t number_indexes;
+			char* unpacked = unpack_leafpage(page.data(), number_indexes);
+			bool found = false;
+			for(uint32_t i = 0; i < number_indexes; i++)
+			{
+				int32_t j = memcmp(index_buf, unpacked + i * (length + 4) + 4, length);
+				if(j <= 0)
+				{
+					found = j == 0;
+					break;
+				}
+			}
+			delete[] unpacked;
+			return found;
+		}
+
+		// спускаемся в первую страницу, последний индекс которой не меньше искомого
+		const char* cur_index = page.data() + BranchPageHeader::Size();
+		uint32_t delta = length + 8;
+		uint32_t i;
+		for(i = 0; i < bph->number_indexes; i++, cur_index += delta)
+		{
+			if(memcmp(index_buf, cur_index, length) <= 0) break;
+		}
+		if(i == bph->number_indexes) return false;
+		block = reverse_byte_order(*(uint32_t*)(cur_index + length + 4));
+		if(version >= db_ver::ver8_3_8_0) block *= pagesize;
+	}
+}
+
+//---------------------------------------------------------------------------
+void Index::write_index_batch(const std::vector<char> &entries, bool rebuild)
+{
+	if(!start || entries.empty()) return;
+	get_rootblock();
+
+	uint32_t step = length + 4;
+	uint32_t count = entries.size() / step;
+	uint32_t len = length;
+	const char* e = entries.data();
+
+	std::vector<uint32_t> order(count);
+	for(uint32_t i = 0; i < count; i++) order[i] = i;
+	std::sort(order.begin(), order.end(), [e, step, len](uint32_t a, uint32_t b) {
+		int32_t j = memcmp(e + a * step + 4, e + b * step + 4, len);
+		if(j) return j < 0;
+		return *(const uint32_t*)(e + a * step) < *(const uint32_t*)(e + b * step);
+	});
+
+	std::vector<char> sorted(count * step);
+	for(uint32_t i = 0; i < count; i++) memcpy(sorted.data() + i * step, e + order[i] * step, step);
+
+	if(rebuild) rebuild_index(sorted.data(), count);
+	else for(uint32_t i = 0; i < count; i++)
+	{
+		const char* cur = sorted.data() + i * step;
+		write_index_record(*(const uint32_t*)cur, cur + 4);
+	}
+
+	recordsindex_complete = false;
+}
+
+//---------------------------------------------------------------------------
+void Index::rebuild_index(const char* new_entries, uint32_t new_count)
+{
+	V8Object* file_index = tbase->get_file_index();
+	uint32_t step = length + 4;
+	uint32_t branch_step = length + 8;
+	std::vector<char> page(pagesize);
+	BranchPageHeader* bph = (BranchPageHeader*)page.data();
+	LeafPageHeader* lph = (LeafPageHeader*)page.data();
+
+	auto page_ref = [this](uint64_t block) -> uint32_t {
+		return version < db_ver::ver8_3_8_0 ? block : block / pagesize;
+	};
+	auto page_offset = [this](uint32_t ref) -> uint64_t {
+		return version < db_ver::ver8_3_8_0 ? ref : (uint64_t)ref * pagesize;
+	};
+
+	// собираем страницы старого дерева (по уровням, по цепочкам next_page) и записи его листьев
+	std::vector<uint64_t> old_pages;
+	std::vector<char> old_entries;
+	uint64_t level_block = rootblock;
+	while(true)
+	{
+		uint64_t block = level_block;
+		uint64_t child = 0;
+		bool is_leaf = false;
+		while(true)
+		{
+			file_index->get_data(page.data(), block, pagesize);
+			old_pages.push_back(block);
+			is_leaf = bph->flags & indexpage_is_leaf;
+			if(is_leaf)
+			{
+				uint32_t number_indexes;
+				char* unpacked = unpack_leafpage(page.data(), number_indexes);
+				if(number_indexes) old_entries.insert(old_entries.end(), unpacked, unpacked + number_indexes * step);
+				delete[] unpacked;
+			}
+			else if(block == level_block && bph->number_indexes)
+			{
+				child = page_offset(reverse_byte_order(*(uint32_t*)(page.data() + BranchPageHeader::Size() + length + 4)));
+			}
+			if(bph->next_page == LAST_PAGE) break;
+			block = page_offset(bph->next_page);
+		}
+		if(is_leaf || !child) break;
+		level_block = child;
+	}
+
+	// слияние старых и новых записей
+	uint32_t old_count = old_entries.size() / step;
+	uint32_t count = old_count + new_count;
+	std::vector<char> all(count * step);
+	const char* old_cur = old_entries.data();
+	const char* old_end = old_cur + old_count * step;
+	const char* new_cur = new_entries;
+	const char* new_end = new_entries + new_count * step;
+	for(uint32_t i = 0; i < count; i++)
+	{
+		char* out = all.data() + i * step;
+		if(new_cur == new_end || (old_cur != old_end && memcmp(old_cur + 4, new_cur + 4, length) <= 0))
+		{
+			memcpy(out, old_cur, step);
+			old_cur += step;
+		}
+		else
+		{
+			memcpy(out, new_cur, step);
+			new_cur += step;
+		}
+		if(i && memcmp(out + 4, out - step + 4, length) == 0)
+		{
+			if(primary || *(uint32_t*)out == *(uint32_t*)(out - step))
+			{
+				throw DetailedException("Ошибка записи индекса. Индекс уже существует.")
+					.add_detail("Таблица", tbase->get_name())
+					.add_detail("Индекс", name)
+					.add_detail("Физический номер существующий", *(uint32_t*)(out - step))
+					.add_detail("Физический номер записываемый", *(uint32_t*)out);
+			}
+		}
+	}
+
+	for(auto block : old_pages) set_page_as_free(block);
+
+	// разбиение на страницы-листы: на каждую страницу максимальное количество упаковываемых записей
+	std::vector<uint32_t> leaf_counts;
+	for(uint32_t pos = 0; pos < count || leaf_counts.empty();)
+	{
+		uint32_t rest = count - pos;
+		const char* cur = all.data() + pos * step;
+		uint32_t good = std::min(1u, rest);
+		uint32_t bad = rest + 1;
+		uint32_t probe = 2;
+		while(probe <= rest && pack_leafpage((char*)cur, probe, page.data()))
+		{
+			good = probe;
+			probe *= 2;
+		}
+		if(probe <= rest) bad = probe;
+		while(bad - good > 1)
+		{
+			uint32_t mid = (good + bad) / 2;
+			if(pack_leafpage((char*)cur, mid, page.data())) good = mid;
+			else bad = mid;
+		}
+		leaf_counts.push_back(good);
+		pos += good;
+	}
+
+	uint32_t max_branch = (pagesize - BranchPageHeader::Size()) / branch_step;
+	uint32_t num_pages = leaf_counts.size();
+	for(uint32_t n = leaf_counts.size(); n > 1; n = (n + max_branch - 1) / max_branch) num_pages += (n + max_branch - 1) / max_branch;
+
+	std::vector<uint64_t> blocks = allocate_pages(num_pages);
+
+	// листья
+	uint32_t num_leaves = leaf_counts.size();
+	std::vector<char> level_entries(num_leaves * branch_step);
+	uint32_t pos = 0;
+	for(uint32_t i = 0; i < num_leaves; i++)
+	{
+		memset(page.data(), 0, pagesize);
+		pack_leafpage(all.data() + pos * step, leaf_counts[i], page.data());
+		lph->flags = num_leaves == 1 ? indexpage_is_leaf | indexpage_is_root : indexpage_is_leaf;
+		lph->prev_page = i ? page_ref(blocks[i - 1]) : LAST_PAGE;
+		lph->next_page = i + 1 < num_leaves ? page_ref(blocks[i + 1]) : LAST_PAGE;
+		file_index->set_data(page.data(), blocks[i], pagesize);
+
+		pos += leaf_counts[i];
+		if(leaf_counts[i])
+		{
+			const char* last = all.data() + (pos - 1) * step;
+			char* entry = level_entries.data() + i * branch_step;
+			memcpy(entry, last + 4, length);
+			*(uint32_t*)(entry + length) = reverse_byte_order(*(const uint32_t*)last);
+			*(uint32_t*)(entry + length + 4) = reverse_byte_order(page_ref(blocks[i]));
+		}
+	}
+
+	// ветки
+	uint32_t level_count = num_leaves;
+	uint32_t first = num_leaves;
+	while(level_count > 1)
+	{
+		uint32_t level_pages = (level_count + max_branch - 1) / max_branch;
+		std::vector<char> next_entries(level_pages * branch_step);
+		for(uint32_t i = 0; i < level_pages; i++)
+		{
+			uint32_t from = i * max_branch;
+			uint32_t n = std::min(max_branch, level_count - from);
+			uint64_t block = blocks[first + i];
+
+			memset(page.data(), 0, pagesize);
+			bph->flags = level_pages == 1 ? indexpage_is_root : 0;
+			bph->number_indexes = n;
+			bph->prev_page = i ? page_ref(blocks[first + i - 1]) : LAST_PAGE;
+			bph->next_page = i + 1 < level_pages ? page_ref(blocks[first + i + 1]) : LAST_PAGE;
+			memcpy(page.data() + BranchPageHeader::Size(), level_entries.data() + from * branch_step, n * branch_step);
+			file_index->set_data(page.data(), block, pagesize);
+
+			char* entry = next_entries.data() + i * branch_step;
+			memcpy(entry, level_entries.data() + (from + n - 1) * branch_step, length + 4);
+			*(uint32_t*)(entry + length + 4) = reverse_byte_order(page_ref(block));
+		}
+		first += level_pages;
+		level_count = level_pages;
+		level_entries.swap(next_entries);
+	}
+
+	rootblock = blocks[first - 1];
+	uint32_t root_ref = page_ref(rootblock);
+	file_index->set_data(&root_ref, start, 4);
+}
+
+//---------------------------------------------------------------------------
+std::vector<uint64_t> Index::allocate_pages(uint32_t count)
+{
+	V8Object* file_index = tbase->get_file_index();
+	std::vector<uint64_t> pages;
+	uint32_t k;
+
+	file_index->get_data(&k, 0, 4);
+	for(; count && k; count--)
+	{
+		uint64_t block = (uint64_t)k * pagesize;
+		pages.push_back(block);
+		file_index->get_data(&k, block, 4);
+	}
+	file_index->set_data(&k, 0, 4);
+
+	// недостающие страницы добавляются в конец файла одним изменением длины
+	uint64_t len = file_index->get_len();
+	for(; count; count--, len += pagesize) pages.push_back(len);
+	if(len > file_index->get_len()) file_index->set_len(len);
+
+	std::sort(pages.begin(), pages.end());
+	return pages;
+}
+
+//---------------------------------------------------------------------------
+void Index::set_page_as_free(uint64_t block)
+{
+	V8Object* file_index = tbase->get_file_index();
+	uint32_t k;
+
+	file_index->get_data(&k, 0, 4);
+	file_index->set_data(&k, block, 4);
+	k = block / pagesize;
+	file_index->set_data(&k, 0, 4);
+}
+
 class IndexReadError : public DetailedException
 {
 public:
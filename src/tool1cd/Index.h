@@ -133,6 +133,12 @@ public:
 	void write_index(const uint32_t phys_numrecord, const TableRecord *rec); // запись индекса записи
 	void delete_index(const TableRecord *rec, const uint32_t phys_numrec); // удаление индекса записи из файла index
 
+	// пакетная запись индексов. entries - распакованные записи (номер записи + значение индекса) в любом порядке.
+	// rebuild - перестроить дерево индекса целиком, иначе записи добавляются по одной в порядке возрастания
+	void write_index_batch(const std::vector<char> &entries, bool rebuild);
+
+	bool find_key(const char* index_buf); // поиск значения индекса в файле index
+
 private:
 	Table* tbase;
 	db_ver version; // версия базы
@@ -159,6 +165,9 @@ private:
 	void delete_index_record(const char* index_buf, const uint32_t phys_numrec, uint64_t block, bool& is_last_record, bool& page_is_empty, char* new_last_index_buf, uint32_t& new_last_phys_num); // рекурсивное удаление одного индекса из блока файла index
 	void write_index_record(const uint32_t phys_numrecord, const char* index_buf); // запись индекса
 	void write_index_record(const uint32_t phys_numrecord, const char* index_buf, uint64_t block, int32_t& result, char* new_last_index_buf, uint32_t& new_last_phys_num, char* new_last_index_buf2, uint32_t& new_last_phys_num2, uint64_t& new_last_block2); // рекурсивная запись индекса
+	void rebuild_index(const char* new_entries, uint32_t new_count); // перестроение дерева индекса с добавлением отсортированных записей
+	std::vector<uint64_t> allocate_pages(uint32_t count); // выделение страниц файла index (сначала из списка свободных)
+	void set_page_as_free(uint64_t block); // добавление страницы в список свободных страниц файла index
 
 };
 
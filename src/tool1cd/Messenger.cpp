@@ -37,7 +37,10 @@ Messenger::Messenger()
 //---------------------------------------------------------------------------
 void Messenger::Status(const string &message)
 {
-	cout << message << endl;
+	{
+		std::lock_guard<std::mutex> lock(output_lock);
+		cout << message << endl;
+	}
 	AddMessage(message, MessageState::Empty);
 }
 
@@ -48,6 +51,7 @@ void Messenger::AddDetailedMessage(const string &message, const MessageState mst
 		return;
 	}
 
+	std::lock_guard<std::mutex> lock(output_lock);
 	shared_ptr<ostream> output (&cerr, [](...){} );
 
 	if (!logfile.empty()) {
@@ -21,6 +21,8 @@
 #ifndef MESSENGER_H_INCLUDED
 #define MESSENGER_H_INCLUDED
 
+#include <mutex>
+
 #include "MessageRegistration.h"
 
 class Messenger : public MessageRegistrator
@@ -29,6 +31,7 @@ private:
 	std::string logfile;
 	bool noverbose;
 	MessageState minimal_state;
+	std::mutex output_lock; // сообщения могут приходить из нескольких потоков выгрузки
 public:
 	bool has_error;
 	Messenger();
@@ -19,37 +19,108 @@
     along with Tool1CD Library.  If not, see <http://www.gnu.org/licenses/>.
 */
 
-#include <boost/regex.hpp>
+#include <cstring>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
 
 #include "Parse_tree.h"
+#include "BufferedWriter.h"
 #include "Common.h"
 #include "DetailedException.h"
 #include "MessageRegistration.h"
+#include "Simd.h"
 
 using namespace System;
 using namespace std;
 
-const boost::regex exp_number("^-?\\d+$");
-const boost::regex exp_number_exp("^-?\\d+(\\.?\\d*)?((e|E)-?\\d+)?$");
-const boost::regex exp_guid("^[0-9a-fA-F]{8}-[0-9a-fA-F]{4}-[0-9a-fA-F]{4}-[0-9a-fA-F]{4}-[0-9a-fA-F]{12}$");
-const boost::regex exp_binary("^#base64:[0-9a-zA-Z\\+=\\r\\n\\/]*$");
-const boost::regex exp_binary2("^[0-9a-zA-Z\\+=\\r\\n\\/]+$");
-const boost::regex exp_link("^[0-9]+:[0-9a-fA-F]{32}$");
-const boost::regex exp_binary_d("^#data:[0-9a-zA-Z\\+=\\r\\n\\/]*$");
-
 extern Registrator msreg_g;
 
+const size_t TREE_FIRST_CHUNK_NODES = 64;   // узлов в первом блоке арены
+const size_t TREE_MAX_CHUNK_NODES = 8192;   // размер блока удваивается до этого предела
+
+// перед каждым узлом лежит заголовок с признаком размещения в арене
+const size_t TREE_NODE_HEADER = alignof(Tree);
+const char TREE_NODE_HEAP = 0;
+const char TREE_NODE_ARENA = 1;
+
+const size_t TREE_TEXT_BLOCK_SIZE = 0x10000; // буфер записи текста дерева в поток
+
+//---------------------------------------------------------------------------
+// Хранилище разобранного дерева: копия исходного текста и блоки памяти под узлы.
+// Принадлежит корню, узлы в блоках разрушает деструктор корня
+class TreeArena
+{
+public:
+	string source; // на этот текст ссылаются значения узлов
+
+	// создает корень, которому принадлежит арена
+	static unique_ptr<Tree> make_root(unique_ptr<TreeArena> arena)
+	{
+		unique_ptr<Tree> root(new Tree("", node_type::nd_list, nullptr));
+		root->arena = std::move(arena);
+		return root;
+	}
+
+	Tree* add_child(Tree *parent, const char *data, size_t size, node_type type)
+	{
+		if(used == capacity)
+		{
+			capacity = chunks.empty() ? TREE_FIRST_CHUNK_NODES : min(capacity * 2, TREE_MAX_CHUNK_NODES);
+			chunks.emplace_back(new node_storage[capacity]);
+			used = 0;
+		}
+		char *slot = reinterpret_cast<char*>(&chunks.back()[used++]);
+		*slot = TREE_NODE_ARENA;
+		return ::new(slot + TREE_NODE_HEADER) Tree(data, size, type, parent);
+	}
+
+private:
+	typedef aligned_storage<TREE_NODE_HEADER + sizeof(Tree), alignof(Tree)>::type node_storage;
+
+	vector<unique_ptr<node_storage[]>> chunks;
+	size_t capacity {0};
+	size_t used {0};
+};
+
+//---------------------------------------------------------------------------
+// Индекс подчиненных узлов. Добавление узла в конец индекс поддерживает,
+// удаление и изменение значений сбрасывают его до следующего обращения
+struct TreeChildIndex
+{
+	vector<Tree*> nodes;                  // действителен, если размер равен количеству подчиненных
+	unordered_map<string, Tree*> names;   // первый подчиненный с данным значением
+	bool has_names {false};
+};
+
 //---------------------------------------------------------------------------
 Tree::Tree(const string &_value, const node_type _type, Tree *_parent)
+	: value(_value), view(nullptr), view_size(0), type(_type)
 {
-	value = _value;
-	type = _type;
-	parent = _parent;
+	link(_parent);
+}
+
+//---------------------------------------------------------------------------
+Tree::Tree(const char *_data, size_t _size, const node_type _type, Tree *_parent)
+	: view(_data), view_size(_size), type(_type)
+{
+	link(_parent);
+}
 
+//---------------------------------------------------------------------------
+void Tree::link(Tree *_parent)
+{
+	parent = _parent;
 	num_subnode = 0;
 	index = 0;
 	if(parent)
 	{
+		TreeChildIndex *ci = parent->child_index.get();
+		if(ci)
+		{
+			if(ci->nodes.size() == static_cast<size_t>(parent->num_subnode)) ci->nodes.push_back(this);
+			if(ci->has_names) ci->names.emplace(get_value(), this);
+		}
 		parent->num_subnode++;
 		prev = parent->last;
 		if(prev)
@@ -74,12 +145,50 @@ Tree::~Tree()
 	if(next) next->prev = prev;
 	if(parent)
 	{
+		if(parent->child_index) parent->child_removed(this);
 		if(parent->first == this) parent->first = next;
 		if(parent->last == this) parent->last = prev;
 		parent->num_subnode--;
 	}
 }
 
+//---------------------------------------------------------------------------
+TreeChildIndex &Tree::get_child_index()
+{
+	if(!child_index) child_index.reset(new TreeChildIndex);
+	return *child_index;
+}
+
+//---------------------------------------------------------------------------
+// вызывается до исключения child из списка подчиненных
+void Tree::child_removed(Tree *child)
+{
+	TreeChildIndex *ci = child_index.get();
+	if(ci->nodes.size() == static_cast<size_t>(num_subnode) && child == last) ci->nodes.pop_back();
+	else ci->nodes.clear();
+	if(ci->has_names)
+	{
+		ci->names.clear();
+		ci->has_names = false;
+	}
+}
+
+//---------------------------------------------------------------------------
+void *Tree::operator new(size_t size)
+{
+	char *block = static_cast<char*>(::operator new(size + TREE_NODE_HEADER));
+	*block = TREE_NODE_HEAP;
+	return block + TREE_NODE_HEADER;
+}
+
+//---------------------------------------------------------------------------
+void Tree::operator delete(void *p)
+{
+	if(!p) return;
+	char *block = static_cast<char*>(p) - TREE_NODE_HEADER;
+	if(*block == TREE_NODE_HEAP) ::operator delete(block);
+}
+
 //---------------------------------------------------------------------------
 Tree* Tree::add_child(const string &_value, const node_type _type)
 {
@@ -101,9 +210,22 @@ Tree* Tree::add_node()
 //---------------------------------------------------------------------------
 std::string Tree::get_value() const
 {
+	if(view) return string(view, view_size);
 	return value;
 }
 
+//---------------------------------------------------------------------------
+const char *Tree::get_value_data() const
+{
+	return view ? view : value.data();
+}
+
+//---------------------------------------------------------------------------
+size_t Tree::get_value_size() const
+{
+	return view ? view_size : value.size();
+}
+
 //---------------------------------------------------------------------------
 node_type Tree::get_type() const
 {
@@ -114,7 +236,14 @@ node_type Tree::get_type() const
 void Tree::set_value(const string &v, const node_type t)
 {
 	value = v;
+	view = nullptr;
+	view_size = 0;
 	type = t;
+	if(parent && parent->child_index && parent->child_index->has_names)
+	{
+		parent->child_index->names.clear();
+		parent->child_index->has_names = false;
+	}
 }
 
 //---------------------------------------------------------------------------
@@ -126,28 +255,30 @@ int Tree::get_num_subnode() const
 //---------------------------------------------------------------------------
 Tree* Tree::get_subnode(int _index)
 {
-	if(_index >= num_subnode) return nullptr;
-	Tree* t = first;
-	while(_index)
+	if(_index < 0 || _index >= num_subnode) return nullptr;
+	TreeChildIndex &ci = get_child_index();
+	if(ci.nodes.size() != static_cast<size_t>(num_subnode))
 	{
-		t = t->next;
-		--_index;
+		ci.nodes.clear();
+		ci.nodes.reserve(num_subnode);
+		for(Tree* t = first; t; t = t->next) ci.nodes.push_back(t);
 	}
-	return t;
+	return ci.nodes[_index];
 }
 
 //---------------------------------------------------------------------------
 Tree* Tree::get_subnode(const std::string &node_name)
 {
-	Tree* t = first;
-	while(t)
+	if(!first) return nullptr;
+	TreeChildIndex &ci = get_child_index();
+	if(!ci.has_names)
 	{
-		if (Equal(t->value, node_name)) {
-			return t;
-		}
-		t = t->next;
+		ci.names.reserve(num_subnode);
+		for(Tree* t = first; t; t = t->next) ci.names.emplace(t->get_value(), t);
+		ci.has_names = true;
 	}
-	return nullptr;
+	auto found = ci.names.find(node_name);
+	return found == ci.names.end() ? nullptr : found->second;
 }
 
 //---------------------------------------------------------------------------
@@ -179,63 +310,117 @@ Tree& Tree::operator [](int _index)
 {
 	if(!this) return *this; //-V704
 
-	Tree* ret = first;
-	while(_index)
+	return *get_subnode(_index);
+}
+
+//---------------------------------------------------------------------------
+// Вывод дерева в текст. Один и тот же обход пишет в строку или в поток
+namespace {
+
+// позиция первой кавычки или end, кавычки ищутся блоками по 16 байт
+const char* find_quote(const char *p, const char *end)
+{
+#ifdef TOOL1CD_SSE2
+	const __m128i quot = _mm_set1_epi8('"');
+	while(end - p >= 16)
 	{
-		if(ret) ret = ret->next;
-		--_index;
+		uint32_t mask = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)p), quot));
+		if(mask) return p + first_bit(mask);
+		p += 16;
 	}
-	return *ret;
+#endif
+	while(p < end && *p != '"') p++;
+	return p;
 }
 
-//---------------------------------------------------------------------------
-void Tree::outtext(std::string &text)
+struct TextString
+{
+	std::string &text;
+	bool empty() const { return text.empty(); }
+	void put(char c) { text.push_back(c); }
+	void put(const char *data, size_t length) { text.append(data, length); }
+};
+
+struct TextStream
 {
-	node_type lt = node_type::nd_unknown;
-	TReplaceFlags _ReplaceAll = TReplaceFlags::rfReplaceAll;
+	BufferedWriter &writer;
+	bool written;
+	bool empty() const { return !written; }
+	void put(char c) { put(&c, 1); }
+	void put(const char *data, size_t length)
+	{
+		writer.write(data, length);
+		written = true;
+	}
+};
 
-	if(num_subnode)
+// строка с удвоением кавычек
+template<typename Sink>
+void put_escaped(Sink &out, const char *data, size_t length)
+{
+	const char *end = data + length;
+	while(true)
 	{
-		if (!text.empty()) {
-			text += "\r\n";
-		}
-		text += "{";
-		Tree* t = first;
+		const char *quote = find_quote(data, end);
+		out.put(data, quote - data);
+		if(quote == end) return;
+		out.put("\"\"", 2);
+		data = quote + 1;
+	}
+}
+
+template<typename Sink>
+void put_tree_text(Tree *node, Sink &out)
+{
+	if(node->get_num_subnode())
+	{
+		if(!out.empty()) out.put("\r\n", 2);
+		out.put('{');
+		node_type lt = node_type::nd_unknown;
+		Tree* t = node->get_first();
 		while(t)
 		{
-			t->outtext(text);
-			lt = t->type;
-			t = t->next;
-			if(t) text += ",";
+			put_tree_text(t, out);
+			lt = t->get_type();
+			t = t->get_next();
+			if(t) out.put(',');
 		}
-		if(lt == node_type::nd_list) text += "\r\n";
-		text += "}";
+		if(lt == node_type::nd_list) out.put("\r\n", 2);
+		out.put('}');
+		return;
 	}
-	else
+
+	switch(node->get_type())
 	{
-		switch(type)
-		{
-			case node_type::nd_string:
-				text += "\"";
-				text += StringReplace(value, "\"", "\"\"", rfReplaceAll);
-				text += "\"";
-				break;
-			case node_type::nd_number:
-			case node_type::nd_number_exp:
-			case node_type::nd_guid:
-			case node_type::nd_list:
-			case node_type::nd_binary:
-			case node_type::nd_binary2:
-			case node_type::nd_link:
-			case node_type::nd_binary_d:
-				text += value;
-				break;
-			default:
-				break;
-		}
+		case node_type::nd_string:
+			out.put('"');
+			put_escaped(out, node->get_value_data(), node->get_value_size());
+			out.put('"');
+			break;
+		case node_type::nd_number:
+		case node_type::nd_number_exp:
+		case node_type::nd_guid:
+		case node_type::nd_list:
+		case node_type::nd_binary:
+		case node_type::nd_binary2:
+		case node_type::nd_link:
+		case node_type::nd_binary_d:
+			out.put(node->get_value_data(), node->get_value_size());
+			break;
+		default:
+			break;
 	}
 }
 
+} // namespace
+
+//---------------------------------------------------------------------------
+void Tree::outtext(std::string &text)
+{
+	TextString out {text};
+	put_tree_text(this, out);
+}
+
 //---------------------------------------------------------------------------
 string Tree::path() const
 {
@@ -254,86 +439,200 @@ string Tree::path() const
 
 
 //---------------------------------------------------------------------------
-node_type classification_value(const std::string &value)
+// Классы символов для определения типа значения
+namespace {
+
+const uint8_t CHAR_DIGIT  = 1; // 0-9
+const uint8_t CHAR_HEX    = 2; // 0-9a-fA-F
+const uint8_t CHAR_BASE64 = 4; // 0-9a-zA-Z+=/ и переводы строк
+
+struct CharClasses
 {
-	if(value.size() == 0) {
-		return node_type::nd_empty;
+	uint8_t table[256];
+
+	CharClasses()
+	{
+		memset(table, 0, sizeof(table));
+		for(int c = '0'; c <= '9'; c++) table[c] = CHAR_DIGIT | CHAR_HEX | CHAR_BASE64;
+		for(int c = 'a'; c <= 'z'; c++) table[c] = CHAR_BASE64;
+		for(int c = 'A'; c <= 'Z'; c++) table[c] = CHAR_BASE64;
+		for(int c = 'a'; c <= 'f'; c++) table[c] |= CHAR_HEX;
+		for(int c = 'A'; c <= 'F'; c++) table[c] |= CHAR_HEX;
+		for(char c : {'+', '=', '/', '\r', '\n'}) table[static_cast<uint8_t>(c)] = CHAR_BASE64;
+	}
+};
+
+const CharClasses char_classes;
+
+inline bool is_class(char c, uint8_t cls)
+{
+	return (char_classes.table[static_cast<uint8_t>(c)] & cls) != 0;
+}
+
+// пропускает символы класса, возвращает позицию первого символа другого класса
+inline const char* skip_class(const char *p, const char *end, uint8_t cls)
+{
+	while(p != end && is_class(*p, cls)) ++p;
+	return p;
+}
+
+inline bool has_prefix(const char *p, const char *end, const char *prefix, size_t prefix_size)
+{
+	return static_cast<size_t>(end - p) >= prefix_size && memcmp(p, prefix, prefix_size) == 0;
+}
+
+// ^-?\d+(\.?\d*)?((e|E)-?\d+)?$, is_integer - значение без дробной части и показателя (^-?\d+$)
+bool is_number(const char *p, const char *end, bool &is_integer)
+{
+	if(p != end && *p == '-') ++p;
+	const char *digits = p;
+	p = skip_class(p, end, CHAR_DIGIT);
+	if(p == digits) return false;
+	is_integer = p == end;
+	if(is_integer) return true;
+
+	if(*p == '.') p = skip_class(p + 1, end, CHAR_DIGIT);
+	if(p == end) return true;
+
+	if(*p != 'e' && *p != 'E') return false;
+	++p;
+	if(p != end && *p == '-') ++p;
+	digits = p;
+	p = skip_class(p, end, CHAR_DIGIT);
+	return p != digits && p == end;
+}
+
+// ^[0-9a-fA-F]{8}-[0-9a-fA-F]{4}-[0-9a-fA-F]{4}-[0-9a-fA-F]{4}-[0-9a-fA-F]{12}$
+bool is_guid(const char *p, size_t size)
+{
+	if(size != 36) return false;
+	for(size_t i = 0; i < 36; i++)
+	{
+		if(i == 8 || i == 13 || i == 18 || i == 23)
+		{
+			if(p[i] != '-') return false;
+		}
+		else if(!is_class(p[i], CHAR_HEX)) return false;
 	}
+	return true;
+}
+
+// ^[0-9]+:[0-9a-fA-F]{32}$
+bool is_link(const char *p, const char *end)
+{
+	const char *digits = p;
+	p = skip_class(p, end, CHAR_DIGIT);
+	if(p == digits || end - p != 33 || *p != ':') return false;
+	return skip_class(p + 1, end, CHAR_HEX) == end;
+}
+
+} // namespace
 
-	if(regex_match(value.c_str(), exp_number)) {
-		return node_type::nd_number;
+//---------------------------------------------------------------------------
+node_type classification_value(const char *data, size_t size)
+{
+	if(size == 0) {
+		return node_type::nd_empty;
 	}
 
-	if(regex_match(value.c_str(), exp_number_exp)) {
-		return node_type::nd_number_exp;
+	const char *end = data + size;
+
+	bool is_integer;
+	if(is_number(data, end, is_integer)) {
+		return is_integer ? node_type::nd_number : node_type::nd_number_exp;
 	}
 
-	if(regex_match(value.c_str(), exp_guid)) {
+	if(is_guid(data, size)) {
 		return node_type::nd_guid;
 	}
 
-	if(regex_match(value.c_str(), exp_binary)) {
+	if(has_prefix(data, end, "#base64:", 8) && skip_class(data + 8, end, CHAR_BASE64) == end) {
 		return node_type::nd_binary;
 	}
 
-	if(regex_match(value.c_str(), exp_link)) {
+	if(is_link(data, end)) {
 		return node_type::nd_link;
 	}
 
-	if(regex_match(value.c_str(), exp_binary2)) {
+	if(skip_class(data, end, CHAR_BASE64) == end) {
 		return node_type::nd_binary2;
 	}
 
-	if(regex_match(value.c_str(), exp_binary_d)) {
+	if(has_prefix(data, end, "#data:", 6) && skip_class(data + 6, end, CHAR_BASE64) == end) {
 		return node_type::nd_binary_d;
 	}
 
 	return node_type::nd_unknown;
 }
 
-bool read_next_flow(TStreamReader *reader, int &index, char &sym)
+//---------------------------------------------------------------------------
+node_type classification_value(const std::string &value)
 {
-	int data = reader->Read();
-	if (data == -1) {
-		return false;
-	}
-
-	sym = (char)data;
-	if (sym == '\0') {
-		return false;
-	}
-
-	index++;
-	return true;
+	return classification_value(value.data(), value.size());
 }
 
-// HINT: index - с единички
-bool read_next_flow(const string &source, int &index, char &sym)
-{
-	if (index > source.size()) {
-		return false;
-	}
-	sym = source.at(index - 1);
-	index++;
-	return true;
-}
-
-template<typename flow_type>
-Tree* parse_flow(flow_type source, const std::string &path)
+//---------------------------------------------------------------------------
+// Разбирает текст arena->source. Значения узлов ссылаются на этот текст,
+// копируются только строки с удвоенными кавычками
+unique_ptr<Tree> parse_source(unique_ptr<TreeArena> arena, const std::string &path)
 {
-	string cur_value;
+	TreeArena *a = arena.get();
+	unique_ptr<Tree> ret = TreeArena::make_root(std::move(arena));
 
-	Tree* ret;
-	Tree* t;
-	int pos = 1;
-	char sym;
+	const char *begin = a->source.data();
+	const char *end = begin + a->source.size();
+	const char *p = begin;
+	const char *value_begin = nullptr; // начало текущего значения
+	bool has_quotes = false;           // в текущей строке есть удвоенные кавычки
 
+	Tree* t = ret.get();
 	state_type state = state_type::s_value;
 
-	ret = new Tree("", node_type::nd_list, nullptr);
-	t = ret;
+	// позиция в сообщениях об ошибках как в прежней реализации (с единицы, после текущего символа)
+	auto position = [&]() { return to_string(p - begin + 2); };
+
+	auto add_value = [&](const char *value_end, node_type nt) {
+		a->add_child(t, value_begin, value_end - value_begin, nt);
+	};
+
+	auto add_string = [&](const char *value_end) {
+		if(!has_quotes)
+		{
+			add_value(value_end, node_type::nd_string);
+			return;
+		}
+		string s;
+		s.reserve(value_end - value_begin);
+		for(const char *c = value_begin; c != value_end; ++c)
+		{
+			s.push_back(*c);
+			if(*c == '"') ++c; // вторая кавычка пары
+		}
+		a->add_child(t, nullptr, 0, node_type::nd_string)->set_value(s, node_type::nd_string);
+	};
+
+	auto add_nonstring = [&](const char *value_end) {
+		node_type nt = classification_value(value_begin, value_end - value_begin);
+		if (nt == node_type::nd_unknown) {
+			throw DetailedException("Ошибка формата потока. Неизвестный тип значения.")
+					.add_detail("Значение", string(value_begin, value_end))
+					.add_detail("Путь", path);
+		}
+		add_value(value_end, nt);
+	};
 
-	while (read_next_flow(source, pos, sym))  {
+	auto close_list = [&]() {
+		t = t->get_parent();
+		if(!t)
+		{
+			throw DetailedException("Ошибка формата потока. Лишняя закрывающая скобка }.")
+				.add_detail("Позиция", position())
+				.add_detail("Путь", path);
+		}
+	};
+
+	for(; p != end; ++p) {
+		char sym = *p;
 		switch(state)
 		{
 			case state_type::s_value:
@@ -345,31 +644,25 @@ Tree* parse_flow(flow_type source, const std::string &path)
 					case '\n':
 						break;
 					case '"':
-						cur_value.clear();
+						value_begin = p + 1;
+						has_quotes = false;
 						state = state_type::s_string;
 						break;
 					case '{':
-						t = new Tree("", node_type::nd_list, t);
+						t = a->add_child(t, nullptr, 0, node_type::nd_list);
 						break;
 					case '}':
 						if(t->get_first()) {
-							t->add_child("", node_type::nd_empty);
-						}
-						t = t->get_parent();
-						if(!t)
-						{
-							throw DetailedException("Ошибка формата потока. Лишняя закрывающая скобка }.")
-								.add_detail("Позиция", to_string(pos))
-								.add_detail("Путь", path);
+							a->add_child(t, nullptr, 0, node_type::nd_empty);
 						}
+						close_list();
 						state = state_type::s_delimiter;
 						break;
 					case ',':
-						t->add_child("", node_type::nd_empty);
+						a->add_child(t, nullptr, 0, node_type::nd_empty);
 						break;
 					default:
-						cur_value.clear();
-						cur_value.push_back(sym);
+						value_begin = p;
 						state = state_type::s_nonstring;
 						break;
 				}
@@ -386,13 +679,7 @@ Tree* parse_flow(flow_type source, const std::string &path)
 						state = state_type::s_value;
 						break;
 					case '}':
-						t = t->get_parent();
-						if(!t)
-						{
-							throw DetailedException("Ошибка формата потока. Лишняя закрывающая скобка }.")
-											.add_detail("Позиция", to_string(pos))
-											.add_detail("Путь", path);
-						}
+						close_list();
 						break;
 					default:
 						throw DetailedException("Ошибка формата потока. Ошибочный символ в режиме ожидания разделителя.")
@@ -402,20 +689,26 @@ Tree* parse_flow(flow_type source, const std::string &path)
 				}
 				break;
 			case state_type::s_string:
-				if(sym == '"'){
-					state = state_type::s_quote_or_endstring;
+			{
+				const char *quote = static_cast<const char*>(memchr(p, '"', end - p));
+				if(!quote)
+				{
+					p = end - 1;
+					break;
 				}
-				else cur_value.push_back(sym);
+				p = quote;
+				state = state_type::s_quote_or_endstring;
 				break;
+			}
 			case state_type::s_quote_or_endstring:
 				if(sym == '"')
 				{
-					cur_value.push_back(sym);
+					has_quotes = true;
 					state = state_type::s_string;
 				}
 				else
 				{
-					t->add_child(cur_value, node_type::nd_string);
+					add_string(p - 1);
 					switch(sym)
 					{
 						case ' ': // space
@@ -428,13 +721,7 @@ Tree* parse_flow(flow_type source, const std::string &path)
 							state = state_type::s_value;
 							break;
 						case '}':
-							t = t->get_parent();
-							if(!t)
-							{
-								throw DetailedException("Ошибка формата потока. Лишняя закрывающая скобка }.")
-												.add_detail("Позиция", to_string(pos))
-												.add_detail("Путь", path);
-							}
+							close_list();
 							state = state_type::s_delimiter;
 							break;
 						default:
@@ -446,39 +733,19 @@ Tree* parse_flow(flow_type source, const std::string &path)
 				}
 				break;
 			case state_type::s_nonstring:
-				switch(sym)
+				while(p != end && *p != ',' && *p != '}') ++p;
+				if(p == end)
 				{
-					case ',': {
-						node_type nt = classification_value(cur_value);
-						if (nt == node_type::nd_unknown) {
-							throw DetailedException("Ошибка формата потока. Неизвестный тип значения.")
-									.add_detail("Значение", cur_value)
-									.add_detail("Путь", path);
-						}
-						t->add_child(cur_value, nt);
-						state = state_type::s_value;
-						break;
-					}
-					case '}': {
-						node_type nt = classification_value(cur_value);
-						if (nt == node_type::nd_unknown) {
-							throw DetailedException("Ошибка формата потока. Неизвестный тип значения.")
-									.add_detail("Значение", cur_value)
-									.add_detail("Путь", path);
-						}
-						t->add_child(cur_value, nt);
-						t = t->get_parent();
-						if (!t) {
-							throw DetailedException("Ошибка формата потока. Лишняя закрывающая скобка }.")
-									.add_detail("Позиция", to_string(pos))
-									.add_detail("Путь", path);
-						}
-						state = state_type::s_delimiter;
-						break;
-					}
-					default:
-						cur_value.push_back(sym);
-						break;
+					--p;
+					break;
+				}
+				add_nonstring(p);
+				if(*p == ',') {
+					state = state_type::s_value;
+				}
+				else {
+					close_list();
+					state = state_type::s_delimiter;
 				}
 				break;
 			default:
@@ -491,16 +758,16 @@ Tree* parse_flow(flow_type source, const std::string &path)
 
 	if(state == state_type::s_nonstring)
 	{
-		node_type nt = classification_value(cur_value);
+		node_type nt = classification_value(value_begin, end - value_begin);
 		if(nt == node_type::nd_unknown) {
 			msreg_g.AddError("Ошибка формата потока. Неизвестный тип значения.")
-							.with("Значение", cur_value)
+							.with("Значение", string(value_begin, end))
 							.with("Путь", path);
 		}
-		t->add_child(cur_value, nt);
+		add_value(end, nt);
 	}
 	else if(state == state_type::s_quote_or_endstring) {
-		t->add_child(cur_value, node_type::nd_string);
+		add_string(end - 1);
 	}
 	else if(state != state_type::s_delimiter)
 	{
@@ -509,7 +776,7 @@ Tree* parse_flow(flow_type source, const std::string &path)
 						.add_detail("Путь", path);
 	}
 
-	if(t != ret)
+	if(t != ret.get())
 	{
 		throw DetailedException("Ошибка формата потока. Не хватает закрывающих скобок } в конце текста разбора.")
 						.add_detail("Путь", path);
@@ -518,19 +785,42 @@ Tree* parse_flow(flow_type source, const std::string &path)
 	return ret;
 }
 
+//---------------------------------------------------------------------------
 unique_ptr<Tree> parse_1Cstream(TStream *str, const string &path)
 {
-	unique_ptr<Tree> result( parse_flow(new TStreamReader(str, true), path) );
-	return result;
+	unique_ptr<TreeArena> arena(new TreeArena);
+	string &source = arena->source;
+	const size_t READ_BLOCK_SIZE = 0x10000;
+	size_t size = 0;
+	while(true)
+	{
+		source.resize(size + READ_BLOCK_SIZE);
+		int64_t read = str->Read(&source[size], READ_BLOCK_SIZE);
+		if(read <= 0) break;
+		size += read;
+	}
+	// текст потока заканчивается на первом нулевом символе
+	source.resize(strnlen(source.data(), size));
+	return parse_source(std::move(arena), path);
 }
 
-
+//---------------------------------------------------------------------------
 unique_ptr<Tree> parse_1Ctext(const string &text, const string &path)
 {
-	unique_ptr<Tree> result( parse_flow(text, path) );
-	return result;
+	unique_ptr<TreeArena> arena(new TreeArena);
+	arena->source = text;
+	return parse_source(std::move(arena), path);
 }
 
+//---------------------------------------------------------------------------
+unique_ptr<Tree> parse_1Ctext(string &&text, const string &path)
+{
+	unique_ptr<TreeArena> arena(new TreeArena);
+	arena->source = std::move(text);
+	return parse_source(std::move(arena), path);
+}
+
+//---------------------------------------------------------------------------
 string outtext(Tree *t)
 {
 	string text;
@@ -542,3 +832,12 @@ string outtext(Tree *t)
 	return text;
 }
 
+//---------------------------------------------------------------------------
+void outtext(Tree *t, TStream *stream)
+{
+	if(!t || !t->get_first()) return;
+	BufferedWriter writer(stream, TREE_TEXT_BLOCK_SIZE);
+	TextStream out {writer, false};
+	put_tree_text(t->get_first(), out);
+	writer.flush();
+}
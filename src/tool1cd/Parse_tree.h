@@ -35,15 +35,27 @@ enum class state_type {
 	s_nonstring // режим ввода значения не строки
 };
 
+class TreeArena;
+struct TreeChildIndex;
+
+// Узел дерева скобочного текста 1С.
+// Узлы разобранного текста размещаются в арене корня и ссылаются на копию исходного текста.
+// delete узла арены только вызывает деструктор, память освобождается вместе с корнем
 class Tree
 {
 public:
 	Tree(const std::string &_value, const node_type _type, Tree *_parent);
+	Tree(const Tree &) = delete;
+	Tree &operator=(const Tree &) = delete;
 	~Tree();
+	static void *operator new(size_t size);
+	static void operator delete(void *p);
 	Tree* add_child(const std::string &_value, const node_type _type);
 	Tree* add_child();
 	Tree* add_node();
 	std::string get_value() const;
+	const char *get_value_data() const; // значение без копирования, действительно, пока жив узел
+	size_t get_value_size() const;
 	node_type get_type() const;
 	int get_num_subnode() const;
 	Tree* get_subnode(int _index);
@@ -58,7 +70,13 @@ public:
 	std::string path() const;
 
 private:
+	friend class TreeArena;
+	Tree(const char *_data, size_t _size, const node_type _type, Tree *_parent);
+	void link(Tree *_parent);
+
 	std::string value;
+	const char *view;  // значение в исходном тексте (nullptr - значение в value)
+	size_t view_size;
 	node_type type;
 	int num_subnode; // количество подчиненных
 	Tree* parent;    // +1
@@ -67,11 +85,21 @@ private:
 	Tree* first;     // -1
 	Tree* last;      // -1
 	unsigned int index;
+	std::unique_ptr<TreeArena> arena; // только у корня разобранного дерева
+	std::unique_ptr<TreeChildIndex> child_index; // строится при обращении к подчиненным по номеру или имени
+
+	TreeChildIndex &get_child_index();
+	void child_removed(Tree *child);
 };
 
+node_type classification_value(const char *data, size_t size);
+node_type classification_value(const std::string &value);
+
 std::unique_ptr<Tree> parse_1Ctext(const std::string &text, const std::string &path);
+std::unique_ptr<Tree> parse_1Ctext(std::string &&text, const std::string &path); // текст забирается без копирования
 std::unique_ptr<Tree> parse_1Cstream(TStream *str, const std::string &path);
 std::string outtext(Tree *t);
+void outtext(Tree *t, TStream *stream); // тот же текст без промежуточной строки
 
 #endif
 
@@ -0,0 +1,45 @@
+/*
+    Tool1CD library provides access to 1CD database files.
+    Copyright © 2009-2017 awa
+    Copyright © 2017-2018 E8 Tools contributors
+
+    This file is part of Tool1CD Library.
+
+    Tool1CD Library is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Tool1CD Library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with Tool1CD Library.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "RecordDecoder.h"
+#include "Field.h"
+
+using namespace std;
+
+//---------------------------------------------------------------------------
+RecordDecoder::RecordDecoder(const vector<Field*> &fields, decode_format format)
+{
+	steps.reserve(fields.size());
+	for(auto field : fields)
+	{
+		const FieldType *type_manager = field->get_type_manager();
+		field_decoder_step step;
+		step.kernel = type_manager->get_decoder_kernel(format);
+		step.offset = field->get_offset();
+		step.null_exists = field->get_null_exists();
+		step.value_offset = step.offset + (step.null_exists ? 1 : 0);
+		step.length = type_manager->get_length();
+		step.precision = type_manager->get_precision();
+		step.type_manager = type_manager;
+		step.parent = field->get_parent();
+		steps.push_back(step);
+	}
+}
@@ -0,0 +1,73 @@
+/*
+    Tool1CD library provides access to 1CD database files.
+    Copyright © 2009-2017 awa
+    Copyright © 2017-2018 E8 Tools contributors
+
+    This file is part of Tool1CD Library.
+
+    Tool1CD Library is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Tool1CD Library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with Tool1CD Library.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef TOOL1CD_PROJECT_RECORDDECODER_H
+#define TOOL1CD_PROJECT_RECORDDECODER_H
+
+#include <string>
+#include <vector>
+
+#include "FieldType.h"
+
+class Field;
+
+struct field_decoder_step
+{
+	field_decoder_kernel kernel;
+	int32_t offset; // смещение поля в записи
+	int32_t value_offset; // смещение значения (после признака NULL)
+	bool null_exists;
+	int32_t length;
+	int32_t precision;
+	const FieldType *type_manager;
+	const Table *parent;
+};
+
+// Программа декодирования записей, строящаяся один раз на всю выгрузку: для каждого поля смещения,
+// признак NULL и ядро, специализированное под тип поля (FieldType::get_decoder_kernel).
+// Значения формируются без виртуальных вызовов и разбора типа поля на каждой записи.
+// Ядра берутся на момент построения, поэтому FieldType::showGUID и showGUIDasMS не должны меняться во время выгрузки
+class RecordDecoder
+{
+public:
+	RecordDecoder(const std::vector<Field*> &fields, decode_format format);
+
+	size_t size() const { return steps.size(); }
+
+	// rec - запись целиком (TableRecord::get_record_data)
+	bool is_null(size_t index, const char *rec) const
+	{
+		const field_decoder_step &step = steps[index];
+		return step.null_exists && rec[step.offset] == 0;
+	}
+
+	// дописывает в out значение поля, не равное NULL
+	void append_value(std::string &out, size_t index, const char *rec) const
+	{
+		const field_decoder_step &step = steps[index];
+		step.kernel(out, rec + step.value_offset, step);
+	}
+
+private:
+	std::vector<field_decoder_step> steps;
+};
+
+#endif //TOOL1CD_PROJECT_RECORDDECODER_H
@@ -28,6 +28,7 @@
 #include <boost/filesystem.hpp>
 #include "System.SysUtils.hpp"
 #include "utf8.h"
+#include "../Simd.h"
 
 using namespace std;
 
@@ -190,5 +191,82 @@ int ToIntDef(const std::string &s, int default_value)
 	}
 }
 
+const size_t UTF16_CHUNK_SIZE = 256; // кодовых единиц UTF-16, перекодируемых за один проход в буфер на стеке
+
+// Блоки по 8 кодовых единиц, целиком состоящие из ASCII или целиком из двухбайтовых символов (кириллица),
+// перекодируются векторно; остальное - посимвольно. Суррогатные пары разбирает utf8-cpp
+void AppendUtf16AsUtf8(std::string &dest, const void *data, size_t size)
+{
+	auto in = static_cast<const uint8_t*>(data);
+	size_t count = size / 2;
+	char buf[UTF16_CHUNK_SIZE * 3 + 4]; // суррогатная пара на границе порции дает 4 байта на одну единицу порции
+
+#ifdef TOOL1CD_SSE2
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i not_ascii = _mm_set1_epi16(static_cast<short>(0xFF80));
+	const __m128i not_two_bytes = _mm_set1_epi16(static_cast<short>(0xF800));
+	const __m128i lead_mark = _mm_set1_epi16(0xC0);
+	const __m128i trail_mark = _mm_set1_epi16(0x80);
+	const __m128i trail_bits = _mm_set1_epi16(0x3F);
+#endif
+
+	size_t i = 0;
+	while (i < count) {
+		size_t end = std::min(count, i + UTF16_CHUNK_SIZE);
+		char *out = buf;
+		while (i < end) {
+#ifdef TOOL1CD_SSE2
+			if (end - i >= 8) {
+				__m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i * 2));
+				int ascii = _mm_movemask_epi8(_mm_cmpeq_epi16(_mm_and_si128(v, not_ascii), zero));
+				if (ascii == 0xFFFF) {
+					_mm_storel_epi64(reinterpret_cast<__m128i*>(out), _mm_packus_epi16(v, v));
+					out += 8;
+					i += 8;
+					continue;
+				}
+				int two_bytes = _mm_movemask_epi8(_mm_cmpeq_epi16(_mm_and_si128(v, not_two_bytes), zero));
+				if (ascii == 0 && two_bytes == 0xFFFF) {
+					// в каждой 16-битной ячейке - два байта UTF-8 символа в порядке записи
+					__m128i lead = _mm_or_si128(_mm_srli_epi16(v, 6), lead_mark);
+					__m128i trail = _mm_or_si128(_mm_and_si128(v, trail_bits), trail_mark);
+					_mm_storeu_si128(reinterpret_cast<__m128i*>(out), _mm_or_si128(lead, _mm_slli_epi16(trail, 8)));
+					out += 16;
+					i += 8;
+					continue;
+				}
+			}
+#endif
+			uint16_t c = in[i * 2] | in[i * 2 + 1] << 8;
+			if (c < 0x80) {
+				*out++ = static_cast<char>(c);
+				i++;
+			}
+			else if (c < 0x800) {
+				*out++ = static_cast<char>(0xC0 | c >> 6);
+				*out++ = static_cast<char>(0x80 | (c & 0x3F));
+				i++;
+			}
+			else if (c < 0xD800 || c > 0xDFFF) {
+				*out++ = static_cast<char>(0xE0 | c >> 12);
+				*out++ = static_cast<char>(0x80 | ((c >> 6) & 0x3F));
+				*out++ = static_cast<char>(0x80 | (c & 0x3F));
+				i++;
+			}
+			else {
+				uint16_t pair[2] = {c, 0};
+				size_t n = 1;
+				if (i + 1 < count) {
+					pair[1] = in[i * 2 + 2] | in[i * 2 + 3] << 8;
+					n = 2;
+				}
+				out = utf8::utf16to8(pair, pair + n, out); // без второй половины пары - исключение
+				i += 2;
+			}
+		}
+		dest.append(buf, out - buf);
+	}
+}
+
 } // System
 
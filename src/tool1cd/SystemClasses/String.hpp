@@ -39,6 +39,10 @@ bool Equal(const std::string &a, const std::string &b);
 
 int ToIntDef(const std::string &s, int default_value);
 
+// Дописывает в dest строку UTF-16LE длиной size байт в кодировке UTF-8.
+// Ошибки в суррогатных парах - исключение utf8::invalid_utf16, как у TEncoding::Unicode
+void AppendUtf16AsUtf8(std::string &dest, const void *data, size_t size);
+
 template <typename char_type>
 std::string operator + (const std::basic_string<char_type> &text, const int value)
 {
@@ -77,11 +77,11 @@ virtual std::vector<uint8_t> GetPreamble()
 
 virtual string toUtf8(const std::vector<uint8_t> &Buffer, int offset) const
 {
-	auto data_first = (const uint16_t *)(Buffer.data() + offset);
-	auto data_last  = data_first + (Buffer.size() - offset) / sizeof(uint16_t);
-	std::vector<uint8_t> result_vector;
-	utf8::utf16to8(data_first, data_last, back_inserter(result_vector));
-	return TEncoding::UTF8->toUtf8(result_vector);
+	string result;
+	if (Buffer.size() > static_cast<size_t>(offset)) {
+		AppendUtf16AsUtf8(result, Buffer.data() + offset, Buffer.size() - offset);
+	}
+	return result;
 }
 
 virtual std::vector<uint8_t> fromUtf8(const string &data)
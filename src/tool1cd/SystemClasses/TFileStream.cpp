@@ -76,6 +76,9 @@ void TFileStream::Reopen()
 
 void TFileStream::Close()
 {
+	if (!_stream) {
+		return;
+	}
 	_stream->close();
 	_stream.reset();
 }
@@ -20,11 +20,22 @@
 */
 
 #include <string>
+#include <algorithm>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
+#include <memory>
+#include <deque>
 #include <boost/filesystem.hpp>
 
 #include "Table.h"
 #include "TableRecord.h"
 #include "Common.h"
+#include "BufferedWriter.h"
+#include "GzipStream.h"
+#include "ExportCheckpoint.h"
+#include "RecordDecoder.h"
 #include "SystemClasses/String.hpp"
 
 extern Registrator msreg_g;
@@ -56,8 +67,7 @@ changed_rec::changed_rec(Table* _parent, changed_rec_type crt, uint32_t phys_num
 		rec = new char[parent->get_recordlen()];
 		memset(rec, 0, parent->get_recordlen());
 	}
-	next = parent->get_changed_record();
-	parent->set_changed_record(this);
+	parent->add_changed_record(this);
 }
 //---------------------------------------------------------------------------
 changed_rec::~changed_rec()
@@ -112,8 +122,18 @@ void Table::init()
 
 	edit = false;
 	ch_rec = nullptr;
+	ch_rec_last = nullptr;
 	added_numrecords = 0;
 
+	insert_batch = false;
+	batch_numrecords = 0;
+	batch_next_record = 0;
+	batch_data_offset = 0;
+	batch_next_blob = 0;
+	batch_blob_offset = 0;
+	batch_start_data_len = 0;
+	batch_start_blob_len = 0;
+
 	phys_numrecords = 0;
 	log_numrecords = 0;
 	bad = true;
@@ -473,7 +493,8 @@ Table::Table(T_1CD* _base, int32_t block_descr)
 
 	descr_table = new V8Object(base, block_descr);
 	auto data = descr_table->get_data();
-	description = TEncoding::Unicode->toUtf8(vector<uint8_t>(data, data + descr_table->get_len()));
+	description.clear();
+	AppendUtf16AsUtf8(description, data, descr_table->get_len());
 
 	try {
 
@@ -527,14 +548,7 @@ void Table::delete_indexes()
 //---------------------------------------------------------------------------
 Table::~Table()
 {
-	changed_rec* cr;
-	changed_rec* cr2;
-	for(cr = ch_rec; cr;)
-	{
-		cr2 = cr->next;
-		delete cr;
-		cr = cr2;
-	}
+	clear_changed_records();
 
 	delete_fields();
 	delete_indexes();
@@ -729,7 +743,7 @@ void Table::set_lock_inmemory(bool _lock)
 TStream* Table::readBlob(TStream* _str, uint32_t _startblock, uint32_t _length, bool rewrite) const
 {
 	uint32_t _curblock;
-	char* _curb;
+	const char* _curb;
 	uint16_t _curlen;
 	uint32_t _filelen, _numblock;
 	uint32_t startlen;
@@ -752,7 +766,7 @@ TStream* Table::readBlob(TStream* _str, uint32_t _startblock, uint32_t _length,
 				.add_detail("Таблица", name)
 				.add_detail("Длина файла", to_hex_string(_filelen));
 
-		_curb = new char[0x100];
+		BlobPrefetcher prefetcher(file_blob);
 		_curblock = _startblock;
 		while(_curblock)
 		{
@@ -763,7 +777,8 @@ TStream* Table::readBlob(TStream* _str, uint32_t _startblock, uint32_t _length,
 					.add_detail("Всего блоков", _numblock)
 					.add_detail("Читаемый блок", _curblock);
 			}
-			file_blob->get_data(_curb, _curblock << 8, BLOB_RECORD_LEN);
+			uint64_t _readed = _str->GetSize() - startlen;
+			_curb = prefetcher.get_record(_curblock, _readed < _length ? _length - _readed : 0);
 			_curblock = *(uint32_t*)_curb;
 			_curlen = *(uint16_t*)(_curb + 4);
 			if(_curlen > BLOB_RECORD_DATA_LEN)
@@ -777,7 +792,6 @@ TStream* Table::readBlob(TStream* _str, uint32_t _startblock, uint32_t _length,
 
 			if(_str->GetSize() - startlen > _length) break; // аварийный выход из возможного ошибочного зацикливания
 		}
-		delete[] _curb;
 
 		if(_str->GetSize() - startlen != _length)
 		{
@@ -801,7 +815,7 @@ TStream* Table::readBlob(TStream* _str, uint32_t _startblock, uint32_t _length,
 uint32_t Table::readBlob(void* buf, uint32_t _startblock, uint32_t _length) const
 {
 	uint32_t _curblock;
-	char* _curb;
+	const char* _curb;
 	char* _buf;
 	uint16_t _curlen;
 	uint32_t _filelen, _numblock;
@@ -825,7 +839,7 @@ uint32_t Table::readBlob(void* buf, uint32_t _startblock, uint32_t _length) cons
 					.add_detail("Длина файла", to_hex_string(_filelen));
 		}
 
-		_curb = new char[0x100];
+		BlobPrefetcher prefetcher(file_blob);
 		_curblock = _startblock;
 		while(_curblock)
 		{
@@ -836,7 +850,7 @@ uint32_t Table::readBlob(void* buf, uint32_t _startblock, uint32_t _length) cons
 					.add_detail("Всего блоков", _numblock)
 					.add_detail("Читаемый блок", _curblock);
 			}
-			file_blob->get_data(_curb, _curblock << 8, BLOB_RECORD_LEN);
+			_curb = prefetcher.get_record(_curblock, readed < _length ? _length - readed : 0);
 			_curblock = *(uint32_t*)_curb;
 			_curlen = *(uint16_t*)(_curb + 4);
 			if(_curlen > BLOB_RECORD_DATA_LEN)
@@ -852,7 +866,6 @@ uint32_t Table::readBlob(void* buf, uint32_t _startblock, uint32_t _length) cons
 
 			if(readed > _length) break; // аварийный выход из возможного ошибочного зацикливания
 		}
-		delete[] _curb;
 
 		if(readed != _length)
 		{
@@ -873,7 +886,271 @@ uint32_t Table::readBlob(void* buf, uint32_t _startblock, uint32_t _length) cons
 }
 
 //---------------------------------------------------------------------------
-bool Table::export_to_xml(const std::string &_filename, bool blob_to_file, bool unpack) const
+// Добавление XML-представления значения поля к строке выгрузки
+static void append_field_xml(string &out, const string &field_name, const string &value, bool is_null)
+{
+	out += "\t\t\t<";
+	out += field_name;
+	if(is_null)
+	{
+		out += "/>\r\n";
+		return;
+	}
+	out += ">";
+	out += value;
+	out += "</";
+	out += field_name;
+	out += ">\r\n";
+}
+
+//---------------------------------------------------------------------------
+// Значения полей дописываются прямо в out, без промежуточных строк
+void Table::append_record_xml(string &out, const TableRecord *rec, const RecordDecoder &decoder) const
+{
+	const char *data = rec->get_record_data();
+	out += "\t\t<Record>\r\n";
+	for(size_t i = 0; i < fields.size(); i++)
+	{
+		const string &field_name = fields[i]->get_name();
+		out += "\t\t\t<";
+		out += field_name;
+		if(decoder.is_null(i, data))
+		{
+			out += "/>\r\n";
+			continue;
+		}
+		out += ">";
+		decoder.append_value(out, i, data);
+		out += "</";
+		out += field_name;
+		out += ">\r\n";
+	}
+	out += "\t\t</Record>\r\n";
+}
+
+//---------------------------------------------------------------------------
+// Выгрузка записей порциями: рабочие потоки формируют XML порций в памяти, вызывающий поток пишет их в файл строго по порядку.
+// Объекты базы не рассчитаны на одновременное чтение, поэтому каждый поток читает таблицу через свой экземпляр базы
+void Table::export_records_to_xml(BufferedWriter &f, const vector<uint32_t> &numrecs, const vector<Table*> &tables, const string &status,
+								  ExportCheckpoint *checkpoint, const string &filename, uint32_t first) const
+{
+	uint32_t numchunks = (numrecs.size() + XML_EXPORT_CHUNK_RECORDS - 1) / XML_EXPORT_CHUNK_RECORDS;
+	uint32_t window = tables.size() * 4; // сколько порций может быть сформировано впереди записанных
+	uint32_t checkpoint_chunks = std::max<uint32_t>(1, EXPORT_CHECKPOINT_RECORDS / XML_EXPORT_CHUNK_RECORDS);
+
+	std::mutex lock;
+	std::condition_variable cond;
+	uint32_t next_chunk = 0; // следующая порция для формирования
+	uint32_t written_chunks = 0; // количество записанных порций
+	vector<string> chunks(numchunks);
+	vector<bool> ready(numchunks, false);
+	std::exception_ptr error;
+
+	auto worker = [&](Table* tab) {
+		while(true)
+		{
+			uint32_t k;
+			{
+				std::unique_lock<std::mutex> guard(lock);
+				cond.wait(guard, [&]() { return error || next_chunk >= numchunks || next_chunk < written_chunks + window; });
+				if(error || next_chunk >= numchunks) return;
+				k = next_chunk++;
+			}
+
+			string out;
+			try
+			{
+				RecordDecoder decoder(tab->fields, decode_format::xml);
+				uint32_t last = std::min<uint64_t>((uint64_t)(k + 1) * XML_EXPORT_CHUNK_RECORDS, numrecs.size());
+				for(uint32_t j = k * XML_EXPORT_CHUNK_RECORDS; j < last; j++)
+				{
+					std::unique_ptr<TableRecord> rec(tab->get_record(numrecs[j]));
+					tab->append_record_xml(out, rec.get(), decoder);
+				}
+			}
+			catch(...)
+			{
+				std::lock_guard<std::mutex> guard(lock);
+				if(!error) error = std::current_exception();
+				cond.notify_all();
+				return;
+			}
+
+			std::lock_guard<std::mutex> guard(lock);
+			chunks[k].swap(out);
+			ready[k] = true;
+			cond.notify_all();
+		}
+	};
+
+	vector<std::thread> workers;
+	try
+	{
+		for(auto tab : tables) workers.emplace_back(worker, tab);
+
+		for(uint32_t k = 0; k < numchunks; k++)
+		{
+			string out;
+			{
+				std::unique_lock<std::mutex> guard(lock);
+				cond.wait(guard, [&]() { return error || ready[k]; });
+				if(error) break;
+				out.swap(chunks[k]);
+				written_chunks = k + 1;
+				cond.notify_all();
+			}
+			f.write(out);
+			uint32_t written = std::min<uint64_t>((uint64_t)(k + 1) * XML_EXPORT_CHUNK_RECORDS, numrecs.size());
+			msreg_g.Status(status + to_string(first + written));
+			if(checkpoint && (k + 1) % checkpoint_chunks == 0)
+			{
+				checkpoint->save(filename, first + written, f);
+			}
+		}
+	}
+	catch(...)
+	{
+		// ошибка записи (например, нет места на диске) или запуска потока: останавливаем рабочие потоки,
+		// исключение выбрасывается после их завершения
+		std::lock_guard<std::mutex> guard(lock);
+		if(!error) error = std::current_exception();
+		cond.notify_all();
+	}
+
+	for(auto &w : workers) w.join();
+	if(error) std::rethrow_exception(error);
+}
+
+//---------------------------------------------------------------------------
+// Объекты базы не рассчитаны на одновременное чтение, поэтому для чтения таблицы из нескольких потоков
+// база открывается повторно, только для чтения. Уже открытые экземпляры из bases используются повторно
+vector<Table*> Table::open_base_copies(vector<unique_ptr<T_1CD>> &bases, uint32_t count) const
+{
+	int32_t numtable = -1;
+	for(int32_t i = 0; i < base->get_numtables(); i++) if(base->get_table(i) == this)
+	{
+		numtable = i;
+		break;
+	}
+	if(numtable < 0)
+	{
+		throw DetailedException("Таблица не найдена в базе при параллельной выгрузке")
+			.add_detail("Таблица", name);
+	}
+
+	while(bases.size() < count) bases.emplace_back(new T_1CD(base->get_filepath(), nullptr, false));
+
+	vector<Table*> tables;
+	for(uint32_t t = 0; t < count; t++)
+	{
+		Table* tab = bases[t]->get_numtables() > numtable ? bases[t]->get_table(numtable) : nullptr;
+		if(!tab || tab->get_name() != name || tab->get_phys_numrecords() != phys_numrecords)
+		{
+			throw DetailedException("Не удалось открыть таблицу для параллельной выгрузки")
+				.add_detail("Таблица", name);
+		}
+		tables.push_back(tab);
+	}
+	return tables;
+}
+
+namespace {
+
+// Запись blob в файлы пулом потоков. Задания ставятся в ограниченную очередь, и основной цикл выгрузки
+// формирует XML, пока потоки читают, распаковывают и записывают blob. Каждый поток читает таблицу через свой экземпляр базы
+class BlobFileWriter
+{
+public:
+	BlobFileWriter(const vector<Table*> &tables, bool _unpack)
+		: unpack(_unpack), capacity(tables.size() * BLOB_FILE_QUEUE_PER_THREAD)
+	{
+		for(auto tab : tables) workers.emplace_back(&BlobFileWriter::worker, this, tab);
+	}
+
+	~BlobFileWriter()
+	{
+		stop();
+	}
+
+	void add(uint32_t phys_numrecord, int32_t numfield, const string &filename)
+	{
+		std::unique_lock<std::mutex> guard(lock);
+		cond.wait(guard, [&]() { return error || tasks.size() < capacity; });
+		if(error) std::rethrow_exception(error);
+		tasks.push_back(Task{phys_numrecord, numfield, filename});
+		cond.notify_all();
+	}
+
+	// дожидается записи всех blob
+	void finish()
+	{
+		stop();
+		if(error) std::rethrow_exception(error);
+	}
+
+private:
+	struct Task
+	{
+		uint32_t phys_numrecord;
+		int32_t numfield;
+		string filename;
+	};
+
+	bool unpack;
+	size_t capacity;
+	vector<std::thread> workers;
+	std::mutex lock;
+	std::condition_variable cond;
+	std::deque<Task> tasks;
+	bool stopping {false};
+	std::exception_ptr error;
+
+	void stop()
+	{
+		{
+			std::lock_guard<std::mutex> guard(lock);
+			stopping = true;
+		}
+		cond.notify_all();
+		for(auto &w : workers) w.join();
+		workers.clear();
+	}
+
+	void worker(Table *tab)
+	{
+		while(true)
+		{
+			Task task;
+			{
+				std::unique_lock<std::mutex> guard(lock);
+				cond.wait(guard, [&]() { return stopping || error || !tasks.empty(); });
+				if(error || tasks.empty()) return;
+				task = std::move(tasks.front());
+				tasks.pop_front();
+			}
+			cond.notify_all();
+
+			try
+			{
+				unique_ptr<TableRecord> rec(tab->get_record(task.phys_numrecord));
+				tab->get_field(task.numfield)->save_blob_to_file(rec.get(), task.filename, unpack);
+			}
+			catch(...)
+			{
+				std::lock_guard<std::mutex> guard(lock);
+				if(!error) error = std::current_exception();
+				cond.notify_all();
+				return;
+			}
+		}
+	}
+};
+
+} // namespace
+
+//---------------------------------------------------------------------------
+bool Table::export_to_xml(const std::string &_filename, bool blob_to_file, bool unpack, uint32_t threads, ExportCheckpoint *checkpoint,
+						  vector<unique_ptr<T_1CD>> *base_copies) const
 {
 	string recname;
 	uint32_t j, numr, nr;
@@ -896,82 +1173,115 @@ bool Table::export_to_xml(const std::string &_filename, bool blob_to_file, bool
 
 	string rpart1 = "\t\t<Record>\r\n";
 	string rpart2 = "\t\t</Record>\r\n";
-	string rpart3 = "\t\t\t<";
 	string status = "Экспорт таблицы ";
 	status += name;
 	status += " ";
 
-	TFileStream f(boost::filesystem::path(_filename), fmCreate);
-
-	f.Write(UnicodeHeader, 3);
-	f.WriteString(part1);
-	f.WriteString(name);
-	f.WriteString(part2);
-
 	auto primary = std::find_if(indexes.begin(), indexes.end(),
 							   [](Index *index) { return index->is_primary();});
 	if (primary != indexes.end()) {
 		curindex= *primary;
 	}
 
-	int image_count; // количество полей с типом image
-	for (auto field : fields) {
-		f.WriteString(fpart1);
-		f.WriteString(field->get_name());
-		f.WriteString(fpart2);
-		f.WriteString(field->get_presentation_type());
-		f.WriteString(fpart3);
-		f.WriteString(to_string(field->get_length()));
-		f.WriteString(fpart4);
-		f.WriteString(to_string(field->get_precision()));
-		f.WriteString(fpart6);
-		f.WriteString(((field->get_null_exists()) ? "false" : "true"));
-		f.WriteString(fpart5);
+	// количество полей с типом image
+	int image_count = std::count_if(fields.begin(), fields.end(),
+									[](Field *field) { return field->get_type() == type_fields::tf_image; });
 
-		if (field->get_type() == type_fields::tf_image) {
-			image_count++;
+	// прерванную выгрузку можно продолжить, только если blob не выгружаются в файлы: имена файлов зависят от предыдущих записей
+	bool resumable = checkpoint && !(blob_to_file && image_count);
+	uint32_t first = 0; // количество записей, выгруженных до прерывания
+	unique_ptr<TStream> fs(resumable ? checkpoint->open_stream(_filename, first)
+									 : create_export_stream(boost::filesystem::path(_filename)));
+	BufferedWriter f(fs.get());
+
+	if(!first) {
+		f.write(UnicodeHeader, 3);
+		f.write(part1);
+		f.write(name);
+		f.write(part2);
+
+		for (auto field : fields) {
+			f.write(fpart1);
+			f.write(field->get_name());
+			f.write(fpart2);
+			f.write(field->get_presentation_type());
+			f.write(fpart3);
+			f.write(to_string(field->get_length()));
+			f.write(fpart4);
+			f.write(to_string(field->get_precision()));
+			f.write(fpart6);
+			f.write(((field->get_null_exists()) ? "false" : "true"));
+			f.write(fpart5);
 		}
-	}
 
-	f.WriteString(part3);
+		f.write(part3);
+	}
 
 	if(curindex) numr = curindex->get_numrecords();
 	else numr = numrecords_found;
 
 	msreg_g.Status(status);
 
+	RecordDecoder decoder(fields, decode_format::xml);
+
+	vector<unique_ptr<T_1CD>> own_copies; // экземпляры базы, если набор не передан вызывающей стороной
+	vector<unique_ptr<T_1CD>> &copies = base_copies ? *base_copies : own_copies;
+
+	// выгрузка blob в файлы зависит от предыдущих записей (имена файлов), поэтому выполняется только последовательно;
+	// изменения таблицы в режиме редактирования не видны другим экземплярам базы
+	if(threads > 1 && !(blob_to_file && image_count) && !edit && numr - first > XML_EXPORT_CHUNK_RECORDS)
+	{
+		vector<uint32_t> numrecs(numr - first);
+		for(j = first; j < numr; j++) numrecs[j - first] = curindex ? curindex->get_numrec(j) : recordsindex[j];
+		uint32_t numchunks = (numrecs.size() + XML_EXPORT_CHUNK_RECORDS - 1) / XML_EXPORT_CHUNK_RECORDS;
+		vector<Table*> tables = open_base_copies(copies, std::min(threads, numchunks));
+		export_records_to_xml(f, numrecs, tables, status, checkpoint, _filename, first);
+		f.write(part4);
+		f.flush();
+		fs->Close();
+		if(checkpoint) checkpoint->set_done(_filename);
+		msreg_g.Status("");
+		return true;
+	}
+
 	recname = "";
 	repeat_count = 0;
 	bool dircreated = false;
 	boost::filesystem::path dir(_filename + ".blob");
+	unique_ptr<BlobFileWriter> blob_writer;
 
-	for(j = 0; j < numr; j++)
+	for(j = first; j < numr; j++)
 	{
 		if (j % 100 == 0 && j) {
 			msreg_g.Status(status + to_string(j));
 		}
 
-		f.Write(rpart1.c_str(), rpart1.size());
 		if(curindex) nr = curindex->get_numrec(j);
 		else nr = recordsindex[j];
 		std::shared_ptr<TableRecord> rec (get_record(nr));
-		if (image_count) {
-			std::string filename = get_file_name_for_record(rec.get());
-			if (EqualIC(filename, recname)) {
-				repeat_count++;
-			} else {
-				recname = filename;
-				repeat_count = 0;
+		if (!blob_to_file || !image_count) {
+			append_record_xml(f.get_buffer(), rec.get(), decoder);
+			f.commit();
+			if (resumable && (j + 1) % EXPORT_CHECKPOINT_RECORDS == 0) {
+				checkpoint->save(_filename, j + 1, f);
 			}
+			continue;
 		}
-		for (auto field : fields) {
-			string outputvalue;
-			f.WriteString(rpart3);
-			f.WriteString(field->get_name());
 
+		f.write(rpart1);
+		std::string filename = get_file_name_for_record(rec.get());
+		if (EqualIC(filename, recname)) {
+			repeat_count++;
+		} else {
+			recname = filename;
+			repeat_count = 0;
+		}
+		for (int32_t i = 0; i < num_fields; i++) {
+			Field *field = fields[i];
+			string outputvalue;
 			bool output_is_null = false;
 
-			if (blob_to_file && field->get_type_manager()->get_type() == type_fields::tf_image) {
+			if (field->get_type_manager()->get_type() == type_fields::tf_image) {
 				if(!dircreated) {
 					try
 					{
@@ -1004,40 +1314,52 @@ bool Table::export_to_xml(const std::string &_filename, bool blob_to_file, bool
 					if(repeat_count)
 					{
 						outputvalue += "_";
-						outputvalue += repeat_count + 1;
+						outputvalue += to_string(repeat_count + 1);
 					}
 
-					dir /= outputvalue;
-					if(!field->save_blob_to_file(rec.get(), dir.string(), unpack)) {
+					string blobpath = (dir / outputvalue).string();
+					if(rec->is_null_value(field) || !rec->get<table_blob_file>(field).blob_start
+						|| !rec->get<table_blob_file>(field).blob_length) {
 						outputvalue = "{NULL}";
 						output_is_null = true;
 					}
+					else if(edit || threads <= 1) {
+						// изменения таблицы в режиме редактирования не видны другим экземплярам базы,
+						// а в один поток blob записываются сразу через текущий экземпляр
+						if(!field->save_blob_to_file(rec.get(), blobpath, unpack)) {
+							outputvalue = "{NULL}";
+							output_is_null = true;
+						}
+					}
+					else {
+						if(!blob_writer) {
+							blob_writer.reset(new BlobFileWriter(open_base_copies(copies, threads), unpack));
+						}
+						blob_writer->add(nr, i, blobpath);
+					}
 				}
 				else outputvalue = "{ERROR}";
 			}
 			else {
 				if (rec->is_null_value(field)) {
-					outputvalue = "{NULL}";
 					output_is_null = true;
 				} else {
-					outputvalue = rec->get_xml_string(field);
+					outputvalue.clear();
+					rec->append_xml_string(outputvalue, field);
 				}
 			}
 
-			if (output_is_null) {
-				f.WriteString("/>\r\n");
-			} else {
-				f.WriteString(">");
-				f.WriteString(outputvalue);
-				f.WriteString("</");
-				f.WriteString(field->get_name());
-				f.WriteString(">\r\n");
-			}
+			append_field_xml(f.get_buffer(), field->get_name(), outputvalue, output_is_null);
+			f.commit();
 		}
-		f.WriteString(rpart2);
+		f.write(rpart2);
 
 	}
-	f.WriteString(part4);
+	if(blob_writer) blob_writer->finish();
+	f.write(part4);
+	f.flush();
+	fs->Close();
+	if(checkpoint) checkpoint->set_done(_filename);
 
 	msreg_g.Status("");
 	return true;
@@ -1068,12 +1390,8 @@ changed_rec_type Table::get_rec_type(uint32_t phys_numrecord)
 	if (!edit) {
 		return changed_rec_type::not_changed;
 	}
-	cr = ch_rec;
-	while(cr)
-	{
-		if(cr->numrec == phys_numrecord) return cr->changed_type;
-		cr = cr->next;
-	}
+	cr = find_changed_record(phys_numrecord);
+	if(cr) return cr->changed_type;
 	return changed_rec_type::not_changed;
 }
 
@@ -1084,28 +1402,25 @@ changed_rec_type Table::get_rec_type(uint32_t phys_numrecord, int32_t numfield)
 	if (!edit) {
 		return changed_rec_type::not_changed;
 	}
-	cr = ch_rec;
-	while(cr) {
-		if(cr->numrec == phys_numrecord) {
-			if (cr->changed_type == changed_rec_type::changed) {
-				return cr->fields[numfield] ? changed_rec_type::changed : changed_rec_type::not_changed;
-			}
-			return cr->changed_type;
+	cr = find_changed_record(phys_numrecord);
+	if(cr) {
+		if (cr->changed_type == changed_rec_type::changed) {
+			return cr->fields[numfield] ? changed_rec_type::changed : changed_rec_type::not_changed;
 		}
-		cr = cr->next;
+		return cr->changed_type;
 	}
 	return changed_rec_type::not_changed;
 }
 
 //---------------------------------------------------------------------------
-void Table::export_table(const boost::filesystem::path &path) const
+void Table::export_table(const boost::filesystem::path &path, bool compress) const
 {
 	boost::filesystem::path dir = path / name;
 	if(!directory_exists(dir, true)) {
 		return;
 	}
 
-	export_import_table_root root;
+	export_import_table_root root {};
 	if(file_data) {
 		root.has_data = true;
 		auto version = file_data->get_current_version();
@@ -1145,16 +1460,16 @@ void Table::export_table(const boost::filesystem::path &path) const
 	}
 
 	if (file_data) {
-		file_data->savetofile((dir / "data").string());
+		file_data->savetofile((dir / (compress ? "data.gz" : "data")).string());
 	}
 	if (file_blob) {
-		file_blob->savetofile((dir / "blob").string());
+		file_blob->savetofile((dir / (compress ? "blob.gz" : "blob")).string());
 	}
 	if (file_index) {
-		file_index->savetofile((dir / "index").string());
+		file_index->savetofile((dir / (compress ? "index.gz" : "index")).string());
 	}
 	if (descr_table) {
-		descr_table->savetofile((dir / "descr").string());
+		descr_table->savetofile((dir / (compress ? "descr.gz" : "descr")).string());
 	}
 
 }
@@ -1168,7 +1483,7 @@ void Table::import_table(const boost::filesystem::path &path)
 		return;
 	}
 
-	TFileStream* f;
+	TStream* f;
 	bool fopen;
 	v8ob* ob;
 
@@ -1184,7 +1499,7 @@ void Table::import_table(const boost::filesystem::path &path)
 			.add_detail("Таблица", name)
 			.add_detail("Файл", (dir / "root").string());
 	}
-	export_import_table_root root;
+	export_import_table_root root {};
 	f->Read(&root, sizeof(export_import_table_root));
 	delete f;
 
@@ -1192,7 +1507,7 @@ void Table::import_table(const boost::filesystem::path &path)
 		fopen = false;
 		try
 		{
-			f = new TFileStream(dir / "data", fmOpenRead);
+			f = open_import_stream(dir / "data").release();
 			fopen = true;
 		}
 		catch(...)
@@ -1219,7 +1534,7 @@ void Table::import_table(const boost::filesystem::path &path)
 		fopen = false;
 		try
 		{
-			f = new TFileStream(dir / "blob", fmOpenRead);
+			f = open_import_stream(dir / "blob").release();
 			fopen = true;
 		}
 		catch(...)
@@ -1246,7 +1561,7 @@ void Table::import_table(const boost::filesystem::path &path)
 		fopen = false;
 		try
 		{
-			f = new TFileStream(dir / "index", fmOpenRead);
+			f = open_import_stream(dir / "index").release();
 			fopen = true;
 		}
 		catch(...)
@@ -1274,7 +1589,7 @@ void Table::import_table(const boost::filesystem::path &path)
 		fopen = false;
 		try
 		{
-			f = new TFileStream(dir / "descr", fmOpenRead);
+			f = open_import_stream(dir / "descr").release();
 			fopen = true;
 		}
 		catch(...)
@@ -1293,7 +1608,8 @@ void Table::import_table(const boost::filesystem::path &path)
 			auto buf_size = f->GetSize();
 			char *buf = new char[buf_size];
 			f->Read(buf, buf_size);
-			string str = TEncoding::Unicode->toUtf8(vector<uint8_t>(buf, buf + buf_size));
+			string str;
+			AppendUtf16AsUtf8(str, buf, buf_size);
 			delete[] buf;
 			delete f;
 
@@ -1332,7 +1648,6 @@ void Table::set_edit_value(uint32_t phys_numrecord, int32_t numfield, bool null,
 	type_fields tf;
 	bool changed;
 	changed_rec* cr;
-	changed_rec* cr2;
 	int32_t i, j;
 	TStream** ost;
 
@@ -1367,7 +1682,7 @@ void Table::set_edit_value(uint32_t phys_numrecord, int32_t numfield, bool null,
 		changed = memcmp(rec->get_raw(fld), fldvalue, fld->get_size()) != 0;
 	}
 
-	for(cr = ch_rec; cr; cr = cr->next) if(cr->numrec == phys_numrecord) break;
+	cr = find_changed_record(phys_numrecord);
 	if(!cr)
 	{
 		if(!changed)
@@ -1376,9 +1691,8 @@ void Table::set_edit_value(uint32_t phys_numrecord, int32_t numfield, bool null,
 			return; // значение не изменилось, ничего не делаем
 		}
 		cr = new changed_rec(this, phys_numrecord >= phys_numrecords ? changed_rec_type::inserted : changed_rec_type::changed, phys_numrecord);
-		if(phys_numrecord <= phys_numrecords) {
-			// TODO: тут должно быть что-то иное
-			memcpy(cr->rec, rec, recordlen);
+		if(rec) {
+			memcpy(cr->rec, rec->get_record_data(), recordlen);
 		}
 	}
 
@@ -1407,18 +1721,12 @@ void Table::set_edit_value(uint32_t phys_numrecord, int32_t numfield, bool null,
 		if(j == 0)
 		{
 			// измененных полей больше нет, надо удалить запись из измененных
-			if(ch_rec == cr) ch_rec = cr->next;
-			else for(cr2 = ch_rec; cr2; cr2 = cr2->next) if(cr2->next == cr)
-			{
-				cr2->next = cr->next;
-				break;
-			}
-			delete cr;
+			remove_changed_record(cr);
 		}
 		else memcpy(editrec + fld->get_offset(), fldvalue, fld->get_size());
 	}
 
-	delete[] rec;
+	delete rec;
 	delete[] fldvalue;
 }
 
@@ -1427,14 +1735,13 @@ void Table::restore_edit_value(uint32_t phys_numrecord, int32_t numfield)
 {
 	Field* fld;
 	changed_rec* cr;
-	changed_rec* cr2;
 	int32_t i, j;
 	type_fields tf;
 	TStream** ost;
 
 	if(phys_numrecord >= phys_numrecords) return;
 
-	for(cr = ch_rec; cr; cr = cr->next) if(cr->numrec == phys_numrecord) break;
+	cr = find_changed_record(phys_numrecord);
 	if(!cr) return;
 	if(cr->changed_type != changed_rec_type::changed) return;
 
@@ -1456,13 +1763,7 @@ void Table::restore_edit_value(uint32_t phys_numrecord, int32_t numfield)
 	if(j == 0)
 	{
 		// измененных полей больше нет, надо удалить запись из измененных
-		if(ch_rec == cr) ch_rec = cr->next;
-		else for(cr2 = ch_rec; cr2; cr2 = cr2->next) if(cr2->next == cr)
-		{
-			cr2->next = cr->next;
-			break;
-		}
-		delete cr;
+		remove_changed_record(cr);
 	}
 	else{
 		TableRecord *rec = get_record(phys_numrecord);
@@ -1476,9 +1777,8 @@ void Table::restore_edit_value(uint32_t phys_numrecord, int32_t numfield)
 void Table::set_rec_type(uint32_t phys_numrecord, changed_rec_type crt)
 {
 	changed_rec* cr;
-	changed_rec* cr2;
 
-	for(cr = ch_rec; cr; cr = cr->next) if(cr->numrec == phys_numrecord) break;
+	cr = find_changed_record(phys_numrecord);
 
 	if(phys_numrecord < phys_numrecords)
 	{
@@ -1500,6 +1800,8 @@ void Table::set_rec_type(uint32_t phys_numrecord, changed_rec_type crt)
 					cr->clear();
 					delete[] cr->rec;
 					delete[] cr->fields;
+					cr->rec = nullptr;
+					cr->fields = nullptr;
 					cr->changed_type = crt;
 				}
 				else new changed_rec(this, crt, phys_numrecord);
@@ -1507,13 +1809,7 @@ void Table::set_rec_type(uint32_t phys_numrecord, changed_rec_type crt)
 			case changed_rec_type::not_changed:
 				if(cr)
 				{
-					if(ch_rec == cr) ch_rec = cr->next;
-					else for(cr2 = ch_rec; cr2; cr2 = cr2->next) if(cr2->next == cr)
-					{
-						cr2->next = cr->next;
-						break;
-					}
-					delete cr;
+					remove_changed_record(cr);
 				}
 				break;
 		}
@@ -1548,16 +1844,15 @@ void Table::set_rec_type(uint32_t phys_numrecord, changed_rec_type crt)
 			case changed_rec_type::deleted:
 				if(cr)
 				{
-					if(ch_rec == cr) ch_rec = cr->next;
-					else for(cr2 = ch_rec; cr2; cr2 = cr2->next) if(cr2->next == cr)
-					{
-						cr2->next = cr->next;
-						break;
-					}
-					delete cr;
+					remove_changed_record(cr);
 					added_numrecords--;
 				}
-				for(cr = ch_rec; cr; cr = cr->next) if(cr->numrec > phys_numrecord) cr->numrec--;
+				ch_rec_index.clear();
+				for(cr = ch_rec; cr; cr = cr->next)
+				{
+					if(cr->numrec > phys_numrecord) cr->numrec--;
+					ch_rec_index[cr->numrec] = cr;
+				}
 				break;
 			case changed_rec_type::not_changed:
 				throw DetailedException("Попытка прямой установки признака \"Не изменена\" добавленной записи таблицы")
@@ -1571,16 +1866,12 @@ void Table::set_rec_type(uint32_t phys_numrecord, changed_rec_type crt)
 //---------------------------------------------------------------------------
 TableRecord *Table::get_edit_record(uint32_t phys_numrecord)
 {
-	changed_rec* cr;
-	for(cr = ch_rec; cr; cr = cr->next) if(phys_numrecord == cr->numrec)
+	changed_rec* cr = find_changed_record(phys_numrecord);
+	if(cr && cr->changed_type != changed_rec_type::deleted)
 	{
-		if(cr->changed_type != changed_rec_type::deleted)
-		{
-			char *rec = new char[recordlen];
-			memcpy(rec, cr->rec, recordlen);
-			return new TableRecord(this, rec, recordlen);
-		}
-		break;
+		char *rec = new char[recordlen];
+		memcpy(rec, cr->rec, recordlen);
+		return new TableRecord(this, rec, recordlen);
 	}
 	return get_record(phys_numrecord);
 }
@@ -1704,17 +1995,19 @@ void Table::delete_data_record(uint32_t phys_numrecord)
 	}
 	else
 	{
-		char *tmp = new char[recordlen];
-		memset(tmp, 0, recordlen);
-		TableRecord *rec = new TableRecord(this, tmp, recordlen);
-
-		file_data->get_data(&first_empty_rec, 0, 4);
-		*((int32_t*)rec) = first_empty_rec;
-		file_data->set_data(&first_empty_rec, 0, 4);
-		write_data_record(phys_numrecord, rec);
-		delete rec;
+		// удаленная запись: признак удаления и номер следующей свободной записи,
+		// начало цепочки свободных записей хранится в заголовке
+		std::vector<char> b(recordlen, 0);
+		b[0] = 1;
+		file_data->get_data(&first_empty_rec, 1, 4);
+		memcpy(b.data() + 1, &first_empty_rec, 4);
+		file_data->set_data(b.data(), (uint64_t)phys_numrecord * recordlen, recordlen);
+		first_empty_rec = phys_numrecord;
+		file_data->set_data(&first_empty_rec, 1, 4);
 	}
 
+	log_numrecords--;
+	recordsindex_complete = false;
 }
 
 //---------------------------------------------------------------------------
@@ -1815,7 +2108,8 @@ void Table::write_data_record(uint32_t phys_numrecord, const TableRecord *rec)
 		file_data->set_data(b, 0, recordlen);
 		delete[] b;
 	}
-	file_data->set_data(rec, phys_numrecord * recordlen, recordlen);
+	file_data->set_data(rec->get_record_data(), (uint64_t)phys_numrecord * recordlen, recordlen);
+	if(phys_numrecord >= phys_numrecords) phys_numrecords = phys_numrecord + 1;
 }
 
 //---------------------------------------------------------------------------
@@ -1942,17 +2236,10 @@ void Table::write_index_record(const uint32_t phys_numrecord, const TableRecord
 //---------------------------------------------------------------------------
 void Table::cancel_edit()
 {
-	changed_rec* cr;
-	changed_rec* cr2;
-	for(cr = ch_rec; cr;)
-	{
-		cr2 = cr->next;
-		delete cr;
-		cr = cr2;
-	}
+	discard_insert_batch();
+	clear_changed_records();
 
 	edit = false;
-	ch_rec = nullptr;
 	added_numrecords = 0;
 }
 
@@ -1960,26 +2247,53 @@ void Table::cancel_edit()
 void Table::end_edit()
 {
 	changed_rec* cr;
+	std::vector<changed_rec*> deleted_recs;
+	std::vector<changed_rec*> changed_recs;
+	std::vector<changed_rec*> inserted_recs;
 
-	// удаляем удаленные записи
 	for (cr = ch_rec; cr; cr = cr->next) {
-		if (cr->changed_type == changed_rec_type::deleted) {
-			delete_record(cr->numrec);
+		switch (cr->changed_type) {
+			case changed_rec_type::deleted:
+				deleted_recs.push_back(cr);
+				break;
+			case changed_rec_type::changed:
+				changed_recs.push_back(cr);
+				break;
+			case changed_rec_type::inserted:
+				inserted_recs.push_back(cr);
+				break;
+			default:
+				break;
 		}
 	}
 
+	// изменения применяются пакетами, упорядоченными по номеру записи,
+	// чтобы запись в файлы data, blob и index шла по возрастанию страниц
+	auto by_numrec = [](const changed_rec *a, const changed_rec *b) {
+		return a->numrec < b->numrec;
+	};
+	std::sort(deleted_recs.begin(), deleted_recs.end(), by_numrec);
+	std::sort(changed_recs.begin(), changed_recs.end(), by_numrec);
+	std::sort(inserted_recs.begin(), inserted_recs.end(), by_numrec);
+
+	end_insert_batch();
+
+	// удаляем удаленные записи
+	for (auto rec : deleted_recs) {
+		delete_record(rec->numrec);
+	}
+
 	// записываем измененные записи
-	for (cr = ch_rec; cr; cr = cr->next) {
-		if (cr->changed_type == changed_rec_type::changed) {
-			update_record(cr->numrec, cr->rec, cr->fields);
-		}
+	for (auto rec : changed_recs) {
+		update_record(rec->numrec, rec->rec, rec->fields);
 	}
 
 	// добавляем новые записи
-	for (cr = ch_rec; cr; cr = cr->next) {
-		if (cr->changed_type == changed_rec_type::inserted) {
-			insert_record(new TableRecord(this, cr->rec));
-		}
+	for (auto rec : inserted_recs) {
+		TableRecord nrec(this, rec->rec, recordlen);
+		insert_record(&nrec);
+		// потоки блобов освобождены в insert_record
+		memset(rec->fields, 0, num_fields);
 	}
 
 	cancel_edit();
@@ -1999,8 +2313,8 @@ void Table::delete_record(uint32_t phys_numrecord)
 		auto tf = f->get_type_manager()->get_type();
 		if(tf == type_fields::tf_image || tf == type_fields::tf_string || tf == type_fields::tf_text)
 		{
-			auto bp = (const table_blob_file *)rec->get_raw(f);
-			if (bp->blob_start) {
+			auto bp = (const table_blob_file *)rec->get_data(f);
+			if (!rec->is_null_value(f) && bp->blob_start) {
 				delete_blob_record(bp->blob_start);
 			}
 		}
@@ -2014,74 +2328,68 @@ void Table::delete_record(uint32_t phys_numrecord)
 //---------------------------------------------------------------------------
 void Table::insert_record(const TableRecord *nrec)
 {
-	int32_t offset;
-	char* j;
-	type_fields tf;
 	uint32_t phys_numrecord;
 	uint32_t k;
 
-	TableRecord *rec = new TableRecord(this);
-	rec->Assign(nrec);
-
 	if(!file_data) create_file_data();
 
-	for (int i = 0; i < num_fields; i++)
+	std::vector<char> b(nrec->get_record_data(), nrec->get_record_data() + recordlen);
+	char* rec = b.data();
+	rec[0] = 0;
+
+	for(auto f : fields)
 	{
-		Field *f = fields[i];
-		tf = f->get_type_manager()->get_type();
-		offset = f->get_offset() + (f->get_null_exists() ? 1 : 0);
-		switch(tf)
+		char* fdata = rec + f->get_offset() + (f->get_null_exists() ? 1 : 0);
+		switch(f->get_type())
 		{
 			case type_fields::tf_image:
 			case type_fields::tf_string:
 			case type_fields::tf_text: {
-				TStream **st = (TStream **) (rec + offset);
+				TStream **st = (TStream **)fdata;
 				table_blob_file bp = {0, 0};
 				if (*st) {
 					bp.blob_length = (*st)->GetSize();
 					bp.blob_start = write_blob_record(*st);
 					delete *st;
-					*st = nullptr;
 				}
 				if (bp.blob_start == 0 && f->get_null_exists()) {
-					rec->set_null(f);
+					rec[f->get_offset()] = 0;
+					memset(fdata, 0, sizeof(bp));
 				} else {
-					rec->set_data(f, &bp);
+					if (f->get_null_exists()) rec[f->get_offset()] = 1;
+					memcpy(fdata, &bp, sizeof(bp));
 				}
+				break;
 			}
 			case type_fields::tf_version: {
-
-				struct {
-					_version ver;
-					_version ver2;
-				} vers;
-
-				file_data->get_version_rec_and_increase(&vers.ver);
-				vers.ver2 = vers.ver;
-				rec->set_data(f, &vers);
-
+				_version ver;
+				file_data->get_version_rec_and_increase(&ver);
+				_version_rec vers[2] = {{ver.version_1, ver.version_2}, {ver.version_1, ver.version_2}};
+				memcpy(fdata, vers, sizeof(vers));
 				break;
 			}
 			case type_fields::tf_version8: {
 				_version ver;
 				file_data->get_version_rec_and_increase(&ver);
-				rec->set_data(f, &ver);
+				_version_rec vers = {ver.version_1, ver.version_2};
+				memcpy(fdata, &vers, sizeof(vers));
 				break;
 			}
+			default:
+				break;
 		}
 	}
 
 	if(file_data->get_len() == 0)
 	{
-		j = new char[recordlen];
-		memset(j, 0, recordlen);
-		*j = 1;
-		file_data->set_data(j, 0, recordlen);
-		delete[] j;
+		std::vector<char> h(recordlen, 0);
+		h[0] = 1;
+		file_data->set_data(h.data(), 0, recordlen);
 		phys_numrecord = 1;
 	}
 	else
 	{
+		// первая свободная запись хранится в заголовке, следующая - в самой свободной записи
 		file_data->get_data(&phys_numrecord, 1, 4);
 		if(phys_numrecord)
 		{
@@ -2091,98 +2399,334 @@ void Table::insert_record(const TableRecord *nrec)
 		else phys_numrecord = file_data->get_len() / recordlen;
 	}
 
-	write_data_record(phys_numrecord, rec);
-	write_index_record(phys_numrecord, rec);
+	TableRecord trec(this, rec, recordlen);
+	write_data_record(phys_numrecord, &trec);
+	write_index_record(phys_numrecord, &trec);
 
+	log_numrecords++;
+	recordsindex_complete = false;
 }
 
 //---------------------------------------------------------------------------
-void Table::update_record(uint32_t phys_numrecord, char* newdata, char* changed_fields)
+void Table::begin_insert_batch(uint32_t expected_records)
 {
-	int32_t i, offset;
-	type_fields tf;
-	_version ver;
-	TStream** st;
+	if(!edit)
+	{
+		throw DetailedException("Попытка пакетного добавления записей не в режиме редактирования.")
+			.add_detail("Таблица", name);
+	}
+	if(insert_batch)
+	{
+		throw DetailedException("Пакетное добавление записей уже начато.")
+			.add_detail("Таблица", name);
+	}
+
+	if(!file_data) create_file_data();
+	batch_start_data_len = file_data->get_len();
+	batch_start_blob_len = file_blob ? file_blob->get_len() : 0;
+
+	if(file_data->get_len() == 0)
+	{
+		std::vector<char> b(recordlen, 0);
+		b[0] = 1;
+		file_data->set_data(b.data(), 0, recordlen);
+	}
+
+	// записи пакета дописываются в конец файла подряд, без использования списка свободных записей
+	batch_next_record = file_data->get_len() / recordlen;
+	batch_data_offset = (uint64_t)batch_next_record * recordlen;
+	if(expected_records) file_data->set_len(batch_data_offset + (uint64_t)expected_records * recordlen);
+
+	batch_numrecords = 0;
+	batch_next_blob = 0;
+	batch_blob_offset = 0;
+	batch_data.clear();
+	batch_blob.clear();
+	batch_index.assign(num_indexes, std::vector<char>());
+	batch_keys.assign(num_indexes, std::unordered_set<std::string>());
+	insert_batch = true;
+}
+
+//---------------------------------------------------------------------------
+void Table::insert_batch_record(const TableRecord *nrec)
+{
+	if(!insert_batch)
+	{
+		throw DetailedException("Попытка добавления записи в пакет без начала пакетного добавления.")
+			.add_detail("Таблица", name);
+	}
+
+	size_t pos = batch_data.size();
+	size_t blob_pos = batch_blob.size();
+	uint32_t next_blob = batch_next_blob;
+	batch_data.resize(pos + recordlen);
+	char* rec = batch_data.data() + pos;
+	memcpy(rec, nrec->get_record_data(), recordlen);
+	rec[0] = 0;
+
+	for(auto f : fields)
+	{
+		char* fdata = rec + f->get_offset() + (f->get_null_exists() ? 1 : 0);
+		switch(f->get_type())
+		{
+			case type_fields::tf_image:
+			case type_fields::tf_string:
+			case type_fields::tf_text: {
+				TStream **st = (TStream **)fdata;
+				table_blob_file bp = {0, 0};
+				if (*st) {
+					bp.blob_length = (*st)->GetSize();
+					bp.blob_start = write_batch_blob(*st);
+					delete *st;
+				}
+				if (bp.blob_start == 0 && f->get_null_exists()) {
+					rec[f->get_offset()] = 0;
+					memset(fdata, 0, sizeof(bp));
+				} else {
+					if (f->get_null_exists()) rec[f->get_offset()] = 1;
+					memcpy(fdata, &bp, sizeof(bp));
+				}
+				break;
+			}
+			case type_fields::tf_version: {
+				// в записи хранятся только две пары (реструктуризация, изменение), без version_3
+				_version ver;
+				file_data->get_version_rec_and_increase(&ver);
+				_version_rec vers[2] = {{ver.version_1, ver.version_2}, {ver.version_1, ver.version_2}};
+				memcpy(fdata, vers, sizeof(vers));
+				break;
+			}
+			case type_fields::tf_version8: {
+				_version ver;
+				file_data->get_version_rec_and_increase(&ver);
+				_version_rec vers = {ver.version_1, ver.version_2};
+				memcpy(fdata, &vers, sizeof(vers));
+				break;
+			}
+			default:
+				break;
+		}
+	}
+
+	// индексы только вычисляются, в файл index они попадут в end_insert_batch
+	TableRecord index_rec(this, rec);
+	try
+	{
+		check_batch_unique(&index_rec);
+	}
+	catch(...)
+	{
+		// запись с неуникальным индексом не попадает в пакет
+		batch_data.resize(pos);
+		batch_blob.resize(blob_pos);
+		batch_next_blob = next_blob;
+		throw;
+	}
+	for(int32_t i = 0; i < num_indexes; i++)
+	{
+		uint32_t len = indexes[i]->get_length();
+		if(!len) continue;
+		std::vector<char> &entries = batch_index[i];
+		size_t epos = entries.size();
+		entries.resize(epos + 4 + len);
+		*(uint32_t*)(entries.data() + epos) = batch_next_record;
+		indexes[i]->calcRecordIndex(&index_rec, entries.data() + epos + 4);
+	}
+
+	batch_next_record++;
+	batch_numrecords++;
+
+	if(batch_data.size() + batch_blob.size() >= BATCH_FLUSH_SIZE) flush_insert_batch();
+}
+
+//---------------------------------------------------------------------------
+void Table::check_batch_unique(const TableRecord *rec)
+{
+	std::vector<std::string> keys(num_indexes);
+	for(int32_t i = 0; i < num_indexes; i++)
+	{
+		Index* ind = indexes[i];
+		uint32_t len = ind->get_length();
+		if(!len || !ind->is_primary()) continue;
+		keys[i].resize(len);
+		ind->calcRecordIndex(rec, &keys[i][0]);
+		if(batch_keys[i].count(keys[i]) || ind->find_key(keys[i].data()))
+		{
+			throw DetailedException("Ошибка записи индекса. Индекс уже существует.")
+				.add_detail("Таблица", name)
+				.add_detail("Индекс", ind->get_name());
+		}
+	}
+	// значения запоминаются только после проверки всех индексов
+	for(int32_t i = 0; i < num_indexes; i++)
+	{
+		if(!keys[i].empty()) batch_keys[i].insert(std::move(keys[i]));
+	}
+}
+
+//---------------------------------------------------------------------------
+uint32_t Table::write_batch_blob(TStream* bstr)
+{
+	uint32_t blob_len = bstr->GetSize();
+	if(!blob_len) return 0;
+
+	if(!batch_next_blob)
+	{
+		if(!file_blob) create_file_blob();
+		if(file_blob->get_len() == 0)
+		{
+			char b[BLOB_RECORD_LEN];
+			memset(b, 0, BLOB_RECORD_LEN);
+			file_blob->set_data(b, 0, BLOB_RECORD_LEN);
+		}
+		// цепочки пакета размещаются в конце файла подряд, без использования списка свободных блоков
+		batch_blob_offset = file_blob->get_len();
+		batch_next_blob = batch_blob_offset >> 8;
+	}
+
+	uint32_t first_block = batch_next_blob;
+	uint32_t numblocks = (blob_len + BLOB_RECORD_DATA_LEN - 1) / BLOB_RECORD_DATA_LEN;
+	size_t pos = batch_blob.size();
+	batch_blob.resize(pos + (size_t)numblocks * BLOB_RECORD_LEN, 0);
+
+	bstr->Seek(0, soFromBeginning);
+	for(uint32_t i = 0; i < numblocks; i++)
+	{
+		blob_block* b = (blob_block*)(batch_blob.data() + pos + (size_t)i * BLOB_RECORD_LEN);
+		uint16_t cur_len = std::min(blob_len, BLOB_RECORD_DATA_LEN);
+		b->nextblock = i + 1 < numblocks ? first_block + i + 1 : 0;
+		b->length = cur_len;
+		bstr->Read(b->data, cur_len);
+		blob_len -= cur_len;
+	}
+	batch_next_blob += numblocks;
+
+	return first_block;
+}
+
+//---------------------------------------------------------------------------
+void Table::flush_insert_batch()
+{
+	if(!batch_data.empty())
+	{
+		file_data->set_data(batch_data.data(), batch_data_offset, batch_data.size());
+		batch_data_offset += batch_data.size();
+		batch_data.clear();
+	}
+	if(!batch_blob.empty())
+	{
+		file_blob->set_data(batch_blob.data(), batch_blob_offset, batch_blob.size());
+		batch_blob_offset += batch_blob.size();
+		batch_blob.clear();
+	}
+}
 
-	TableRecord *rec = new TableRecord(this, newdata, recordlen);
+//---------------------------------------------------------------------------
+void Table::end_insert_batch()
+{
+	if(!insert_batch) return;
+
+	try
+	{
+		flush_insert_batch();
+
+		// возвращаем зарезервированные, но не использованные страницы
+		uint64_t data_len = (uint64_t)batch_next_record * recordlen;
+		if(file_data->get_len() > data_len) file_data->set_len(data_len);
+
+		// если пакет сопоставим с таблицей, дешевле перестроить индекс целиком, чем вставлять записи по одной
+		bool rebuild = (uint64_t)batch_numrecords * 4 >= log_numrecords;
+		for(int32_t i = 0; i < num_indexes; i++) indexes[i]->write_index_batch(batch_index[i], rebuild);
+	}
+	catch(...)
+	{
+		discard_insert_batch();
+		throw;
+	}
+
+	phys_numrecords = batch_next_record;
+	log_numrecords += batch_numrecords;
+	recordsindex_complete = false;
+
+	batch_index.clear();
+	batch_keys.clear();
+	insert_batch = false;
+}
+
+//---------------------------------------------------------------------------
+void Table::discard_insert_batch()
+{
+	if(!insert_batch) return;
+	insert_batch = false;
+
+	batch_data.clear();
+	batch_blob.clear();
+	batch_index.clear();
+	batch_keys.clear();
+	batch_numrecords = 0;
+	batch_next_blob = 0;
+
+	// записи и блоки пакета размещаются только в конце файлов, поэтому отмена - это возврат к прежней длине
+	if(file_data && file_data->get_len() > batch_start_data_len) file_data->set_len(batch_start_data_len);
+	if(file_blob && file_blob->get_len() > batch_start_blob_len) file_blob->set_len(batch_start_blob_len);
+}
+
+//---------------------------------------------------------------------------
+void Table::update_record(uint32_t phys_numrecord, char* newdata, char* changed_fields)
+{
 	TableRecord *orec = get_record(phys_numrecord);
 	delete_index_record(phys_numrecord, orec);
-	for(i = 0; i < num_fields; i++)
+	std::vector<char> b(orec->get_record_data(), orec->get_record_data() + recordlen);
+	delete orec;
+	char* rec = b.data();
+
+	for(int32_t i = 0; i < num_fields; i++)
 	{
-		table_blob_file new_blob = {0, 0};
 		Field *f = fields[i];
-		tf = f->get_type_manager()->get_type();
-		offset = f->get_offset() + (f->get_null_exists() ? 1 : 0);
+		type_fields tf = f->get_type();
+		char* fdata = rec + f->get_offset() + (f->get_null_exists() ? 1 : 0);
+		char* ndata = newdata + f->get_offset() + (f->get_null_exists() ? 1 : 0);
 		if(changed_fields[i])
 		{
 			if(tf == type_fields::tf_image || tf == type_fields::tf_string || tf == type_fields::tf_text)
 			{
-				if(f->get_null_exists())
-				{
-					if (orec->is_null_value(f))
-					{
-						auto bp = orec->get<table_blob_file>(f);
-						if (bp.blob_start != 0) {
-							delete_blob_record(bp.blob_start);
-						}
-					}
-					if (!rec->is_null_value(f))
-					{
-						st = (TStream**)(rec->get_data(f)); // TODO: не забыть про сей костыль
-						if(*st)
-						{
-							new_blob.blob_length = (*st)->GetSize();
-							new_blob.blob_start = write_blob_record(*st);
-							delete *st;
-							*st = nullptr;
-						}
-					}
+				auto old_blob = (const table_blob_file *)fdata;
+				if(old_blob->blob_start != 0 && (!f->get_null_exists() || rec[f->get_offset()])) {
+					delete_blob_record(old_blob->blob_start);
 				}
-				else
-				{
-					auto old_blob = orec->get<table_blob_file>(f);
-					if (old_blob.blob_start != 0) {
-						delete_blob_record(old_blob.blob_start);
-					}
 
-					st = (TStream**)rec->get_data(f); // TODO: не забыть про сей костыль
-					if(*st)
-					{
-						new_blob.blob_length = (*st)->GetSize();
-						new_blob.blob_start = write_blob_record(*st);
-						delete *st;
-						*st = nullptr;
-					}
+				table_blob_file new_blob = {0, 0};
+				TStream** st = (TStream**)ndata; // TODO: не забыть про сей костыль
+				if(*st && (!f->get_null_exists() || newdata[f->get_offset()]))
+				{
+					new_blob.blob_length = (*st)->GetSize();
+					new_blob.blob_start = write_blob_record(*st);
+					delete *st;
+					*st = nullptr;
 				}
-				orec->set_data(f, &new_blob);
-				if (new_blob.blob_start == 0) {
-					if (f->get_null_exists()) {
-						orec->set_null(f);
-					}
+				if(new_blob.blob_start == 0 && f->get_null_exists()) {
+					rec[f->get_offset()] = 0;
+					memset(fdata, 0, sizeof(new_blob));
+				} else {
+					if(f->get_null_exists()) rec[f->get_offset()] = 1;
+					memcpy(fdata, &new_blob, sizeof(new_blob));
 				}
 			}
-			else memcpy(orec + f->get_offset(), rec + f->get_offset(), f->get_size());
+			else memcpy(rec + f->get_offset(), newdata + f->get_offset(), f->get_size());
 		}
-		else
+		else if(tf == type_fields::tf_version || tf == type_fields::tf_version8)
 		{
-			if(tf == type_fields::tf_version)
-			{
-				file_data->get_version_rec_and_increase(&ver);
-				memcpy(orec + offset + 8, &ver, 8);
-			}
-			else if(tf == type_fields::tf_version8)
-			{
-				file_data->get_version_rec_and_increase(&ver);
-				memcpy(orec + offset, &ver, 8);
-			}
+			// у tf_version меняется вторая пара (версия изменения), у tf_version8 - единственная
+			_version ver;
+			file_data->get_version_rec_and_increase(&ver);
+			_version_rec vers = {ver.version_1, ver.version_2};
+			memcpy(fdata + (tf == type_fields::tf_version ? sizeof(vers) : 0), &vers, sizeof(vers));
 		}
-
 	}
 
-	write_index_record(phys_numrecord, orec);
-	write_data_record(phys_numrecord, orec);
-	delete[] orec;
-
+	TableRecord trec(this, rec, recordlen);
+	write_index_record(phys_numrecord, &trec);
+	write_data_record(phys_numrecord, &trec);
 }
 
 //---------------------------------------------------------------------------
@@ -2338,7 +2882,7 @@ std::string Table::get_file_name_for_field(int32_t num_field, char *rec, uint32_
 			if(!s.empty()) {
 				s += "_";
 			}
-			s += record.field->get_XML_presentation(rec);
+			record.field->append_XML_presentation(s, rec);
 		}
 		if(!ind->is_primary() && numrec){
 			s += "_";
@@ -2473,7 +3017,43 @@ changed_rec* Table::get_changed_record()
 	return ch_rec;
 }
 
-void Table::set_changed_record(changed_rec *value)
+void Table::add_changed_record(changed_rec *value)
+{
+	value->prev = ch_rec_last;
+	value->next = nullptr;
+	if(ch_rec_last) ch_rec_last->next = value;
+	else ch_rec = value;
+	ch_rec_last = value;
+	ch_rec_index[value->numrec] = value;
+}
+
+changed_rec* Table::find_changed_record(uint32_t phys_numrecord) const
+{
+	auto it = ch_rec_index.find(phys_numrecord);
+	return it == ch_rec_index.end() ? nullptr : it->second;
+}
+
+void Table::remove_changed_record(changed_rec *cr)
 {
-	ch_rec = value;
+	if(cr->prev) cr->prev->next = cr->next;
+	else ch_rec = cr->next;
+	if(cr->next) cr->next->prev = cr->prev;
+	else ch_rec_last = cr->prev;
+	ch_rec_index.erase(cr->numrec);
+	delete cr;
+}
+
+void Table::clear_changed_records()
+{
+	changed_rec* cr;
+	changed_rec* cr2;
+	for(cr = ch_rec; cr;)
+	{
+		cr2 = cr->next;
+		delete cr;
+		cr = cr2;
+	}
+	ch_rec = nullptr;
+	ch_rec_last = nullptr;
+	ch_rec_index.clear();
 }
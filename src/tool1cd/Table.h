@@ -29,10 +29,19 @@
 #include "Class_1CD.h"
 #include "TableRecord.h"
 
+#include <unordered_map>
+#include <unordered_set>
+
 static const uint32_t BLOB_RECORD_LEN = 256;
 static const uint32_t BLOB_RECORD_DATA_LEN = 250;
+static const uint32_t BATCH_FLUSH_SIZE = 0x100000; // объем накопленных данных пакетного добавления, после которого они пишутся в файл
+static const uint32_t XML_EXPORT_CHUNK_RECORDS = 0x1000; // количество записей в одной порции параллельной выгрузки в XML
+static const uint32_t BLOB_FILE_QUEUE_PER_THREAD = 64; // количество ожидающих заданий записи blob в файлы на один поток
 
 class Index;
+class BufferedWriter;
+class ExportCheckpoint;
+class RecordDecoder;
 
 enum table_info
 {
@@ -43,6 +52,22 @@ enum table_info
 	ti_logical_view
 };
 
+// форматы текстовой выгрузки таблицы
+enum class text_format
+{
+	csv,  // значения через запятую (RFC 4180)
+	tsv,  // значения через табуляцию, спецсимволы экранируются обратной косой чертой
+	jsonl // каждая запись - объект JSON в отдельной строке
+};
+
+// способы выгрузки blob-полей (image) в текстовые форматы
+enum class blob_export
+{
+	base64, // значение поля в base64 одной строкой
+	file,   // в отдельный файл, значение поля - имя файла
+	skip    // поле не выгружается
+};
+
 // типы измененных записей
 enum class changed_rec_type
 {
@@ -65,7 +90,8 @@ public:
 	// тип изменения записи (изменена, добавлена, удалена)
 	changed_rec_type changed_type;
 
-	// следующая измененная запись в списке измененных записей
+	// предыдущая и следующая измененные записи в списке измененных записей (в порядке добавления)
+	changed_rec* prev;
 	changed_rec* next;
 
 	// массив признаков изменения поля (по одному байту на каждое поле, всего num_fields байт)
@@ -142,7 +168,20 @@ public:
 	TStream* readBlob(TStream* _str, uint32_t _startblock, uint32_t _length, bool rewrite = true) const;
 	uint32_t readBlob(void* _buf, uint32_t _startblock, uint32_t _length) const;
 	void set_lock_inmemory(bool _lock);
-	bool export_to_xml(const std::string &filename, bool blob_to_file, bool unpack) const;
+	// checkpoint - состояние для продолжения прерванной выгрузки (ExportCheckpoint.h);
+	// base_copies - экземпляры базы для чтения из нескольких потоков, недостающие открываются и добавляются в набор.
+	// Один набор передается в выгрузку всех таблиц, чтобы база не открывалась заново для каждой таблицы
+	bool export_to_xml(const std::string &filename, bool blob_to_file, bool unpack, uint32_t threads = 1, ExportCheckpoint *checkpoint = nullptr,
+					   std::vector<std::unique_ptr<T_1CD>> *base_copies = nullptr) const;
+	// выгрузка в CSV, TSV или JSON Lines; при пустом export_fields выгружаются все поля
+	bool export_to_text(const std::string &filename, text_format format, const std::vector<Field*> &export_fields, blob_export blob_mode, bool unpack,
+						ExportCheckpoint *checkpoint = nullptr) const;
+	// выгрузка записей, добавленных, измененных и удаленных с момента выгрузки, сохранившей манифест manifest_filename;
+	// манифест перезаписывается текущим состоянием таблицы
+	bool export_changes(const std::string &filename, const std::string &manifest_filename, text_format format,
+						const std::vector<Field*> &export_fields, blob_export blob_mode, bool unpack) const;
+	// выгрузка в колоночный формат (ColumnarFormat.h); при пустом export_fields выгружаются все поля
+	bool export_to_columnar(const std::string &filename, const std::vector<Field*> &export_fields, bool skip_blobs) const;
 
 	V8Object* get_file_data() const;
 	void set_file_data(V8Object *value);
@@ -172,12 +211,19 @@ public:
 	void restore_edit_value(uint32_t phys_numrecord, int32_t numfield);
 	void set_rec_type(uint32_t phys_numrecord, changed_rec_type crt);
 
-	void export_table(const boost::filesystem::path &path) const;
+	void export_table(const boost::filesystem::path &path, bool compress = false) const; // compress - файлы объектов сжимаются в gzip (<файл>.gz)
 	void import_table(const boost::filesystem::path &path);
 
 	void delete_record(uint32_t phys_numrecord); // удаление записи
 	void insert_record(const TableRecord *rec); // добавление записи
 	void update_record(uint32_t phys_numrecord, char* rec, char* changed_fields); // изменение записи
+
+	// пакетное добавление записей: данные и blob дописываются в конец файлов одним блоком,
+	// индексы записываются разом в end_insert_batch. Запись с неуникальным первичным индексом в пакет не попадает (исключение),
+	// cancel_edit и ошибка в end_insert_batch отменяют пакет целиком
+	void begin_insert_batch(uint32_t expected_records = 0); // expected_records - сколько записей зарезервировать заранее
+	void insert_batch_record(const TableRecord *rec); // добавление записи в пакет (поля blob содержат TStream*, как в insert_record)
+	void end_insert_batch(); // запись пакета и индексов
 	char* get_record_template_test();
 
 	Field* get_field(const std::string &fieldname) const;
@@ -194,7 +240,7 @@ public:
 	bool is_bad() const;
 
 	changed_rec* get_changed_record();
-	void set_changed_record(changed_rec *value);
+	void add_changed_record(changed_rec *value); // добавляет запись в конец списка измененных записей
 
 private:
 	T_1CD* base;
@@ -217,7 +263,13 @@ private:
 	void delete_fields();
 	void delete_indexes();
 
+	changed_rec* find_changed_record(uint32_t phys_numrecord) const; // поиск измененной записи по физическому номеру
+	void remove_changed_record(changed_rec *cr); // исключение измененной записи из списка и ее удаление
+	void clear_changed_records(); // удаление всех измененных записей
+
 	changed_rec* ch_rec; // первая измененная запись в списке измененных записей
+	changed_rec* ch_rec_last; // последняя измененная запись в списке измененных записей
+	std::unordered_map<uint32_t, changed_rec*> ch_rec_index; // измененные записи по физическому номеру
 	uint32_t added_numrecords; // количество добавленных записей в режиме редактирования
 
 	uint32_t phys_numrecords; // физическое количество записей (вместе с удаленными)
@@ -230,6 +282,24 @@ private:
 
 	bool edit; // признак, что таблица находится в режиме редактирования
 
+	bool insert_batch; // признак пакетного добавления записей
+	uint32_t batch_numrecords; // количество записей в пакете
+	uint32_t batch_next_record; // физический номер следующей добавляемой записи пакета
+	uint64_t batch_data_offset; // смещение в файле data начала batch_data
+	std::vector<char> batch_data; // еще не записанные записи пакета
+	uint32_t batch_next_blob; // номер следующего блока blob пакета
+	uint64_t batch_blob_offset; // смещение в файле blob начала batch_blob
+	std::vector<char> batch_blob; // еще не записанные блоки blob пакета
+	std::vector<std::vector<char>> batch_index; // распакованные записи индексов пакета (по одному массиву на индекс)
+	std::vector<std::unordered_set<std::string>> batch_keys; // значения первичных индексов пакета (для проверки уникальности)
+	uint64_t batch_start_data_len; // длина файла data до начала пакета
+	uint64_t batch_start_blob_len; // длина файла blob до начала пакета
+
+	void flush_insert_batch(); // запись накопленных данных пакета в файлы data и blob
+	uint32_t write_batch_blob(TStream* bstr); // размещение blob в пакете, возвращает индекс первого блока
+	void check_batch_unique(const TableRecord *rec); // проверка уникальности первичных индексов записи пакета
+	void discard_insert_batch(); // отмена пакета: возврат файлов data и blob к длине до начала пакета
+
 	void delete_data_record(uint32_t phys_numrecord); // удаление записи из файла data
 	void delete_blob_record(uint32_t blob_numrecord); // удаление записи из файла blob
 	void delete_index_record(uint32_t phys_numrecord); // удаление всех индексов записи из файла index
@@ -239,6 +309,11 @@ private:
 	uint32_t write_blob_record(TStream* bstr); //  // записывает НОВУЮ запись в файл blob, возвращает индекс новой записи
 	void write_index_record(const uint32_t phys_numrecord, const TableRecord *rec); // запись индексов записи в файл index
 
+	void append_record_xml(std::string &out, const TableRecord *rec, const RecordDecoder &decoder) const; // XML-представление записи (без выгрузки blob в файлы), decoder построен по fields
+	void export_records_to_xml(BufferedWriter &f, const std::vector<uint32_t> &numrecs, const std::vector<Table*> &tables, const std::string &status,
+							   ExportCheckpoint *checkpoint, const std::string &filename, uint32_t first) const; // параллельная выгрузка записей в XML, по потоку на экземпляр таблицы
+	std::vector<Table*> open_base_copies(std::vector<std::unique_ptr<T_1CD>> &bases, uint32_t count) const; // эта таблица в count экземплярах базы для параллельного чтения, недостающие экземпляры открываются
+
 	bool bad {false}; // признак битой таблицы
 };
 
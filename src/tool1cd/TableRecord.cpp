@@ -79,6 +79,14 @@ std::string TableRecord::get_string(const std::string &field_name) const
 	return get_string(table->get_field(field_name));
 }
 
+void TableRecord::append_string(std::string &out, const Field *field) const
+{
+	if (is_null_value(field)) {
+		throw NullValueException(field);
+	}
+	field->append_presentation(out, data);
+}
+
 bool TableRecord::is_null_value(const Field *field) const
 {
 	if (!field->get_null_exists()) {
@@ -150,11 +158,13 @@ void TableRecord::set_null(const Field *field)
 void TableRecord::set_data(const Field *field, const void *new_data)
 {
 	char *data_start = &data[field->get_offset()];
+	int32_t size = field->get_size();
 	if (field->get_null_exists()) {
 		data_start[0] = '\001';
 		data_start++;
+		size--;
 	}
-	memcpy(data_start, new_data, field->get_size());
+	memcpy(data_start, new_data, size);
 }
 
 std::string TableRecord::get_xml_string(const Field *field) const
@@ -170,6 +180,22 @@ std::string TableRecord::get_xml_string(const std::string &field_name) const
 	return get_xml_string(table->get_field(field_name));
 }
 
+void TableRecord::append_xml_string(std::string &out, const Field *field) const
+{
+	if (is_null_value(field)) {
+		throw NullValueException(field);
+	}
+	field->append_XML_presentation(out, data);
+}
+
+void TableRecord::append_text_string(std::string &out, const Field *field) const
+{
+	if (is_null_value(field)) {
+		throw NullValueException(field);
+	}
+	field->append_text_presentation(out, data);
+}
+
 bool TableRecord::try_store_blob_data(const Field *field, TStream *&out, bool inflate_stream) const
 {
 	if (is_null_value(field)) {
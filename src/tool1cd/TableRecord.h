@@ -69,6 +69,9 @@ public:
 
 	std::string get_xml_string(const Field *field) const;
 	std::string get_xml_string(const std::string &field_name) const;
+	void append_string(std::string &out, const Field *field) const; // дописывает представление поля в конец out
+	void append_xml_string(std::string &out, const Field *field) const; // дописывает XML-представление поля в конец out
+	void append_text_string(std::string &out, const Field *field) const; // дописывает значение поля без экранирования в конец out
 
 	bool is_null_value(const Field *field) const;
 	bool is_null_value(const std::string &field_name) const;
@@ -118,6 +121,7 @@ public:
 	void Assign(const TableRecord *another_record);
 
 	const Table *get_table() const { return table; }
+	const char *get_record_data() const { return data; } // запись целиком, recordlen байт
 
 	bool try_store_blob_data(const Field *field, TStream* &out, bool inflate_stream = false) const;
 
@@ -20,6 +20,7 @@
 */
 #include "TempStream.h"
 #include <boost/filesystem.hpp>
+#include <mutex>
 //---------------------------------------------------------------------------
 #if !defined(_WIN32)
 #pragma package(smart_init)
@@ -76,8 +77,12 @@ TTempStream::~TTempStream()
 
 std::string TTempStream::get_temp_name()
 {
-	if (tempcat.empty()) {
-		DelayedInitTempPath();
+	static std::mutex init_lock;
+	{
+		std::lock_guard<std::mutex> lock(init_lock);
+		if (tempcat.empty()) {
+			DelayedInitTempPath();
+		}
 	}
 	return (tempcat / boost::filesystem::unique_path()).string();
 }
@@ -0,0 +1,287 @@
+/*
+    Tool1CD library provides access to 1CD database files.
+    Copyright © 2009-2017 awa
+    Copyright © 2017-2018 E8 Tools contributors
+
+    This file is part of Tool1CD Library.
+
+    Tool1CD Library is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Tool1CD Library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with Tool1CD Library.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <cstring>
+
+#include "TreeReader.h"
+#include "Parse_tree.h"
+#include "Common.h"
+#include "DetailedException.h"
+#include "MessageRegistration.h"
+
+using namespace std;
+
+extern Registrator msreg_g;
+
+const size_t TREE_READER_BLOCK_SIZE = 0x10000; // размер блока чтения потока
+
+//---------------------------------------------------------------------------
+TreeReader::TreeReader(TStream *stream, const string &path)
+	: stream(stream), path(path), buffer(TREE_READER_BLOCK_SIZE), p(nullptr), end(nullptr), eof(false)
+{
+}
+
+//---------------------------------------------------------------------------
+TreeReader::TreeReader(const string &text, const string &path)
+	: stream(nullptr), path(path), p(text.data()), end(text.data() + text.size()), eof(true)
+{
+}
+
+//---------------------------------------------------------------------------
+bool TreeReader::fill()
+{
+	if(eof) return false;
+
+	int64_t read = stream->Read(buffer.data(), buffer.size());
+	if(read <= 0)
+	{
+		eof = true;
+		return false;
+	}
+	p = buffer.data();
+	end = p + read;
+
+	const char *zero = static_cast<const char*>(memchr(p, '\0', read));
+	if(zero)
+	{
+		end = zero;
+		eof = true;
+	}
+	return p != end;
+}
+
+//---------------------------------------------------------------------------
+tree_event TreeReader::value_event(node_type _type)
+{
+	type = _type;
+	has_items = true;
+	return tree_event::value;
+}
+
+//---------------------------------------------------------------------------
+tree_event TreeReader::close_list()
+{
+	if(level == 0)
+	{
+		throw DetailedException("Ошибка формата потока. Лишняя закрывающая скобка }.")
+			.add_detail("Путь", path);
+	}
+	level--;
+	has_items = true;
+	expect_delimiter = true;
+	type = node_type::nd_list;
+	value.clear();
+	return tree_event::list_end;
+}
+
+//---------------------------------------------------------------------------
+// p - после открывающей кавычки
+void TreeReader::read_string()
+{
+	value.clear();
+	while(true)
+	{
+		if(p == end && !fill())
+		{
+			throw DetailedException("Ошибка формата потока. Незавершенное значение")
+				.add_detail("Путь", path);
+		}
+		const char *quote = static_cast<const char*>(memchr(p, '"', end - p));
+		if(!quote)
+		{
+			value.append(p, end);
+			p = end;
+			continue;
+		}
+		value.append(p, quote);
+		p = quote + 1;
+		if(p == end && !fill()) return;
+		if(*p != '"') return;
+		value.push_back('"');
+		++p;
+	}
+}
+
+//---------------------------------------------------------------------------
+// значение до запятой или закрывающей скобки
+void TreeReader::read_nonstring()
+{
+	value.clear();
+	while(true)
+	{
+		const char *e = p;
+		while(e != end && *e != ',' && *e != '}') ++e;
+		value.append(p, e);
+		p = e;
+		if(p != end) break;
+		if(!fill())
+		{
+			type = classification_value(value);
+			if(type == node_type::nd_unknown)
+			{
+				msreg_g.AddError("Ошибка формата потока. Неизвестный тип значения.")
+					.with("Значение", value)
+					.with("Путь", path);
+			}
+			return;
+		}
+	}
+
+	type = classification_value(value);
+	if(type == node_type::nd_unknown)
+	{
+		throw DetailedException("Ошибка формата потока. Неизвестный тип значения.")
+			.add_detail("Значение", value)
+			.add_detail("Путь", path);
+	}
+}
+
+//---------------------------------------------------------------------------
+tree_event TreeReader::next()
+{
+	while(true)
+	{
+		if(p == end && !fill())
+		{
+			if(!expect_delimiter)
+			{
+				throw DetailedException("Ошибка формата потока. Незавершенное значение")
+					.add_detail("Путь", path);
+			}
+			if(level)
+			{
+				throw DetailedException("Ошибка формата потока. Не хватает закрывающих скобок } в конце текста разбора.")
+					.add_detail("Путь", path);
+			}
+			return tree_event::end;
+		}
+
+		char sym = *p;
+		if(expect_delimiter)
+		{
+			switch(sym)
+			{
+				case ' ': // space
+				case '\t':
+				case '\r':
+				case '\n':
+					++p;
+					break;
+				case ',':
+					++p;
+					expect_delimiter = false;
+					break;
+				case '}':
+					++p;
+					return close_list();
+				default:
+					throw DetailedException("Ошибка формата потока. Ошибочный символ в режиме ожидания разделителя.")
+						.add_detail("Символ", string(1, sym))
+						.add_detail("Код символа", to_hex_string(sym))
+						.add_detail("Путь", path);
+			}
+			continue;
+		}
+
+		switch(sym)
+		{
+			case ' ': // space
+			case '\t':
+			case '\r':
+			case '\n':
+				++p;
+				break;
+			case '"':
+				++p;
+				read_string();
+				expect_delimiter = true;
+				return value_event(node_type::nd_string);
+			case '{':
+				++p;
+				level++;
+				has_items = false;
+				type = node_type::nd_list;
+				value.clear();
+				return tree_event::list_begin;
+			case '}':
+				if(has_items)
+				{
+					// пустое значение после последней запятой, скобка закроет список при следующем вызове
+					value.clear();
+					expect_delimiter = true;
+					return value_event(node_type::nd_empty);
+				}
+				++p;
+				return close_list();
+			case ',':
+				++p;
+				value.clear();
+				return value_event(node_type::nd_empty);
+			default:
+				read_nonstring();
+				expect_delimiter = true;
+				return value_event(type);
+		}
+	}
+}
+
+//---------------------------------------------------------------------------
+void TreeReader::skip()
+{
+	int skip_level = level;
+	while(level >= skip_level)
+	{
+		if(next() == tree_event::end) return;
+	}
+}
+
+//---------------------------------------------------------------------------
+bool TreeReader::skip_item()
+{
+	switch(next())
+	{
+		case tree_event::list_begin:
+			skip();
+			return true;
+		case tree_event::value:
+			return true;
+		default:
+			return false;
+	}
+}
+
+//---------------------------------------------------------------------------
+node_type TreeReader::get_type() const
+{
+	return type;
+}
+
+//---------------------------------------------------------------------------
+const string &TreeReader::get_value() const
+{
+	return value;
+}
+
+//---------------------------------------------------------------------------
+int TreeReader::get_level() const
+{
+	return level;
+}
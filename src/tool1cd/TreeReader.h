@@ -0,0 +1,80 @@
+/*
+    Tool1CD library provides access to 1CD database files.
+    Copyright © 2009-2017 awa
+    Copyright © 2017-2018 E8 Tools contributors
+
+    This file is part of Tool1CD Library.
+
+    Tool1CD Library is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Tool1CD Library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with Tool1CD Library.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef TOOL1CD_PROJECT_TREEREADER_H
+#define TOOL1CD_PROJECT_TREEREADER_H
+
+#include <string>
+#include <vector>
+
+#include "NodeTypes.h"
+#include "SystemClasses/TStream.hpp"
+
+enum class tree_event {
+	list_begin, // открывающая скобка {
+	list_end,   // закрывающая скобка }
+	value,      // значение, в том числе пустое
+	end         // конец текста
+};
+
+// Последовательный разбор скобочного текста 1С без построения дерева.
+// Грамматика и ошибки формата те же, что у parse_1Ctext / parse_1Cstream, но проверяется
+// только прочитанная часть текста. Поток читается блоками, текст потока заканчивается на нулевом символе
+class TreeReader
+{
+public:
+	TreeReader(TStream *stream, const std::string &path);
+	TreeReader(const std::string &text, const std::string &path); // текст должен жить дольше TreeReader
+	TreeReader(std::string &&text, const std::string &path) = delete;
+
+	TreeReader(const TreeReader &) = delete;
+	TreeReader &operator=(const TreeReader &) = delete;
+
+	tree_event next();
+	void skip();      // пропускает остаток текущего списка вместе с его закрывающей скобкой
+	bool skip_item(); // пропускает следующий элемент текущего списка, false - список закончился
+
+	node_type get_type() const;            // тип значения или nd_list для начала списка
+	const std::string &get_value() const;  // значение события value
+	int get_level() const;                 // уровень вложенности текущего списка
+
+private:
+	TStream *stream;
+	std::string path;
+	std::vector<char> buffer;
+	const char *p;
+	const char *end;
+	bool eof;
+
+	int level {0};
+	bool has_items {false};        // в текущем списке уже были элементы
+	bool expect_delimiter {false}; // ожидание разделителя после значения
+	node_type type {node_type::nd_empty};
+	std::string value;
+
+	bool fill();
+	tree_event value_event(node_type _type);
+	tree_event close_list();
+	void read_string();
+	void read_nonstring();
+};
+
+#endif //TOOL1CD_PROJECT_TREEREADER_H
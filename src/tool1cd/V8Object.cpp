@@ -23,11 +23,15 @@
 #include "Common.h"
 #include "Constants.h"
 #include "DetailedException.h"
+#include "GzipStream.h"
+#include "SystemClasses/String.hpp"
 
 using namespace std;
+using namespace System;
 
 V8Object* V8Object::first = nullptr;
 V8Object* V8Object::last = nullptr;
+std::mutex V8Object::objects_lock;
 
 extern Registrator msreg_g;
 
@@ -35,6 +39,7 @@ extern Registrator msreg_g;
 void V8Object::garbage()
 {
 	uint32_t curt = GetTickCount();
+	std::lock_guard<std::mutex> lock(objects_lock);
 	V8Object* ob = first;
 
 	while(ob)
@@ -71,6 +76,8 @@ void V8Object::init()
 	lockinmemory = false;
 	type = v8objtype::unknown;
 	fatlevel = 0;
+	free_map_built = false;
+	free_map_hint = 0;
 }
 
 //---------------------------------------------------------------------------
@@ -79,11 +86,14 @@ void V8Object::init(T_1CD* _base, int32_t blockNum)
 	base = _base;
 	lockinmemory = false;
 
-	prev = last;
-	next = nullptr;
-	if(last) last->next = this;
-	else first = this;
-	last = this;
+	{
+		std::lock_guard<std::mutex> lock(objects_lock);
+		prev = last;
+		next = nullptr;
+		if(last) last->next = this;
+		else first = this;
+		last = this;
+	}
 
 	if(blockNum == 1)
 	{
@@ -299,6 +309,7 @@ V8Object::~V8Object()
 {
 	delete[] data;
 
+	std::lock_guard<std::mutex> lock(objects_lock);
 	if(prev) prev->next = next;
 	else first = next;
 	if(next) next->prev = prev;
@@ -566,10 +577,19 @@ uint64_t V8Object::get_len() const
 }
 
 //---------------------------------------------------------------------------
+// Несжатый файл копируется по участкам файла базы средствами ОС, минуя кеш страниц
 void V8Object::savetofile(const boost::filesystem::path &path)
 {
+	vector<file_extent> extents;
+	if(!EqualIC(path.extension().string(), ".gz") && get_file_extents(extents))
+	{
+		// измененные страницы должны попасть в файл базы до копирования
+		if(!base->get_readonly()) base->flush();
+		if(copy_file_extents(base->get_filepath(), extents, path)) return;
+	}
+
 	uint64_t pagesize = base->get_pagesize();
-	TFileStream fs(path, fmCreate);
+	unique_ptr<TStream> fs(create_export_stream(path));
 	char *buf = new char[pagesize];
 	uint64_t total_size = get_len();
 	uint64_t remain_size = total_size;
@@ -577,10 +597,48 @@ void V8Object::savetofile(const boost::filesystem::path &path)
 	{
 		unsigned size_of_block = std::min(remain_size, pagesize);
 		get_data(buf, offset, size_of_block);
-		fs.Write(buf, size_of_block);
+		fs->Write(buf, size_of_block);
 		remain_size -= pagesize;
 	}
 	delete[] buf;
+	fs->Close();
+}
+
+//---------------------------------------------------------------------------
+bool V8Object::get_file_extents(vector<file_extent> &extents)
+{
+	extents.clear();
+	if(type != v8objtype::data80 && type != v8objtype::data838) return false;
+
+	uint64_t pagesize = type == v8objtype::data80 ? DEFAULT_PAGE_SIZE : base->get_pagesize();
+	uint64_t numpages = (len + pagesize - 1) / pagesize;
+	uint32_t offsperpage = type == v8objtype::data80 ? 1023 : pagesize / 4;
+	bool indirect = type == v8objtype::data80 || fatlevel;
+
+	const uint32_t *tab = nullptr;
+	uint64_t rest = len;
+	for(uint64_t i = 0; i < numpages; i++)
+	{
+		uint32_t page;
+		if(indirect)
+		{
+			if(i % offsperpage == 0)
+			{
+				char *b = base->get_block(blocks[i / offsperpage]);
+				if(!b) return false;
+				tab = type == v8objtype::data80 ? ((objtab*)b)->blocks : ((objtab838*)b)->blocks;
+			}
+			page = tab[i % offsperpage];
+		}
+		else page = blocks[i];
+
+		uint64_t offset = page * pagesize;
+		uint64_t length = std::min(rest, pagesize);
+		rest -= length;
+		if(!extents.empty() && extents.back().offset + extents.back().length == offset) extents.back().length += length;
+		else extents.push_back({offset, length});
+	}
+	return true;
 }
 
 //---------------------------------------------------------------------------
@@ -1096,6 +1154,8 @@ void V8Object::set_len(uint64_t _len)
 		{
 			objtab *ot;
 			// Увеличение длины объекта
+			// страницы данных берем одним непрерывным диапазоном, чтобы объект лежал в файле последовательно
+			uint32_t extent = base->get_free_extent(num_data_blocks - cur_data_blocks);
 			if(numblocks) ot = (objtab*)base->get_block_for_write(b->blocks[numblocks - 1], true);
 			for(; cur_data_blocks < num_data_blocks; cur_data_blocks++)
 			{
@@ -1107,7 +1167,7 @@ void V8Object::set_len(uint64_t _len)
 					ot = (objtab*)base->get_block_for_write(bl, false);
 					ot->numblocks = 0;
 				}
-				bl = base->get_free_block();
+				bl = extent++;
 				base->get_block_for_write(bl, false); // получаем блок без чтения, на случай, если блок вдруг в конце файла
 				ot->blocks[i] = bl;
 				ot->numblocks = i + 1;
@@ -1117,7 +1177,7 @@ void V8Object::set_len(uint64_t _len)
 		{
 			// Уменьшение длины объекта
 			objtab *ot = (objtab*)base->get_block_for_write(b->blocks[numblocks - 1], true);
-			for(cur_data_blocks--; cur_data_blocks >= num_data_blocks; cur_data_blocks--)
+			while(cur_data_blocks-- > num_data_blocks)
 			{
 				i = cur_data_blocks % 1023;
 				base->set_block_as_free(ot->blocks[i]);
@@ -1136,7 +1196,7 @@ void V8Object::set_len(uint64_t _len)
 		len = _len;
 		if(numblocks > 0) {
 			std::copy(std::begin(b->blocks),
-					  std::begin(b->blocks) + (numblocks * 4),
+					  std::begin(b->blocks) + numblocks,
 					  blocks.begin());
 		}
 
@@ -1179,6 +1239,8 @@ void V8Object::set_len(uint64_t _len)
 		if(num_data_blocks > cur_data_blocks)
 		{
 			// Увеличение длины объекта
+			// страницы данных берем одним непрерывным диапазоном, чтобы объект лежал в файле последовательно
+			uint32_t extent = base->get_free_extent(num_data_blocks - cur_data_blocks);
 			if(fatlevel == 0 && newfatlevel)
 			{
 				bl = base->get_free_block();
@@ -1189,7 +1251,7 @@ void V8Object::set_len(uint64_t _len)
 				bd->blocks[0] = bl;
 				numblocks = 1;
 			}
-			else bb = (objtab838*)base->get_block_for_write(bd->blocks[numblocks - 1], true);
+			else if(fatlevel) bb = (objtab838*)base->get_block_for_write(bd->blocks[numblocks - 1], true);
 
 			if(fatlevel)
 			{
@@ -1202,7 +1264,7 @@ void V8Object::set_len(uint64_t _len)
 						bd->blocks[numblocks++] = bl;
 						bb = (objtab838*)base->get_block_for_write(bl, false);
 					}
-					bl = base->get_free_block();
+					bl = extent++;
 					base->get_block_for_write(bl, false); // получаем блок без чтения, на случай, если блок вдруг в конце файла
 					bb->blocks[i] = bl;
 				}
@@ -1211,10 +1273,11 @@ void V8Object::set_len(uint64_t _len)
 			{
 				for(; cur_data_blocks < num_data_blocks; cur_data_blocks++)
 				{
-					bl = base->get_free_block();
+					bl = extent++;
 					base->get_block_for_write(bl, false); // получаем блок без чтения, на случай, если блок вдруг в конце файла
 					bd->blocks[cur_data_blocks] = bl;
 				}
+				numblocks = num_data_blocks;
 			}
 		}
 		else if(num_data_blocks < cur_data_blocks)
@@ -1222,8 +1285,8 @@ void V8Object::set_len(uint64_t _len)
 			// Уменьшение длины объекта
 			if(fatlevel)
 			{
-				bb = (objtab838*)base->get_block_for_write(b->blocks[numblocks - 1], true);
-				for(cur_data_blocks--; cur_data_blocks >= num_data_blocks; cur_data_blocks--)
+				bb = (objtab838*)base->get_block_for_write(bd->blocks[numblocks - 1], true);
+				while(cur_data_blocks-- > num_data_blocks)
 				{
 					i = cur_data_blocks % offsperpage;
 					base->set_block_as_free(bb->blocks[i]);
@@ -1232,13 +1295,13 @@ void V8Object::set_len(uint64_t _len)
 					{
 						base->set_block_as_free(bd->blocks[--numblocks]);
 						bd->blocks[numblocks] = 0;
-						if(numblocks) bb = (objtab838*)base->get_block_for_write(b->blocks[numblocks - 1], true);
+						if(numblocks) bb = (objtab838*)base->get_block_for_write(bd->blocks[numblocks - 1], true);
 					}
 				}
 			}
 			else
 			{
-				for(cur_data_blocks--; cur_data_blocks >= num_data_blocks; cur_data_blocks--)
+				while(cur_data_blocks-- > num_data_blocks)
 				{
 					base->set_block_as_free(bd->blocks[cur_data_blocks]);
 					bd->blocks[cur_data_blocks] = 0;
@@ -1263,7 +1326,7 @@ void V8Object::set_len(uint64_t _len)
 		len = _len;
 		if(numblocks > 0) {
 			std::copy(std::begin(bd->blocks),
-					  std::begin(bd->blocks) + (numblocks * 4),
+					  std::begin(bd->blocks) + numblocks,
 					  blocks.begin());
 		}
 
@@ -1281,6 +1344,10 @@ void V8Object::set_block_as_free(uint32_t block_number)
 			.add_detail("Блок объекта", block);
 	}
 
+	// Структура файла свободных страниц 8.3.8 не известна (в заголовке нет поля len),
+	// запись в него портит заголовок, поэтому освобождаемая страница просто не учитывается
+	if(type == v8objtype::free838) return;
+
 	uint32_t j = len >> 10; // length / 1024
 	int32_t i = len & 0x3ff; // length % 1024
 
@@ -1293,6 +1360,13 @@ void V8Object::set_block_as_free(uint32_t block_number)
 		uint32_t *b = (uint32_t*)base->get_block_for_write(blocks[j], true);
 		b[i] = block_number;
 		if(numblocks <= j) numblocks = j + 1;
+		if(free_map_built)
+		{
+			if(block_number >= free_map.size()) free_map.resize(block_number + 1);
+			free_map[block_number] = true;
+			free_positions[block_number] = len - 1;
+			if(block_number < free_map_hint) free_map_hint = block_number;
+		}
 	}
 	else
 	{
@@ -1301,7 +1375,7 @@ void V8Object::set_block_as_free(uint32_t block_number)
 		real_numblocks++;
 		blocks.resize(real_numblocks);
 		std::copy(std::begin(ob->blocks),
-				  std::begin(ob->blocks) + (real_numblocks * 4),
+				  std::begin(ob->blocks) + real_numblocks,
 				  blocks.begin());
 	}
 
@@ -1327,6 +1401,11 @@ uint32_t V8Object::get_free_block()
 		b[i] = 0;
 		v8ob *ob = (v8ob*)base->get_block_for_write(block, true);
 		ob->len = len;
+		if(free_map_built)
+		{
+			if(k < free_map.size()) free_map[k] = false;
+			free_positions.erase(k);
+		}
 		return k;
 	}
 	else
@@ -1339,6 +1418,105 @@ uint32_t V8Object::get_free_block()
 
 }
 
+//---------------------------------------------------------------------------
+uint32_t V8Object::get_free_extent(uint32_t count)
+{
+	if(block != 1)
+	{
+		// Таблица свободных блоков
+		throw DetailedException("Попытка получения свободного блока в объекте, не являющимся таблицей свободных блоков")
+			.add_detail("Блок объекта", block);
+	}
+
+	if(count == 0) return 0;
+	if(count == 1) return get_free_block();
+
+	build_free_map();
+
+	// первый подходящий диапазон свободных блоков
+	uint32_t size = free_map.size();
+	uint32_t first = free_map_hint;
+	while(first < size && !free_map[first]) first++;
+	free_map_hint = first;
+
+	uint32_t run = 0;
+	for(uint32_t i = first; i < size; i++)
+	{
+		if(!free_map[i])
+		{
+			run = 0;
+			continue;
+		}
+		if(++run == count)
+		{
+			uint32_t start = i + 1 - count;
+			for(uint32_t k = start; k <= i; k++) remove_free_entry(k);
+			return start;
+		}
+	}
+
+	// подходящего диапазона нет - добавляем блоки в конец файла
+	uint32_t start = base->getMemBlockManager().get_numblocks();
+	for(uint32_t k = 0; k < count; k++) base->get_block_for_write(start + k, false);
+	return start;
+}
+
+//---------------------------------------------------------------------------
+void V8Object::build_free_map()
+{
+	if(free_map_built) return;
+
+	free_map.assign(base->getMemBlockManager().get_numblocks(), false);
+	free_positions.clear();
+	free_positions.reserve(len);
+	for(uint32_t pos = 0; pos < len; pos++)
+	{
+		uint32_t k = get_free_entry(pos);
+		if(k >= free_map.size()) free_map.resize(k + 1);
+		free_map[k] = true;
+		free_positions[k] = pos;
+	}
+	free_map_hint = 0;
+	free_map_built = true;
+}
+
+//---------------------------------------------------------------------------
+uint32_t V8Object::get_free_entry(uint32_t pos) const
+{
+	uint32_t *b = (uint32_t*)base->get_block(blocks[pos >> 10]);
+	return b[pos & 0x3ff];
+}
+
+//---------------------------------------------------------------------------
+void V8Object::set_free_entry(uint32_t pos, uint32_t value)
+{
+	uint32_t *b = (uint32_t*)base->get_block_for_write(blocks[pos >> 10], true);
+	b[pos & 0x3ff] = value;
+}
+
+//---------------------------------------------------------------------------
+void V8Object::remove_free_entry(uint32_t block_number)
+{
+	auto it = free_positions.find(block_number);
+	if(it == free_positions.end()) return;
+
+	// на место исключаемого блока переносим последний блок таблицы
+	uint32_t pos = it->second;
+	free_positions.erase(it);
+	len--;
+	if(pos != len)
+	{
+		uint32_t last_block = get_free_entry(len);
+		set_free_entry(pos, last_block);
+		free_positions[last_block] = pos;
+	}
+	set_free_entry(len, 0);
+	free_map[block_number] = false;
+
+	v8ob *ob = (v8ob*)base->get_block_for_write(block, true);
+	ob->len = len;
+}
+
 //---------------------------------------------------------------------------
 void V8Object::get_version_rec_and_increase(_version* ver)
 {
@@ -1416,7 +1594,7 @@ uint32_t V8Object::get_block_number() const
 TStream* V8Object::readBlob(TStream* _str, uint32_t _startblock, uint32_t _length, bool rewrite)
 {
 	uint32_t _curblock;
-	char* _curb;
+	const char* _curb;
 	uint32_t _numblock;
 	uint32_t startlen;
 
@@ -1437,7 +1615,7 @@ TStream* V8Object::readBlob(TStream* _str, uint32_t _startblock, uint32_t _lengt
 			.add_detail("Длина файла", to_hex_string(len));
 	}
 
-	_curb = new char[0x100];
+	BlobPrefetcher prefetcher(this);
 	_curblock = _startblock;
 	while(_curblock)
 	{
@@ -1448,7 +1626,8 @@ TStream* V8Object::readBlob(TStream* _str, uint32_t _startblock, uint32_t _lengt
 				.add_detail("Всего блоков", _numblock)
 				.add_detail("Читаемый блок", _curblock);
 		}
-		get_data(_curb, _curblock << 8, 0x100);
+		uint64_t _readed = _str->GetSize() - startlen;
+		_curb = prefetcher.get_record(_curblock, _length == UINT_MAX ? UINT_MAX : (_readed < _length ? _length - _readed : 0));
 		_curblock = *(uint32_t*)_curb;
 		uint16_t _curlen = *(uint16_t*)(_curb + 4);
 		if(_curlen > 0xfa)
@@ -1462,7 +1641,6 @@ TStream* V8Object::readBlob(TStream* _str, uint32_t _startblock, uint32_t _lengt
 
 		if(_str->GetSize() - startlen > _length) break; // аварийный выход из возможного ошибочного зацикливания
 	}
-	delete[] _curb;
 
 	if(_length != UINT_MAX) if(_str->GetSize() - startlen != _length)
 	{
@@ -1475,6 +1653,47 @@ TStream* V8Object::readBlob(TStream* _str, uint32_t _startblock, uint32_t _lengt
 	return _str;
 }
 
+//---------------------------------------------------------------------------
+BlobPrefetcher::BlobPrefetcher(V8Object* _object)
+	: object(_object), first(0), count(0), hits(0), speculate(true)
+{
+	numblocks = object->get_len() >> 8;
+	records_per_page = object->base->get_pagesize() >> 8;
+	if(!records_per_page) records_per_page = 1;
+}
 
+//---------------------------------------------------------------------------
+const char* BlobPrefetcher::get_record(uint32_t _blocknum, uint32_t _remain)
+{
+	if(_blocknum >= first && _blocknum - first < count)
+	{
+		++hits;
+		return window.data() + ((_blocknum - first) << 8);
+	}
+
+	// окно из нескольких записей, из которого не пригодилось ничего, кроме первой, -
+	// цепочка фрагментирована, следующую запись читаем одну
+	speculate = count <= 1 || hits > 0;
+
+	uint32_t _count = 1;
+	if(speculate)
+	{
+		// до конца текущей страницы и вся следующая страница
+		_count = records_per_page - _blocknum % records_per_page + records_per_page;
+		if(_remain != UINT_MAX)
+		{
+			uint32_t _expected = _remain / 0xfa + 1;
+			if(_expected < _count) _count = _expected;
+		}
+	}
+	if(_count > numblocks - _blocknum) _count = numblocks - _blocknum;
+	if(_count == 0) _count = 1;
 
+	window.resize(static_cast<size_t>(_count) << 8);
+	object->get_data(window.data(), static_cast<uint64_t>(_blocknum) << 8, static_cast<uint64_t>(_count) << 8);
+	first = _blocknum;
+	count = _count;
+	hits = 0;
 
+	return window.data();
+}
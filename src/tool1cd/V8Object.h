@@ -23,10 +23,13 @@
 
 #include "SystemClasses/TStream.hpp"
 #include <climits>
+#include <unordered_map>
+#include <mutex>
 
 #include "MemBlock.h"
 #include "Class_1CD.h"
 #include "db_ver.h"
+#include "FileCopy.h"
 #include <boost/filesystem.hpp>
 
 #pragma pack(push)
@@ -95,6 +98,7 @@ enum class v8objtype
 };
 
 class V8Object {
+	friend class BlobPrefetcher;
 public:
 	V8Object(T_1CD* _base, int32_t blockNum); // конструктор существующего объекта
 	explicit V8Object(T_1CD* _base); // конструктор нового (еще не существующего) объекта
@@ -112,11 +116,13 @@ public:
 	bool set_data(TStream* stream, uint64_t _start, uint64_t _length); // запись части потока в объект, поддерживает кеширование блоков.
 
 	void savetofile(const boost::filesystem::path &path);
+	bool get_file_extents(std::vector<file_extent> &extents); // непрерывные участки файла базы с данными объекта, false - для файлов свободных страниц
 	void set_lockinmemory(bool _lock);
 	uint64_t get_fileoffset(uint64_t offset); // получить физическое смещение в файле по смещению в объекте
 
 	void set_block_as_free(uint32_t block_number); // пометить блок как свободный
 	uint32_t get_free_block(); // получить номер свободного блока (и пометить как занятый)
+	uint32_t get_free_extent(uint32_t count); // получить count свободных блоков подряд (и пометить как занятые), возвращает номер первого
 
 	void get_version_rec_and_increase(_version* ver); // получает версию очередной записи и увеличивает сохраненную версию объекта
 	void get_version(_version* ver); // получает сохраненную версию объекта
@@ -150,13 +156,46 @@ private:
 
 	static V8Object* first;
 	static V8Object* last;
+	static std::mutex objects_lock; // защита списка объектов при работе с базами из нескольких потоков
 	V8Object* next;
 	V8Object* prev;
 	uint32_t lastdataget; // время (Windows time, в миллисекундах) последнего обращения к данным объекта (data)
 	bool lockinmemory;
 
+	// Карта свободных блоков (только для таблицы свободных блоков). Строится один раз при первом запросе диапазона
+	bool free_map_built;
+	std::vector<bool> free_map; // признак свободного блока по номеру блока
+	std::unordered_map<uint32_t, uint32_t> free_positions; // номер блока -> позиция в таблице свободных блоков
+	uint32_t free_map_hint; // номер блока, с которого начинается поиск свободного диапазона
+
 	void init();
 	void init(T_1CD* _base, int32_t blockNum);
+
+	void build_free_map();
+	uint32_t get_free_entry(uint32_t pos) const; // номер блока в позиции pos таблицы свободных блоков
+	void set_free_entry(uint32_t pos, uint32_t value);
+	void remove_free_entry(uint32_t block_number); // исключить блок из таблицы свободных блоков
+};
+
+// Упреждающее чтение цепочки записей Blob (по 0x100 байт).
+// Цепочки обычно идут по возрастанию номеров, поэтому читаем сразу окно записей
+// до конца следующей страницы. Если очередная запись в окно не попала, окно перечитывается.
+class BlobPrefetcher {
+public:
+	explicit BlobPrefetcher(V8Object* _object);
+
+	// возвращает запись Blob номер _blocknum, _remain - сколько еще байт ожидается прочитать
+	const char* get_record(uint32_t _blocknum, uint32_t _remain = UINT_MAX);
+
+private:
+	V8Object* object;
+	uint32_t numblocks;        // всего записей в объекте
+	uint32_t records_per_page; // записей на одной странице
+	uint32_t first;            // первая запись в окне
+	uint32_t count;            // кол-во записей в окне
+	uint32_t hits;             // сколько раз окно угадало продолжение цепочки
+	bool speculate;            // false после промаха - следующее чтение одной записью
+	std::vector<char> window;
 };
 
 #endif
@@ -336,7 +336,8 @@ void V8Catalog::initialize()
 				file_data->Read(_temp_buf, header_size);
 				// TODO: константы 20, 8
 
-				string _name = TEncoding::Unicode->toUtf8(vector<uint8_t>(_temp_buf + 20, _temp_buf + header_size));
+				string _name;
+				AppendUtf16AsUtf8(_name, _temp_buf + 20, header_size - 20);
 				int64_t time_create = *(int64_t*)_temp_buf;
 				int64_t time_modify = *(int64_t*)_temp_buf + 8;
 
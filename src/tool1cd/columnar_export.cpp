@@ -0,0 +1,412 @@
+/*
+    Tool1CD library provides access to 1CD database files.
+    Copyright © 2009-2017 awa
+    Copyright © 2017-2018 E8 Tools contributors
+
+    This file is part of Tool1CD Library.
+
+    Tool1CD Library is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Tool1CD Library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with Tool1CD Library.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include <string>
+#include <vector>
+#include <memory>
+#include <algorithm>
+#include <unordered_map>
+#include <boost/filesystem.hpp>
+
+#include "Table.h"
+#include "TableRecord.h"
+#include "ColumnarFormat.h"
+#include "BinaryDecimalNumber.h"
+#include "BufferedWriter.h"
+#include "MessageRegistration.h"
+#include "SystemClasses/TFileStream.hpp"
+
+extern Registrator msreg_g;
+
+using namespace std;
+
+namespace {
+
+const int32_t COLUMNAR_MAX_INT64_DIGITS = 18; // numeric большей длины выгружается строкой
+
+template <typename T>
+void put(string &out, T value)
+{
+	out.append(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+void put_string(string &out, const string &value)
+{
+	put<uint32_t>(out, value.size());
+	out += value;
+}
+
+//---------------------------------------------------------------------------
+// Количество дней от 1970-01-01 по пролептическому григорианскому календарю
+int64_t days_from_civil(int64_t y, int m, int d)
+{
+	y -= m <= 2;
+	int64_t era = (y >= 0 ? y : y - 399) / 400;
+	int64_t yoe = y - era * 400;
+	int64_t doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+	int64_t doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+	return era * 146097 + doe - 719468;
+}
+
+//---------------------------------------------------------------------------
+columnar_type get_columnar_type(const Field *field)
+{
+	switch(field->get_type())
+	{
+		case type_fields::tf_bool:
+			return columnar_type::boolean;
+		case type_fields::tf_numeric:
+			return field->get_length() <= COLUMNAR_MAX_INT64_DIGITS ? columnar_type::int64 : columnar_type::string;
+		case type_fields::tf_datetime:
+			return columnar_type::timestamp;
+		case type_fields::tf_binary:
+			return field->get_length() == 16 ? columnar_type::guid : columnar_type::bytes;
+		case type_fields::tf_varbinary:
+		case type_fields::tf_image:
+			return columnar_type::bytes;
+		default:
+			return columnar_type::string;
+	}
+}
+
+//---------------------------------------------------------------------------
+// Блок одного столбца текущей группы строк: значения, карта NULL, словарь и статистика
+class ColumnBuilder
+{
+public:
+	ColumnBuilder(const Table *_table, Field *_field)
+		: table(_table), field(_field)
+	{
+		column.name = field->get_name();
+		column.type = get_columnar_type(field);
+		column.nullable = field->get_null_exists();
+		column.field_type = static_cast<uint8_t>(field->get_type());
+		column.length = field->get_length();
+		column.scale = column.type == columnar_type::int64 ? field->get_precision() : 0;
+		reset();
+	}
+
+	const ColumnarColumn &get_column() const { return column; }
+
+	uint64_t get_size() const { return nulls.size() + values.size() + dictionary_data.size(); }
+
+	void add(const TableRecord *rec)
+	{
+		bool is_null = rec->is_null_value(field);
+		if(column.nullable)
+		{
+			if((rows & 7) == 0) nulls += '\0';
+			if(is_null)
+			{
+				nulls.back() |= 1 << (rows & 7);
+				null_count++;
+			}
+		}
+		rows++;
+
+		const char *raw = rec->get_raw(field) + (column.nullable ? 1 : 0);
+		switch(column.type)
+		{
+			case columnar_type::boolean: {
+				uint8_t v = is_null ? 0 : (raw[0] ? 1 : 0);
+				values += static_cast<char>(v);
+				if(!is_null) add_stats(string(1, v));
+				break;
+			}
+			case columnar_type::int64:
+			case columnar_type::timestamp: {
+				int64_t v = is_null ? 0 : column.type == columnar_type::int64 ? get_int64(raw) : get_timestamp(raw);
+				put(values, v);
+				if(!is_null) add_int_stats(v);
+				break;
+			}
+			case columnar_type::guid:
+				if(is_null) values.append(16, '\0');
+				else
+				{
+					values.append(raw, 16);
+					add_stats(string(raw, 16));
+				}
+				break;
+			case columnar_type::string: {
+				uint32_t index = 0;
+				if(!is_null)
+				{
+					value.clear();
+					rec->append_text_string(value, field);
+					auto found = dictionary.find(value);
+					if(found == dictionary.end())
+					{
+						index = dictionary.size();
+						dictionary.emplace(value, index);
+						put_string(dictionary_data, value);
+					}
+					else index = found->second;
+					add_string_stats(value);
+				}
+				put(values, index);
+				break;
+			}
+			case columnar_type::bytes:
+				value.clear();
+				if(!is_null) get_bytes(rec, raw, value);
+				lengths.push_back(value.size());
+				values += value;
+				break;
+		}
+	}
+
+	// записывает блок в поток и начинает новый, возвращает описание записанного блока
+	ColumnarChunkInfo write(BufferedWriter &f)
+	{
+		ColumnarChunkInfo info;
+		info.offset = 0;
+		info.null_count = null_count;
+		info.min = min;
+		info.max = max;
+
+		string head;
+		if(column.type == columnar_type::string)
+		{
+			put<uint32_t>(head, dictionary.size());
+		}
+		f.write(nulls);
+		f.write(head);
+		f.write(dictionary_data);
+		if(column.type == columnar_type::bytes)
+		{
+			string lengths_data;
+			for(auto length : lengths) put(lengths_data, length);
+			f.write(lengths_data);
+			info.size = lengths_data.size();
+		}
+		else info.size = 0;
+		f.write(values);
+		info.size += nulls.size() + head.size() + dictionary_data.size() + values.size();
+
+		reset();
+		return info;
+	}
+
+private:
+	const Table *table;
+	Field *field;
+	ColumnarColumn column;
+
+	uint32_t rows;
+	uint32_t null_count;
+	string nulls;
+	string values;
+	vector<uint32_t> lengths;
+	unordered_map<string, uint32_t> dictionary;
+	string dictionary_data;
+	bool has_stats;
+	int64_t min_int;
+	int64_t max_int;
+	string min;
+	string max;
+	string value;
+
+	void reset()
+	{
+		rows = 0;
+		null_count = 0;
+		nulls.clear();
+		values.clear();
+		lengths.clear();
+		dictionary.clear();
+		dictionary_data.clear();
+		has_stats = false;
+		min.clear();
+		max.clear();
+	}
+
+	void add_stats(const string &v)
+	{
+		if(!has_stats || v < min) min = v;
+		if(!has_stats || v > max) max = v;
+		has_stats = true;
+	}
+
+	// в статистику строк попадают только первые COLUMNAR_STATS_PREFIX байт, иначе в footer оказались бы целые тексты
+	void add_string_stats(const string &v)
+	{
+		size_t len = std::min<size_t>(v.size(), COLUMNAR_STATS_PREFIX);
+		if(!has_stats || v.compare(0, len, min) < 0) min.assign(v, 0, len);
+		if(!has_stats || v.compare(0, len, max) > 0) max.assign(v, 0, len);
+		has_stats = true;
+	}
+
+	void add_int_stats(int64_t v)
+	{
+		if(!has_stats || v < min_int) min_int = v;
+		if(!has_stats || v > max_int) max_int = v;
+		has_stats = true;
+		min.clear();
+		put(min, min_int);
+		max.clear();
+		put(max, max_int);
+	}
+
+	int64_t get_int64(const char *raw) const
+	{
+		int64_t result = 0;
+		decimal_to_int64(raw, column.length, true, result); // длина столбца int64 не больше COLUMNAR_MAX_INT64_DIGITS
+		return result;
+	}
+
+	int64_t get_timestamp(const char *raw) const
+	{
+		decimal_datetime dt = decode_decimal_date(raw);
+		int64_t days = days_from_civil(dt.year, dt.month, dt.day);
+		int64_t seconds = days * 86400 + dt.hour * 3600 + dt.minute * 60 + dt.second;
+		return seconds * 1000000;
+	}
+
+	void get_bytes(const TableRecord *rec, const char *raw, string &out) const
+	{
+		switch(field->get_type())
+		{
+			case type_fields::tf_varbinary: {
+				int16_t length = *reinterpret_cast<const int16_t*>(raw);
+				out.append(raw + 2, std::max<int16_t>(0, std::min<int16_t>(length, column.length)));
+				break;
+			}
+			case type_fields::tf_image: {
+				auto bp = rec->get<table_blob_file>(field);
+				TMemoryStream blob;
+				table->readBlob(&blob, bp.blob_start, bp.blob_length);
+				out.append(static_cast<const char*>(blob.GetMemory()), blob.GetSize());
+				break;
+			}
+			default:
+				out.append(raw, column.length);
+		}
+	}
+};
+
+} // namespace
+
+//---------------------------------------------------------------------------
+// Выгрузка в колоночный формат (см. ColumnarFormat.h) за один проход по таблице.
+// Группа строк накапливается в памяти и записывается, когда набрано COLUMNAR_ROW_GROUP_ROWS строк или COLUMNAR_ROW_GROUP_SIZE байт
+bool Table::export_to_columnar(const std::string &_filename, const std::vector<Field*> &export_fields, bool skip_blobs) const
+{
+	vector<unique_ptr<ColumnBuilder>> builders;
+	for(auto field : export_fields.empty() ? fields : export_fields)
+	{
+		if(skip_blobs && field->get_type() == type_fields::tf_image) continue;
+		builders.emplace_back(new ColumnBuilder(this, field));
+	}
+
+	Index* curindex = nullptr;
+	auto primary = std::find_if(indexes.begin(), indexes.end(),
+							   [](Index *index) { return index->is_primary();});
+	if (primary != indexes.end()) {
+		curindex = *primary;
+	}
+	uint32_t numr = curindex ? curindex->get_numrecords() : numrecords_found;
+
+	string status = "Экспорт таблицы ";
+	status += name;
+	status += " ";
+	msreg_g.Status(status);
+
+	TFileStream fs(boost::filesystem::path(_filename), fmCreate);
+	BufferedWriter f(&fs);
+
+	string header(COLUMNAR_SIGNATURE, 4);
+	put(header, COLUMNAR_VERSION);
+	f.write(header);
+	uint64_t offset = header.size();
+
+	vector<ColumnarRowGroup> row_groups;
+	uint32_t rows = 0;
+
+	auto write_row_group = [&]() {
+		ColumnarRowGroup row_group;
+		row_group.offset = offset;
+		row_group.num_rows = rows;
+		for(auto &builder : builders)
+		{
+			row_group.chunks.push_back(builder->write(f));
+			offset += row_group.chunks.back().size;
+		}
+		row_groups.push_back(row_group);
+		rows = 0;
+	};
+
+	for(uint32_t j = 0; j < numr; j++)
+	{
+		if (j % 100 == 0 && j) {
+			msreg_g.Status(status + to_string(j));
+		}
+
+		uint32_t nr = curindex ? curindex->get_numrec(j) : recordsindex[j];
+		unique_ptr<TableRecord> rec(get_record(nr));
+
+		uint64_t size = 0;
+		for(auto &builder : builders)
+		{
+			builder->add(rec.get());
+			size += builder->get_size();
+		}
+		rows++;
+
+		if(rows == COLUMNAR_ROW_GROUP_ROWS || size >= COLUMNAR_ROW_GROUP_SIZE) write_row_group();
+	}
+	if(rows) write_row_group();
+
+	string footer;
+	put<uint16_t>(footer, name.size());
+	footer += name;
+	put<uint32_t>(footer, builders.size());
+	for(auto &builder : builders)
+	{
+		const ColumnarColumn &column = builder->get_column();
+		put<uint16_t>(footer, column.name.size());
+		footer += column.name;
+		put(footer, static_cast<uint8_t>(column.type));
+		put<uint8_t>(footer, column.nullable ? 1 : 0);
+		put(footer, column.field_type);
+		put(footer, column.length);
+		put(footer, column.scale);
+	}
+	put<uint32_t>(footer, row_groups.size());
+	for(auto &row_group : row_groups)
+	{
+		put(footer, row_group.offset);
+		put(footer, row_group.num_rows);
+		for(auto &chunk : row_group.chunks)
+		{
+			put(footer, chunk.size);
+			put(footer, chunk.null_count);
+			put_string(footer, chunk.min);
+			put_string(footer, chunk.max);
+		}
+	}
+	put<uint32_t>(footer, footer.size());
+	footer.append(COLUMNAR_SIGNATURE, 4);
+	f.write(footer);
+	f.flush();
+
+	msreg_g.Status("");
+	return true;
+}
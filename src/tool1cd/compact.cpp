@@ -0,0 +1,263 @@
+/*
+    Tool1CD library provides access to 1CD database files.
+    Copyright © 2009-2017 awa
+    Copyright © 2017-2018 E8 Tools contributors
+
+    This file is part of Tool1CD Library.
+
+    Tool1CD Library is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Tool1CD Library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with Tool1CD Library.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include <vector>
+#include <functional>
+#include <memory>
+#include <boost/filesystem.hpp>
+
+#include "Class_1CD.h"
+#include "Common.h"
+#include "Constants.h"
+#include "SystemClasses/TFileStream.hpp"
+#include "SystemClasses/System.SysUtils.hpp"
+
+using namespace std;
+using namespace System;
+
+namespace {
+
+const uint32_t COMPACT_CHUNK_PAGES = 256; // количество страниц данных, копируемых за один раз
+
+// функция чтения куска исходного объекта: буфер, смещение, длина
+typedef std::function<void(char*, uint64_t, uint32_t)> object_reader;
+
+//---------------------------------------------------------------------------
+// Запись объектов в новый файл базы. Страницы выделяются строго подряд:
+// заголовок, таблица размещения, данные, поэтому каждый объект занимает непрерывный участок файла
+class CompactWriter
+{
+public:
+	CompactWriter(TFileStream* _out, uint32_t _pagesize)
+		: out(_out), pagesize(_pagesize), next_page(0), page(_pagesize)
+	{}
+
+	uint32_t get_length() const
+	{
+		return next_page;
+	}
+
+	// резервирует count страниц в конце файла (заполняются нулями)
+	uint32_t allocate(uint32_t count)
+	{
+		uint32_t first = next_page;
+		std::fill(page.begin(), page.end(), 0);
+		for(uint32_t i = 0; i < count; i++) write_page(first + i, page.data());
+		next_page += count;
+		return first;
+	}
+
+	void write_page(uint32_t page_number, const char* buf)
+	{
+		out->Seek((int64_t)page_number * pagesize, soFromBeginning);
+		out->Write(buf, pagesize);
+	}
+
+	// записывает объект длиной len; если header_page == 0, заголовок размещается в конце файла
+	uint32_t write_object(const _version &ver, uint64_t len, const object_reader &read, uint32_t header_page = 0)
+	{
+		const uint32_t per_fat_page = 1023;
+		const uint32_t header_capacity = 1018;
+		uint64_t data_pages = (len + pagesize - 1) / pagesize;
+		uint32_t fat_pages = (data_pages + per_fat_page - 1) / per_fat_page;
+
+		if(fat_pages > header_capacity || len > UINT32_MAX)
+		{
+			throw DetailedException("Объект слишком велик для записи в сжатую базу")
+				.add_detail("Длина объекта", len);
+		}
+
+		if(!header_page) header_page = allocate(1);
+		uint32_t first_fat = next_page;
+		next_page += fat_pages;
+		uint32_t first_data = next_page;
+		next_page += data_pages;
+
+		// заголовок
+		std::fill(page.begin(), page.end(), 0);
+		v8ob* ob = (v8ob*)page.data();
+		memcpy(ob->sig, SIG_OBJ, 8);
+		ob->len = len;
+		ob->version = ver;
+		for(uint32_t i = 0; i < fat_pages; i++) ob->blocks[i] = first_fat + i;
+		write_page(header_page, page.data());
+
+		// таблица размещения
+		for(uint32_t i = 0; i < fat_pages; i++)
+		{
+			std::fill(page.begin(), page.end(), 0);
+			uint32_t first = i * per_fat_page;
+			uint32_t count = std::min<uint64_t>(per_fat_page, data_pages - first);
+			objtab* ot = (objtab*)page.data();
+			ot->numblocks = count;
+			for(uint32_t j = 0; j < count; j++) ot->blocks[j] = first_data + first + j;
+			write_page(first_fat + i, page.data());
+		}
+
+		// данные
+		std::vector<char> chunk((uint64_t)pagesize * COMPACT_CHUNK_PAGES);
+		out->Seek((int64_t)first_data * pagesize, soFromBeginning);
+		for(uint64_t offset = 0; offset < len; offset += chunk.size())
+		{
+			uint32_t curlen = std::min<uint64_t>(chunk.size(), len - offset);
+			uint32_t padded = (curlen + pagesize - 1) / pagesize * pagesize;
+			read(chunk.data(), offset, curlen);
+			std::fill(chunk.begin() + curlen, chunk.begin() + padded, 0);
+			out->Write(chunk.data(), padded);
+		}
+
+		return header_page;
+	}
+
+	uint32_t write_object(V8Object* ob, uint32_t header_page = 0)
+	{
+		return write_object(ob->get_current_version(), ob->get_len(),
+			[ob](char* buf, uint64_t offset, uint32_t length) { ob->get_data(buf, offset, length); },
+			header_page);
+	}
+
+	uint32_t write_object(const _version &ver, const std::vector<char> &data, uint32_t header_page = 0)
+	{
+		return write_object(ver, data.size(),
+			[&data](char* buf, uint64_t offset, uint32_t length) { memcpy(buf, data.data() + offset, length); },
+			header_page);
+	}
+
+private:
+	TFileStream* out;
+	uint32_t pagesize;
+	uint32_t next_page;
+	std::vector<char> page;
+};
+
+//---------------------------------------------------------------------------
+// поиск узла {"Files",<data>,<blob>,<index>} в описании таблицы, start и end - границы узла без фигурных скобок
+void find_table_files(const string &description, uint32_t (&files)[3], size_t &start, size_t &end)
+{
+	start = description.rfind("\"Files\"");
+	if(start == string::npos)
+	{
+		throw DetailedException("В описании таблицы не найден узел Files");
+	}
+	end = start + 7;
+	for(int i = 0; i < 3; i++)
+	{
+		while(end < description.size() && (description[end] == ',' || isspace((unsigned char)description[end]))) end++;
+		size_t digits = end;
+		while(end < description.size() && isdigit((unsigned char)description[end])) end++;
+		if(digits == end)
+		{
+			throw DetailedException("Ошибка разбора узла Files описания таблицы")
+				.add_detail("Номер файла", i + 1);
+		}
+		files[i] = stoul(description.substr(digits, end - digits));
+	}
+}
+
+} // namespace
+
+//---------------------------------------------------------------------------
+// Запись дефрагментированной копии базы в новый файл. Все внутренние файлы таблиц (описание, данные, blob,
+// индексы) переписываются в непрерывные участки, свободные страницы не переносятся. Только для баз до 8.3.8
+bool T_1CD::save_compacted(const boost::filesystem::path &file_name)
+{
+	if(boost::filesystem::exists(file_name) && boost::filesystem::equivalent(file_name, filename))
+	{
+		throw DetailedException("Сжатая копия базы не может быть записана в файл открытой базы")
+			.add_detail("Файл", file_name.string());
+	}
+
+	// формат заголовка таблицы свободных страниц 8.3.8 известен не полностью, записать его корректно нельзя
+	if(version >= db_ver::ver8_3_8_0)
+	{
+		throw DetailedException("Сжатие баз формата 8.3.8 не поддерживается")
+			.add_detail("Файл", filename.string());
+	}
+
+	bool v80 = version == db_ver::ver8_0_3_0 || version == db_ver::ver8_0_5_0;
+
+	// корневой объект
+	vector<char> root_data(root_object->get_len());
+	root_object->get_data(root_data.data(), 0, root_data.size());
+	uint32_t root_blocks_offset = v80 ? offsetof(root_80, blocks) : offsetof(root_81, blocks);
+	uint32_t root_numblocks_offset = v80 ? offsetof(root_80, numblocks) : offsetof(root_81, numblocks);
+	if(root_data.size() < root_blocks_offset)
+	{
+		throw DetailedException("Ошибка чтения корневого объекта базы");
+	}
+	uint32_t numblocks = *(uint32_t*)(root_data.data() + root_numblocks_offset);
+	if(root_data.size() < root_blocks_offset + (uint64_t)numblocks * 4)
+	{
+		throw DetailedException("Ошибка чтения корневого объекта базы")
+			.add_detail("Количество таблиц", numblocks);
+	}
+	uint32_t* root_blocks = (uint32_t*)(root_data.data() + root_blocks_offset);
+
+	std::unique_ptr<TFileStream> out(new TFileStream(file_name, fmCreate));
+	CompactWriter writer(out.get(), pagesize);
+	writer.allocate(3); // заголовок базы, таблица свободных страниц, корневой объект
+
+	for(uint32_t i = 0; i < numblocks; i++)
+	{
+		std::unique_ptr<V8Object> descr(new V8Object(this, root_blocks[i]));
+		vector<uint8_t> descr_bytes(descr->get_len());
+		descr->get_data(descr_bytes.data(), 0, descr_bytes.size());
+
+		string description = TEncoding::Unicode->toUtf8(descr_bytes);
+		uint32_t files[3];
+		size_t files_start, files_end;
+		find_table_files(description, files, files_start, files_end);
+		for(int k = 0; k < 3; k++)
+		{
+			if(!files[k]) continue;
+			std::unique_ptr<V8Object> ob(new V8Object(this, files[k]));
+			files[k] = writer.write_object(ob.get());
+		}
+		description.replace(files_start, files_end - files_start,
+			"\"Files\"," + to_string(files[0]) + "," + to_string(files[1]) + "," + to_string(files[2]));
+		descr_bytes = TEncoding::Unicode->fromUtf8(description);
+		root_blocks[i] = writer.write_object(descr->get_current_version(), vector<char>(descr_bytes.begin(), descr_bytes.end()));
+
+		if(i % 10 == 0) msreg_m.Status(string("Сжатие таблиц ") + to_string(i));
+	}
+	msreg_m.Status(string("Сжатие таблиц ") + to_string(numblocks));
+
+	// корневой объект записывается на свое место (страница 2)
+	writer.write_object(root_object->get_current_version(), root_data, 2);
+
+	// пустая таблица свободных страниц
+	vector<char> page(pagesize, 0);
+	v8ob* free_ob = (v8ob*)page.data();
+	memcpy(free_ob->sig, SIG_OBJ, 8);
+	free_ob->version = free_blocks->get_current_version();
+	writer.write_page(1, page.data());
+
+	// заголовок базы
+	get_block(page.data(), 0);
+	((v8con*)page.data())->length = writer.get_length();
+	writer.write_page(0, page.data());
+
+	msreg_m.AddMessage("Записана сжатая копия базы", MessageState::Succesfull)
+		.with("Файл", file_name.string())
+		.with("Страниц в исходной базе", length)
+		.with("Страниц в сжатой базе", writer.get_length());
+
+	return true;
+}
@@ -47,12 +47,7 @@ using namespace System;
 }*/
 string serialize_version(int configVerMajor, int configVerMinor)
 {
-	auto t = std::make_shared<Tree>("", node_type::nd_list, nullptr);
-	auto tc = new Tree("", node_type::nd_list, t.get());
-	tc = new Tree("", node_type::nd_list, tc);
-	tc->add_child(to_string(configVerMajor), node_type::nd_number);
-	tc->add_child(to_string(configVerMinor), node_type::nd_number);
-	return outtext(t.get());
+	return "{\r\n{" + to_string(configVerMajor) + "," + to_string(configVerMinor) + "}\r\n}";
 }
 
 bool try_store_blob_data(const TableRecord &record,
@@ -417,12 +412,11 @@ bool T_1CD::save_depot_config(const string &_filename, int32_t ver)
 		trc->add_child(pmap.first, node_type::nd_string);
 		trc->add_child(pmap.second, node_type::nd_guid);
 	}
-	string tree_text = outtext(tr);
-	delete tr;
 	{
 		TStream *in = new TMemoryStream;
 		in->Write(TEncoding::UTF8->GetPreamble(), TEncoding::UTF8->GetPreamble().size());
-		in->WriteString(tree_text);
+		outtext(tr, in);
+		delete tr;
 		in->Seek(0, soFromBeginning);
 		TStream *out = new TTempStream;
 		if (oldformat) {
@@ -442,15 +436,11 @@ bool T_1CD::save_depot_config(const string &_filename, int32_t ver)
 		tvc->add_child(pmap.second, node_type::nd_guid);
 	}
 
-	string tv_text = outtext(tv);
-	delete tv;
 	{
 		TStream *in = new TMemoryStream;
 		in->Write(TEncoding::UTF8->GetPreamble(), TEncoding::UTF8->GetPreamble().size());
-		{
-			TStreamWriter sw(in, TEncoding::UTF8, 1024);
-			sw.Write(tv_text);
-		}
+		outtext(tv, in);
+		delete tv;
 		TStream *out = new TTempStream;
 		in->Seek(0, soFromBeginning);
 		ZDeflateStream(in, out);
@@ -0,0 +1,637 @@
+/*
+    Tool1CD library provides access to 1CD database files.
+    Copyright © 2009-2017 awa
+    Copyright © 2017-2018 E8 Tools contributors
+
+    This file is part of Tool1CD Library.
+
+    Tool1CD Library is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    Tool1CD Library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with Tool1CD Library.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include <string>
+#include <vector>
+#include <memory>
+#include <algorithm>
+#include <cstring>
+#include <boost/filesystem.hpp>
+
+#include "Table.h"
+#include "TableRecord.h"
+#include "Common.h"
+#include "BufferedWriter.h"
+#include "GzipStream.h"
+#include "ExportCheckpoint.h"
+#include "RecordDecoder.h"
+#include "MessageRegistration.h"
+#include "SystemClasses/TFileStream.hpp"
+
+extern Registrator msreg_g;
+
+using namespace std;
+
+namespace {
+
+//---------------------------------------------------------------------------
+// Значение CSV: в кавычках, если содержит разделитель, кавычку или перевод строки.
+// Пустая строка записывается как "", чтобы отличаться от NULL
+void append_csv_value(string &out, const string &value)
+{
+	if(!value.empty() && value.find_first_of(",\"\r\n") == string::npos)
+	{
+		out += value;
+		return;
+	}
+	out += '"';
+	for(char c : value)
+	{
+		if(c == '"') out += '"';
+		out += c;
+	}
+	out += '"';
+}
+
+//---------------------------------------------------------------------------
+// Значение TSV: табуляция, переводы строк и обратная косая черта экранируются
+void append_tsv_value(string &out, const string &value)
+{
+	for(char c : value)
+	{
+		switch(c)
+		{
+			case '\t': out += "\\t"; break;
+			case '\n': out += "\\n"; break;
+			case '\r': out += "\\r"; break;
+			case '\\': out += "\\\\"; break;
+			default: out += c;
+		}
+	}
+}
+
+//---------------------------------------------------------------------------
+void append_json_string(string &out, const string &value)
+{
+	static const char hex[] = "0123456789abcdef";
+
+	out += '"';
+	for(char c : value)
+	{
+		switch(c)
+		{
+			case '"': out += "\\\""; break;
+			case '\\': out += "\\\\"; break;
+			case '\n': out += "\\n"; break;
+			case '\r': out += "\\r"; break;
+			case '\t': out += "\\t"; break;
+			default:
+				if(static_cast<unsigned char>(c) < 0x20)
+				{
+					out += "\\u00";
+					out += hex[(c >> 4) & 0xf];
+					out += hex[c & 0xf];
+				}
+				else out += c;
+		}
+	}
+	out += '"';
+}
+
+//---------------------------------------------------------------------------
+void append_text_value(string &out, text_format format, const string &value, bool is_null, bool is_bool)
+{
+	switch(format)
+	{
+		case text_format::csv:
+			if(!is_null) append_csv_value(out, value);
+			break;
+		case text_format::tsv:
+			if(is_null) out += "\\N";
+			else append_tsv_value(out, value);
+			break;
+		case text_format::jsonl:
+			if(is_null) out += "null";
+			else if(is_bool) out += value;
+			else append_json_string(out, value);
+			break;
+	}
+}
+
+//---------------------------------------------------------------------------
+// Формирование строк текстовой выгрузки: значения добавляются по одному, разделители и обрамление записи
+// расставляются в зависимости от формата. Blob-поля выгружаются по способу blob_mode.
+// Значения полей columns формируются через RecordDecoder, построенный один раз на всю выгрузку
+class TextRecordWriter
+{
+public:
+	TextRecordWriter(BufferedWriter &_f, const Table *_table, const string &filename, const vector<Field*> &_columns,
+					 text_format _format, blob_export _blob_mode, bool _unpack)
+		: f(_f), table(_table), columns(_columns), decoder(_columns, decode_format::text),
+		  format(_format), blob_mode(_blob_mode), unpack(_unpack), dir(filename + ".blob")
+	{
+		delimiter = format == text_format::tsv ? "\t" : ",";
+		newline = format == text_format::csv ? "\r\n" : "\n";
+	}
+
+	void write_header(const vector<string> &names)
+	{
+		if(format == text_format::jsonl) return;
+		begin_row();
+		for(auto &column_name : names)
+		{
+			if(column++) out() += delimiter;
+			append_text_value(out(), format, column_name, false, false);
+		}
+		end_row();
+	}
+
+	void begin_row()
+	{
+		column = 0;
+		if(format == text_format::jsonl) out() += '{';
+	}
+
+	void add_value(const string &column_name, const string &value, bool is_null, bool is_bool = false)
+	{
+		if(column++) out() += delimiter;
+		if(format == text_format::jsonl)
+		{
+			append_json_string(out(), column_name);
+			out() += ':';
+		}
+		append_text_value(out(), format, value, is_null, is_bool);
+	}
+
+	// column - номер поля в columns
+	void add_field(const TableRecord *rec, size_t column, uint32_t numrec)
+	{
+		Field *field = columns[column];
+		const char *data = rec->get_record_data();
+		bool is_null = decoder.is_null(column, data);
+		value.clear();
+		if(!is_null)
+		{
+			if(blob_mode == blob_export::file && field->get_type() == type_fields::tf_image)
+			{
+				is_null = !save_blob(rec, field, numrec);
+			}
+			else decoder.append_value(value, column, data);
+		}
+		add_value(field->get_name(), value, is_null, field->get_type() == type_fields::tf_bool);
+	}
+
+	void end_row()
+	{
+		if(format == text_format::jsonl) out() += '}';
+		out() += newline;
+		f.commit();
+	}
+
+private:
+	BufferedWriter &f;
+	const Table *table;
+	vector<Field*> columns;
+	RecordDecoder decoder;
+	text_format format;
+	blob_export blob_mode;
+	bool unpack;
+	const char *delimiter;
+	const char *newline;
+	uint32_t column {0};
+	string value;
+
+	boost::filesystem::path dir;
+	bool dircreated {false};
+	bool canwriteblob {false};
+
+	string &out() { return f.get_buffer(); }
+
+	// сохраняет blob в файл <файл выгрузки>.blob/<номер записи>_<поле>, имя файла помещается в value
+	bool save_blob(const TableRecord *rec, Field *field, uint32_t numrec)
+	{
+		if(!dircreated)
+		{
+			dircreated = true;
+			try
+			{
+				canwriteblob = directory_exists(dir, true);
+			}
+			catch(...)
+			{
+				msreg_g.AddMessage("Не удалось создать каталог blob", MessageState::Warning)
+					.with("Таблица", table->get_name())
+					.with("Путь", dir.string());
+			}
+		}
+		if(!canwriteblob)
+		{
+			value = "{ERROR}";
+			return true;
+		}
+		value = to_string(numrec) + "_" + field->get_name();
+		return field->save_blob_to_file(rec, (dir / value).string(), unpack);
+	}
+};
+
+//---------------------------------------------------------------------------
+vector<Field*> get_text_columns(const vector<Field*> &fields, const vector<Field*> &export_fields, blob_export blob_mode)
+{
+	vector<Field*> columns;
+	for(auto field : export_fields.empty() ? fields : export_fields)
+	{
+		if(blob_mode == blob_export::skip && field->get_type() == type_fields::tf_image) continue;
+		columns.push_back(field);
+	}
+	return columns;
+}
+
+const char MANIFEST_SIGNATURE[4] = {'T', '1', 'C', 'M'};
+const uint32_t MANIFEST_VERSION = 3; // 3 - в штамп по содержимому входят данные blob
+
+// способ идентификации записи в манифесте
+enum class manifest_key : uint8_t
+{
+	primary_index = 0, // значения полей первичного индекса
+	record_number = 1  // физический номер записи (таблицы без первичного индекса)
+};
+
+// источник штампа записи в манифесте
+enum class manifest_stamp : uint8_t
+{
+	version = 0, // поле версии записи
+	content = 1  // содержимое всех полей записи
+};
+
+// Манифест инкрементальной выгрузки:
+//   char[4] "T1CM", u32 версия, u16 длина, имя таблицы, u8 manifest_key, u8 manifest_stamp, u32 количество записей,
+//   записи в порядке возрастания ключа: u32 длина ключа, ключ, u64 штамп.
+// Ключ - двоичные значения полей первичного индекса в том виде, как они хранятся в записи (вместе с признаком NULL),
+// чтобы ключ не зависел от параметров представления значений, либо номер записи (u32 big-endian).
+// Штамп - FNV-1a поля версии или всех полей записи, для blob - признака NULL, длины и данных
+struct ManifestEntry
+{
+	string key;
+	uint64_t stamp;
+
+	bool operator<(const ManifestEntry &another) const { return key < another.key; }
+};
+
+//---------------------------------------------------------------------------
+uint64_t fnv1a(uint64_t hash, const char *data, size_t length)
+{
+	for(size_t i = 0; i < length; i++)
+	{
+		hash ^= static_cast<unsigned char>(data[i]);
+		hash *= 0x100000001b3ULL;
+	}
+	return hash;
+}
+
+template <typename T>
+void put(string &out, T value)
+{
+	out.append(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+//---------------------------------------------------------------------------
+// Читает манифест предыдущей выгрузки. Возвращает false, если манифеста нет или он построен по другому ключу
+bool read_manifest(const boost::filesystem::path &manifest_path, const string &table_name,
+				   manifest_key key_kind, manifest_stamp stamp_kind, vector<ManifestEntry> &entries)
+{
+	entries.clear();
+	if(!boost::filesystem::exists(manifest_path)) return false;
+
+	TFileStream fs(manifest_path, fmOpenRead);
+	string data(fs.GetSize(), '\0');
+	fs.Read(&data[0], data.size());
+
+	size_t pos = 0;
+	auto take = [&](size_t count) -> const char* {
+		if(count > data.size() - pos)
+		{
+			throw DetailedException("Поврежден манифест инкрементальной выгрузки")
+				.add_detail("Таблица", table_name)
+				.add_detail("Файл", manifest_path.string());
+		}
+		pos += count;
+		return data.data() + pos - count;
+	};
+	auto get_u32 = [&]() { uint32_t v; memcpy(&v, take(4), 4); return v; };
+
+	if(memcmp(take(4), MANIFEST_SIGNATURE, 4) != 0)
+	{
+		throw DetailedException("Файл не является манифестом инкрементальной выгрузки")
+			.add_detail("Таблица", table_name)
+			.add_detail("Файл", manifest_path.string());
+	}
+	if(get_u32() != MANIFEST_VERSION)
+	{
+		msreg_g.AddMessage("Манифест записан другой версией программы, выполняется полная выгрузка", MessageState::Warning)
+			.with("Таблица", table_name)
+			.with("Файл", manifest_path.string());
+		return false;
+	}
+	uint16_t name_length;
+	memcpy(&name_length, take(2), 2);
+	string manifest_table(take(name_length), name_length);
+	uint8_t manifest_key_kind = *take(1);
+	uint8_t manifest_stamp_kind = *take(1);
+	if(manifest_table != table_name
+		|| manifest_key_kind != static_cast<uint8_t>(key_kind)
+		|| manifest_stamp_kind != static_cast<uint8_t>(stamp_kind))
+	{
+		msreg_g.AddMessage("Манифест построен для другой структуры таблицы, выполняется полная выгрузка", MessageState::Warning)
+			.with("Таблица", table_name)
+			.with("Файл", manifest_path.string());
+		return false;
+	}
+
+	uint32_t count = get_u32();
+	entries.reserve(count);
+	for(uint32_t i = 0; i < count; i++)
+	{
+		ManifestEntry entry;
+		uint32_t key_length = get_u32();
+		entry.key.assign(take(key_length), key_length);
+		memcpy(&entry.stamp, take(8), 8);
+		entries.push_back(entry);
+	}
+	return true;
+}
+
+//---------------------------------------------------------------------------
+// Записывает манифест во временный файл и заменяет им прежний, чтобы прерванная выгрузка не портила манифест
+void write_manifest(const boost::filesystem::path &manifest_path, const string &table_name,
+					manifest_key key_kind, manifest_stamp stamp_kind, const vector<ManifestEntry> &entries)
+{
+	boost::filesystem::path temp_path(manifest_path.string() + ".tmp");
+	{
+		TFileStream fs(temp_path, fmCreate);
+		BufferedWriter f(&fs);
+		string &out = f.get_buffer();
+		out.append(MANIFEST_SIGNATURE, 4);
+		put(out, MANIFEST_VERSION);
+		put<uint16_t>(out, table_name.size());
+		out += table_name;
+		put(out, static_cast<uint8_t>(key_kind));
+		put(out, static_cast<uint8_t>(stamp_kind));
+		put<uint32_t>(out, entries.size());
+		f.commit();
+		for(auto &entry : entries)
+		{
+			string &entry_out = f.get_buffer();
+			put<uint32_t>(entry_out, entry.key.size());
+			entry_out += entry.key;
+			put(entry_out, entry.stamp);
+			f.commit();
+		}
+		f.flush();
+	}
+	boost::filesystem::rename(temp_path, manifest_path);
+}
+
+} // namespace
+
+//---------------------------------------------------------------------------
+// Потоковая выгрузка таблицы в CSV, TSV или JSON Lines. Записи выгружаются в порядке первичного индекса, как и в XML
+bool Table::export_to_text(const std::string &_filename, text_format format, const std::vector<Field*> &export_fields, blob_export blob_mode, bool unpack,
+						   ExportCheckpoint *checkpoint) const
+{
+	vector<Field*> columns = get_text_columns(fields, export_fields, blob_mode);
+
+	Index* curindex = nullptr;
+	auto primary = std::find_if(indexes.begin(), indexes.end(),
+							   [](Index *index) { return index->is_primary();});
+	if (primary != indexes.end()) {
+		curindex = *primary;
+	}
+	uint32_t numr = curindex ? curindex->get_numrecords() : numrecords_found;
+
+	string status = "Экспорт таблицы ";
+	status += name;
+	status += " ";
+
+	uint32_t first = 0; // количество записей, выгруженных до прерывания
+	unique_ptr<TStream> fs(checkpoint ? checkpoint->open_stream(_filename, first)
+									  : create_export_stream(boost::filesystem::path(_filename)));
+	BufferedWriter f(fs.get());
+	TextRecordWriter writer(f, this, _filename, columns, format, blob_mode, unpack);
+
+	if(!first)
+	{
+		vector<string> names;
+		for(auto field : columns) names.push_back(field->get_name());
+		writer.write_header(names);
+	}
+
+	msreg_g.Status(status);
+
+	for(uint32_t j = first; j < numr; j++)
+	{
+		if (j % 100 == 0 && j) {
+			msreg_g.Status(status + to_string(j));
+		}
+
+		uint32_t nr = curindex ? curindex->get_numrec(j) : recordsindex[j];
+		unique_ptr<TableRecord> rec(get_record(nr));
+
+		writer.begin_row();
+		for(size_t i = 0; i < columns.size(); i++) writer.add_field(rec.get(), i, nr);
+		writer.end_row();
+
+		if(checkpoint && (j + 1) % EXPORT_CHECKPOINT_RECORDS == 0) checkpoint->save(_filename, j + 1, f);
+	}
+	f.flush();
+	fs->Close();
+	if(checkpoint) checkpoint->set_done(_filename);
+
+	msreg_g.Status("");
+	return true;
+}
+
+//---------------------------------------------------------------------------
+// Инкрементальная выгрузка: в файл попадают только записи, добавленные, измененные или удаленные с момента
+// выгрузки, сохранившей манифест. Первая колонка _OP - insert, update или delete, для таблиц без первичного индекса
+// следом идет _RECNO - физический номер записи. У удаленных записей заполнены только поля первичного индекса.
+// При отсутствии манифеста выгружаются все записи как добавленные
+bool Table::export_changes(const std::string &_filename, const std::string &manifest_filename, text_format format,
+						   const std::vector<Field*> &export_fields, blob_export blob_mode, bool unpack) const
+{
+	vector<Field*> columns = get_text_columns(fields, export_fields, blob_mode);
+
+	Index* curindex = nullptr;
+	auto primary = std::find_if(indexes.begin(), indexes.end(),
+							   [](Index *index) { return index->is_primary();});
+	if (primary != indexes.end()) {
+		curindex = *primary;
+	}
+	uint32_t numr = curindex ? curindex->get_numrecords() : numrecords_found;
+
+	Field *version_field = nullptr;
+	for(auto field : fields)
+	{
+		if(field->get_type() == type_fields::tf_version || field->get_type() == type_fields::tf_version8)
+		{
+			version_field = field;
+			break;
+		}
+	}
+
+	manifest_key key_kind = curindex ? manifest_key::primary_index : manifest_key::record_number;
+	manifest_stamp stamp_kind = version_field ? manifest_stamp::version : manifest_stamp::content;
+
+	vector<Field*> key_fields;
+	if(curindex) for(auto &index_record : curindex->get_records()) key_fields.push_back(index_record.field);
+
+	boost::filesystem::path manifest_path(manifest_filename);
+	vector<ManifestEntry> old_entries;
+	read_manifest(manifest_path, name, key_kind, stamp_kind, old_entries);
+	vector<bool> seen(old_entries.size(), false);
+
+	string status = "Экспорт изменений таблицы ";
+	status += name;
+	status += " ";
+
+	unique_ptr<TStream> fs(create_export_stream(boost::filesystem::path(_filename)));
+	BufferedWriter f(fs.get());
+	TextRecordWriter writer(f, this, _filename, columns, format, blob_mode, unpack);
+
+	vector<string> names;
+	names.push_back("_OP");
+	if(!curindex) names.push_back("_RECNO");
+	for(auto field : columns) names.push_back(field->get_name());
+	writer.write_header(names);
+
+	msreg_g.Status(status);
+
+	vector<ManifestEntry> new_entries;
+	new_entries.reserve(numr);
+	vector<char> blob_data;
+	uint32_t inserted = 0;
+	uint32_t updated = 0;
+
+	for(uint32_t j = 0; j < numr; j++)
+	{
+		if (j % 100 == 0 && j) {
+			msreg_g.Status(status + to_string(j));
+		}
+
+		uint32_t nr = curindex ? curindex->get_numrec(j) : recordsindex[j];
+		unique_ptr<TableRecord> rec(get_record(nr));
+
+		ManifestEntry entry;
+		if(curindex)
+		{
+			for(auto field : key_fields) entry.key.append(rec->get_raw(field), field->get_size());
+		}
+		else
+		{
+			char be[4] = {char(nr >> 24), char(nr >> 16), char(nr >> 8), char(nr)};
+			entry.key.assign(be, 4);
+		}
+
+		entry.stamp = 0xcbf29ce484222325ULL;
+		if(version_field) entry.stamp = fnv1a(entry.stamp, rec->get_raw(version_field), version_field->get_size());
+		else for(auto field : fields)
+		{
+			auto tf = field->get_type();
+			if(tf != type_fields::tf_image && tf != type_fields::tf_string && tf != type_fields::tf_text)
+			{
+				entry.stamp = fnv1a(entry.stamp, rec->get_raw(field), field->get_size());
+				continue;
+			}
+			// blob, перезаписанный данными той же длины, занимает те же освобожденные блоки,
+			// и ссылка на него не меняется, поэтому в штамп идут сами данные
+			auto bp = rec->is_null_value(field) ? table_blob_file{0, 0} : rec->get<table_blob_file>(field);
+			entry.stamp = fnv1a(entry.stamp, rec->get_raw(field), field->get_null_exists() ? 1 : 0);
+			entry.stamp = fnv1a(entry.stamp, (const char *)&bp.blob_length, sizeof(bp.blob_length));
+			if(bp.blob_start && bp.blob_length)
+			{
+				blob_data.resize(bp.blob_length);
+				uint32_t length = readBlob(blob_data.data(), bp.blob_start, bp.blob_length);
+				entry.stamp = fnv1a(entry.stamp, blob_data.data(), length);
+			}
+		}
+
+		const char *op = "insert";
+		auto found = std::lower_bound(old_entries.begin(), old_entries.end(), entry);
+		if(found != old_entries.end() && found->key == entry.key)
+		{
+			seen[found - old_entries.begin()] = true;
+			if(found->stamp == entry.stamp)
+			{
+				new_entries.push_back(entry);
+				continue;
+			}
+			op = "update";
+			updated++;
+		}
+		else inserted++;
+		new_entries.push_back(entry);
+
+		writer.begin_row();
+		writer.add_value("_OP", op, false);
+		if(!curindex) writer.add_value("_RECNO", to_string(nr), false);
+		for(size_t i = 0; i < columns.size(); i++) writer.add_field(rec.get(), i, nr);
+		writer.end_row();
+	}
+
+	uint32_t deleted = 0;
+	vector<char> deleted_rec(recordlen);
+	for(size_t i = 0; i < old_entries.size(); i++)
+	{
+		if(seen[i]) continue;
+		deleted++;
+
+		writer.begin_row();
+		writer.add_value("_OP", "delete", false);
+		if(!curindex)
+		{
+			const unsigned char *be = reinterpret_cast<const unsigned char*>(old_entries[i].key.data());
+			writer.add_value("_RECNO", to_string((be[0] << 24) | (be[1] << 16) | (be[2] << 8) | be[3]), false);
+		}
+		// поля ключа удаленной записи восстанавливаются из манифеста в пустую запись и выгружаются как обычно
+		std::fill(deleted_rec.begin(), deleted_rec.end(), 0);
+		if(curindex)
+		{
+			size_t pos = 0;
+			for(auto field : key_fields)
+			{
+				if(pos + field->get_size() > old_entries[i].key.size()) break;
+				memcpy(deleted_rec.data() + field->get_offset(), old_entries[i].key.data() + pos, field->get_size());
+				pos += field->get_size();
+			}
+		}
+		TableRecord rec(this, deleted_rec.data());
+		for(size_t k = 0; k < columns.size(); k++)
+		{
+			if(curindex && std::find(key_fields.begin(), key_fields.end(), columns[k]) != key_fields.end())
+			{
+				writer.add_field(&rec, k, 0);
+			}
+			else writer.add_value(columns[k]->get_name(), string(), true);
+		}
+		writer.end_row();
+	}
+	f.flush();
+	fs->Close();
+
+	std::sort(new_entries.begin(), new_entries.end());
+	write_manifest(manifest_path, name, key_kind, stamp_kind, new_entries);
+
+	msreg_g.Status("");
+	msreg_g.AddMessage("Выгружены изменения таблицы", MessageState::Info)
+		.with("Таблица", name)
+		.with("Добавлено", inserted)
+		.with("Изменено", updated)
+		.with("Удалено", deleted);
+	return true;
+}